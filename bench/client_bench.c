@@ -0,0 +1,477 @@
+#define _GNU_SOURCE
+
+#include "client.h"
+
+// 客户端微基准：make bench-client
+//
+// 在进程内直接调用 add_sensor_data、get_sensor_data_json 和 handle_http_request
+// （HTTP 请求经 socketpair 送入，不需要网络），以及接收线程的帧处理路径
+// tls_client_ingest（一次读取的数据帧：解析、成批写入存储、统计），在不同的存储容量
+// 和读写线程数下测量。"ingest per-frame" 场景保留成批接收之前的逐帧路径（sscanf
+// 解析，每帧一次 add_sensor_data 和一次统计加锁）作为对照：
+//   ns/op      每次操作的线程耗时；tls_client_ingest 的一次操作为一帧，
+//              1e9 / ns/op 即单核每秒可接收的数据点数
+//   allocs/op  被测代码调用 malloc/calloc/realloc/posix_memalign 的次数
+//   locks/op   pthread_mutex_lock 调用次数，contended 为其中需要等待的比例，
+//              wait 为平均每次操作的等锁时间
+//
+// 分配和加锁通过链接器 --wrap 统计，只计入客户端代码自身的调用，不计 libc 内部。
+// --csv 输出便于保存为基线并与之后的结果比较。
+
+#define BENCH_DEFAULT_DURATION_MS 300
+#define BENCH_MAX_THREADS 16
+#define BENCH_SOURCES 2
+
+volatile int g_client_running = 1;
+int g_actual_http_port = HTTP_PORT;
+
+typedef enum {
+    BENCH_OP_ADD,
+    BENCH_OP_JSON,
+    BENCH_OP_HTTP,
+    BENCH_OP_INGEST,
+    BENCH_OP_INGEST_PER_FRAME
+} bench_op_t;
+
+static const char* g_op_names[] = { "add_sensor_data", "get_sensor_data_json", "handle_http_request",
+                                    "tls_client_ingest", "per-frame ingest" };
+
+typedef struct {
+    const char* name;
+    int writers;
+    int json_readers;
+    const char* http_path;     // One in-process HTTP handler thread when set
+    int receivers;             // Receiver loops fed with pre-encoded data frames
+    int per_frame_receivers;   // The same, through the per-frame baseline path
+} bench_scenario_t;
+
+// Requests are served by a single HTTP thread in the client, so HTTP
+// scenarios use one handler; writers model the upstream receiver
+static const bench_scenario_t g_scenarios[] = {
+    { "1 writer",            1, 0, NULL, 0, 0 },
+    { "4 writers",           4, 0, NULL, 0, 0 },
+    { "1 reader",            0, 1, NULL, 0, 0 },
+    { "1 writer/1 reader",   1, 1, NULL, 0, 0 },
+    { "1 writer/4 readers",  1, 4, NULL, 0, 0 },
+    { "http json",           0, 0, "/api/data", 0, 0 },
+    { "http json+writer",    1, 0, "/api/data", 0, 0 },
+    { "http bin+writer",     1, 0, "/api/data?format=bin", 0, 0 },
+    { "http stats",          0, 0, "/api/stats", 0, 0 },
+    { "ingest",              0, 0, NULL, 1, 0 },
+    { "ingest per-frame",    0, 0, NULL, 0, 1 },
+    { "ingest+reader",       0, 1, NULL, 1, 0 },
+};
+
+static const int g_capacities[] = { 64, 1024, 16384 };
+
+typedef struct {
+    bench_op_t op;
+    int index;
+    const char* http_path;
+    int sock[2];               // [0] request/response side, [1] handled by handle_http_request
+    pthread_t drain_thread;
+    uint64_t ops;
+    uint64_t allocs;
+    uint64_t locks;
+    uint64_t contended;
+    uint64_t wait_ns;
+    uint64_t elapsed_ns;
+} bench_worker_t;
+
+static volatile int g_bench_running = 0;
+static volatile int g_bench_started = 0;
+
+// Per-thread counters fed by the wrapped allocation and locking calls
+static __thread uint64_t t_allocs;
+static __thread uint64_t t_locks;
+static __thread uint64_t t_contended;
+static __thread uint64_t t_wait_ns;
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+int __real_posix_memalign(void** ptr, size_t alignment, size_t size);
+int __real_pthread_mutex_lock(pthread_mutex_t* mutex);
+
+void* __wrap_malloc(size_t size) {
+    t_allocs++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    t_allocs++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    t_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+int __wrap_posix_memalign(void** ptr, size_t alignment, size_t size) {
+    t_allocs++;
+    return __real_posix_memalign(ptr, alignment, size);
+}
+
+int __wrap_pthread_mutex_lock(pthread_mutex_t* mutex) {
+    t_locks++;
+    if (pthread_mutex_trylock(mutex) == 0) {
+        return 0;
+    }
+    t_contended++;
+    uint64_t start = bench_now_ns();
+    int result = __real_pthread_mutex_lock(mutex);
+    t_wait_ns += bench_now_ns() - start;
+    return result;
+}
+
+// Read and discard responses so handle_http_request never blocks on a full socket
+static void* drain_thread(void* arg) {
+    int sockfd = *(int*)arg;
+    char buffer[16384];
+
+    while (recv(sockfd, buffer, sizeof(buffer), 0) > 0) {
+    }
+    return NULL;
+}
+
+// Fill buf with whole data frames as the server sends them; returns the
+// length used and the number of frames in *frames
+static size_t encode_frames(char* buf, size_t size, int* frames) {
+    int64_t origin_us = protocol_now_us();
+    size_t length = 0;
+
+    *frames = 0;
+    while (size - length > FRAME_MAX_SIZE) {
+        double values[CHANNEL_COUNT] = { 61234.56 + *frames * 0.37, 1002.31 - *frames * 0.11 };
+        length += frame_format_data(buf + length, size - length, (uint64_t)*frames + 1, origin_us + *frames,
+                                    values, CHANNEL_MASK_ALL);
+        (*frames)++;
+    }
+    return length;
+}
+
+// The data frame parser before in-place parsing: sscanf for the header fields,
+// strtod for the values
+static int parse_data_sscanf(const char* line, data_frame_t* frame) {
+    unsigned long long seq;
+    long long origin_us;
+    int consumed = 0;
+
+    if (line[0] != FRAME_TYPE_DATA ||
+        sscanf(line + 1, ",%2u,%llu,%lld%n", &frame->hops, &seq, &origin_us, &consumed) != 3 ||
+        consumed == 0) {
+        return -1;
+    }
+    frame->seq = seq;
+    frame->origin_us = origin_us;
+
+    const char* p = line + 1 + consumed;
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        if (*p++ != ',') {
+            return -1;
+        }
+        if (*p == ',' || *p == '\0') {
+            frame->values[i] = NAN;
+            continue;
+        }
+        char* end;
+        frame->values[i] = strtod(p, &end);
+        if (end == p) {
+            return -1;
+        }
+        p = end;
+    }
+    return *p == '\0' ? 0 : -1;
+}
+
+static pthread_mutex_t g_per_frame_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t g_per_frame_frames;
+static int64_t g_per_frame_latency_us;
+
+// The receive path before batched ingest, the baseline for tls_client_ingest:
+// priority frames in a first pass, then each data frame forwarded, parsed,
+// stored with its own add_sensor_data call and counted under the stats lock
+static void ingest_per_frame(int source, char* data, size_t length) {
+    char* end = data + length;
+
+    for (int pass = 0; pass < 2; pass++) {
+        char* start = data;
+        char* newline;
+        while ((newline = memchr(start, '\n', end - start)) != NULL) {
+            size_t frame_length = newline - start + 1;
+            if (pass == 1 && frame_class(start) != FRAME_CLASS_PRIORITY) {
+                data_frame_t frame;
+                relay_forward_frame(start, frame_length);
+                *newline = '\0';
+                if (parse_data_sscanf(start, &frame) == 0) {
+                    add_sensor_data(source, frame.values[CHANNEL_CENTRIFUGE_SPEED],
+                                    frame.values[CHANNEL_POWER_OUTPUT]);
+                    int64_t latency_us = protocol_now_us() - frame.origin_us;
+                    pthread_mutex_lock(&g_per_frame_stats_mutex);
+                    g_per_frame_frames++;
+                    g_per_frame_latency_us += latency_us;
+                    pthread_mutex_unlock(&g_per_frame_stats_mutex);
+                }
+            }
+            start = newline + 1;
+        }
+    }
+}
+
+static void* worker_thread(void* arg) {
+    bench_worker_t* worker = (bench_worker_t*)arg;
+    char request[256];
+    int request_len = 0;
+    char* json = NULL;
+    size_t json_size = sensor_response_max_size();
+    double value = 60000.0 + worker->index;
+    // One receive buffer's worth of frames, copied in before every pass as a read would
+    static char encoded[RX_BUFFER_SIZE];
+    static char received[RX_BUFFER_SIZE];
+    size_t encoded_len = 0;
+    int frames = 0;
+
+    if (worker->op == BENCH_OP_JSON) {
+        json = malloc(json_size);
+    } else if (worker->op == BENCH_OP_HTTP) {
+        request_len = snprintf(request, sizeof(request),
+                               "GET %s HTTP/1.1\r\nHost: bench\r\nAccept: */*\r\n\r\n", worker->http_path);
+    } else if (worker->op == BENCH_OP_INGEST || worker->op == BENCH_OP_INGEST_PER_FRAME) {
+        encoded_len = encode_frames(encoded, sizeof(encoded), &frames);
+    }
+
+    while (!g_bench_started) {
+        sched_yield();
+    }
+    t_allocs = t_locks = t_contended = t_wait_ns = 0;
+    uint64_t start = bench_now_ns();
+
+    while (g_bench_running) {
+        switch (worker->op) {
+        case BENCH_OP_ADD:
+            add_sensor_data((int)(worker->ops % BENCH_SOURCES), value, 1000.0);
+            value += 0.5;
+            break;
+        case BENCH_OP_JSON:
+            get_sensor_data_json(-1, json, json_size);
+            break;
+        case BENCH_OP_HTTP:
+            http_send_all(worker->sock[0], request, request_len);
+            handle_http_request(worker->sock[1]);
+            break;
+        case BENCH_OP_INGEST:
+            memcpy(received, encoded, encoded_len);
+            tls_client_ingest(0, received, encoded_len);
+            worker->ops += frames;
+            continue;
+        case BENCH_OP_INGEST_PER_FRAME:
+            memcpy(received, encoded, encoded_len);
+            ingest_per_frame(0, received, encoded_len);
+            worker->ops += frames;
+            continue;
+        }
+        worker->ops++;
+    }
+
+    worker->elapsed_ns = bench_now_ns() - start;
+    worker->allocs = t_allocs;
+    worker->locks = t_locks;
+    worker->contended = t_contended;
+    worker->wait_ns = t_wait_ns;
+    free(json);
+    return NULL;
+}
+
+static void print_row(int csv, int capacity, const bench_scenario_t* scenario, bench_op_t op,
+                      const bench_worker_t* workers, int count) {
+    uint64_t ops = 0, allocs = 0, locks = 0, contended = 0, wait_ns = 0, elapsed_ns = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (workers[i].op != op) {
+            continue;
+        }
+        ops += workers[i].ops;
+        allocs += workers[i].allocs;
+        locks += workers[i].locks;
+        contended += workers[i].contended;
+        wait_ns += workers[i].wait_ns;
+        elapsed_ns += workers[i].elapsed_ns;
+    }
+    if (ops == 0) {
+        return;
+    }
+
+    double per_op = 1.0 / (double)ops;
+    if (csv) {
+        printf("%d,%s,%s,%llu,%.1f,%.3f,%.3f,%.2f,%.1f\n", capacity, scenario->name, g_op_names[op],
+               (unsigned long long)ops, elapsed_ns * per_op, allocs * per_op, locks * per_op,
+               locks ? 100.0 * contended / locks : 0.0, wait_ns * per_op);
+    } else {
+        printf("%8d  %-20s %-20s %10llu %12.1f %10.3f %9.3f %9.2f%% %10.1f\n", capacity, scenario->name,
+               g_op_names[op], (unsigned long long)ops, elapsed_ns * per_op, allocs * per_op,
+               locks * per_op, locks ? 100.0 * contended / locks : 0.0, wait_ns * per_op);
+    }
+}
+
+static int run_scenario(int capacity, const bench_scenario_t* scenario, int duration_ms, int csv) {
+    bench_worker_t workers[BENCH_MAX_THREADS];
+    pthread_t threads[BENCH_MAX_THREADS];
+    int count = 0;
+
+    memset(workers, 0, sizeof(workers));
+    for (int i = 0; i < scenario->writers; i++) {
+        workers[count].op = BENCH_OP_ADD;
+        workers[count].index = i;
+        count++;
+    }
+    for (int i = 0; i < scenario->json_readers; i++) {
+        workers[count].op = BENCH_OP_JSON;
+        workers[count].index = i;
+        count++;
+    }
+    for (int i = 0; i < scenario->receivers; i++) {
+        workers[count].op = BENCH_OP_INGEST;
+        workers[count].index = i;
+        count++;
+    }
+    for (int i = 0; i < scenario->per_frame_receivers; i++) {
+        workers[count].op = BENCH_OP_INGEST_PER_FRAME;
+        workers[count].index = i;
+        count++;
+    }
+    if (scenario->http_path) {
+        bench_worker_t* worker = &workers[count++];
+        worker->op = BENCH_OP_HTTP;
+        worker->http_path = scenario->http_path;
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, worker->sock) != 0 ||
+            pthread_create(&worker->drain_thread, NULL, drain_thread, &worker->sock[0]) != 0) {
+            perror("bench: socketpair");
+            return -1;
+        }
+    }
+
+    // Every scenario starts from a full store
+    for (int i = 0; i < capacity; i++) {
+        add_sensor_data(i % BENCH_SOURCES, 60000.0 + i, 1000.0 + i);
+    }
+
+    g_bench_running = 1;
+    g_bench_started = 0;
+    for (int i = 0; i < count; i++) {
+        pthread_create(&threads[i], NULL, worker_thread, &workers[i]);
+    }
+    g_bench_started = 1;
+    usleep(duration_ms * 1000);
+    g_bench_running = 0;
+    for (int i = 0; i < count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (workers[i].op == BENCH_OP_HTTP) {
+            shutdown(workers[i].sock[1], SHUT_RDWR);
+            pthread_join(workers[i].drain_thread, NULL);
+            close(workers[i].sock[0]);
+            close(workers[i].sock[1]);
+        }
+    }
+
+    print_row(csv, capacity, scenario, BENCH_OP_ADD, workers, count);
+    print_row(csv, capacity, scenario, BENCH_OP_JSON, workers, count);
+    print_row(csv, capacity, scenario, BENCH_OP_HTTP, workers, count);
+    print_row(csv, capacity, scenario, BENCH_OP_INGEST, workers, count);
+    print_row(csv, capacity, scenario, BENCH_OP_INGEST_PER_FRAME, workers, count);
+    fflush(stdout);
+    return 0;
+}
+
+static void bench_usage(const char* program_name) {
+    printf("Usage: %s [--duration-ms ms] [--capacity points] [--csv]\n", program_name);
+    printf("  --duration-ms: run time of each scenario (default: %d)\n", BENCH_DEFAULT_DURATION_MS);
+    printf("  --capacity:    only benchmark this store capacity (default: 64, 1024, 16384)\n");
+    printf("  --csv:         machine-readable output for baselines\n");
+}
+
+int main(int argc, char* argv[]) {
+    int duration_ms = BENCH_DEFAULT_DURATION_MS;
+    int only_capacity = 0;
+    int csv = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--duration-ms") == 0 && i + 1 < argc) {
+            duration_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc) {
+            only_capacity = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = 1;
+        } else {
+            bench_usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+    if (duration_ms <= 0 || only_capacity < 0) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+
+    // Responses are discarded by the drain threads; a closed peer must not kill the run
+    signal(SIGPIPE, SIG_IGN);
+    g_log_level = LOG_LEVEL_ERROR;
+    for (int i = 0; i < BENCH_SOURCES; i++) {
+        char name[DATA_SOURCE_NAME_SIZE];
+        snprintf(name, sizeof(name), "bench-%d", i);
+        register_data_source(name);
+    }
+
+    // Store setup messages go to stderr so that stdout holds only results
+    int saved_stdout = dup(STDOUT_FILENO);
+
+    if (csv) {
+        printf("capacity,scenario,operation,ops,ns_per_op,allocs_per_op,locks_per_op,contended_pct,wait_ns_per_op\n");
+    } else {
+        printf("%8s  %-20s %-20s %10s %12s %10s %9s %10s %10s\n", "capacity", "scenario", "operation",
+               "ops", "ns/op", "allocs/op", "locks/op", "contended", "wait ns/op");
+    }
+
+    for (size_t c = 0; c < sizeof(g_capacities) / sizeof(g_capacities[0]) || only_capacity; c++) {
+        int capacity = only_capacity ? only_capacity : g_capacities[c];
+
+        fflush(stdout);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        pthread_mutex_init(&g_data_mutex, NULL);
+        init_data_storage(capacity);
+        int ready = g_sensor_store.capacity == capacity && http_responses_init() == 0;
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        if (!ready) {
+            fprintf(stderr, "bench: failed to set up a store of %d points\n", capacity);
+            return 1;
+        }
+
+        for (size_t s = 0; s < sizeof(g_scenarios) / sizeof(g_scenarios[0]); s++) {
+            if (run_scenario(capacity, &g_scenarios[s], duration_ms, csv) != 0) {
+                return 1;
+            }
+        }
+
+        fflush(stdout);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        http_responses_cleanup();
+        cleanup_data_storage();
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        if (only_capacity) {
+            break;
+        }
+    }
+
+    close(saved_stdout);
+    return 0;
+}
@@ -0,0 +1,140 @@
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "kernels.h"
+
+// 数值内核基准：make bench
+//
+// 对本机支持的每个后端，先与标量实现比对结果（含 NaN 输入和非向量宽度倍数的长度），
+// 再测量每个数据点的耗时。结果不一致时以非零状态退出。
+
+#define BENCH_VALUES 4096
+#define BENCH_ITERATIONS 2000
+#define BENCH_SEED 0x5eedULL
+
+static double g_values[BENCH_VALUES];
+static double g_reference[BENCH_VALUES];
+static double g_output[BENCH_VALUES];
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int same_value(double a, double b) {
+    return (isnan(a) && isnan(b)) || a == b;
+}
+
+static int close_value(double a, double b) {
+    if (isnan(a) || isnan(b)) {
+        return isnan(a) && isnan(b);
+    }
+    return fabs(a - b) <= 1e-9 * fmax(1.0, fmax(fabs(a), fabs(b)));
+}
+
+// Compare one backend against the scalar reference; returns the number of mismatches
+static int check_backend(kernel_backend_t backend) {
+    static const size_t lengths[] = { 0, 1, 3, 4, 7, 8, 15, 33, 1000, BENCH_VALUES };
+    int errors = 0;
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        size_t n = lengths[l];
+        kernel_stats_t expected, actual;
+        kernel_rng_t rng;
+
+        kernel_set_backend(KERNEL_BACKEND_SCALAR);
+        kernel_stats_init(&expected);
+        kernel_stats_accumulate(&expected, g_values, n);
+        kernel_rng_seed(&rng, BENCH_SEED + n);
+        kernel_normal_fill(&rng, g_reference, n, 61000.0, 1000.0);
+
+        kernel_set_backend(backend);
+        kernel_stats_init(&actual);
+        kernel_stats_accumulate(&actual, g_values, n);
+        kernel_rng_seed(&rng, BENCH_SEED + n);
+        kernel_normal_fill(&rng, g_output, n, 61000.0, 1000.0);
+
+        if (actual.count != expected.count || !same_value(actual.min, expected.min) ||
+            !same_value(actual.max, expected.max) || !close_value(actual.sum, expected.sum) ||
+            !close_value(actual.sum_sq, expected.sum_sq)) {
+            fprintf(stderr, "%s: statistics differ from scalar for n=%zu\n", kernel_backend_name(backend), n);
+            errors++;
+        }
+        if (memcmp(g_output, g_reference, n * sizeof(double)) != 0) {
+            fprintf(stderr, "%s: normal samples differ from scalar for n=%zu\n", kernel_backend_name(backend), n);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+static double time_stats(void) {
+    kernel_stats_t stats;
+    volatile double sink = 0;
+    double start = now_ns();
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        kernel_stats_init(&stats);
+        kernel_stats_accumulate(&stats, g_values, BENCH_VALUES);
+        sink += stats.sum;
+    }
+    (void)sink;
+    return (now_ns() - start) / ((double)BENCH_ITERATIONS * BENCH_VALUES);
+}
+
+static double time_normal(void) {
+    kernel_rng_t rng;
+    double start = now_ns();
+
+    kernel_rng_seed(&rng, BENCH_SEED);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        kernel_normal_fill(&rng, g_output, BENCH_VALUES, 0.0, 1.0);
+    }
+    return (now_ns() - start) / ((double)BENCH_ITERATIONS * BENCH_VALUES);
+}
+
+int main(void) {
+    kernel_rng_t rng;
+    double scalar_stats = 0, scalar_normal = 0;
+    int errors = 0;
+
+    // Sensor-like input with unsubscribed (NaN) samples mixed in
+    kernel_rng_seed(&rng, BENCH_SEED);
+    kernel_set_backend(KERNEL_BACKEND_SCALAR);
+    kernel_normal_fill(&rng, g_values, BENCH_VALUES, 61000.0, 1000.0);
+    for (int i = 0; i < BENCH_VALUES; i += 7) {
+        g_values[i] = NAN;
+    }
+
+    printf("%-8s %14s %14s %10s\n", "backend", "stats ns/val", "normal ns/val", "speedup");
+    for (int b = 0; b < KERNEL_BACKEND_COUNT; b++) {
+        kernel_backend_t backend = (kernel_backend_t)b;
+        if (!kernel_backend_supported(backend)) {
+            printf("%-8s %14s\n", kernel_backend_name(backend), "unsupported");
+            continue;
+        }
+        int backend_errors = (backend == KERNEL_BACKEND_SCALAR) ? 0 : check_backend(backend);
+        errors += backend_errors;
+
+        kernel_set_backend(backend);
+        double stats_ns = time_stats();
+        double normal_ns = time_normal();
+        if (backend == KERNEL_BACKEND_SCALAR) {
+            scalar_stats = stats_ns;
+            scalar_normal = normal_ns;
+        }
+        printf("%-8s %14.3f %14.3f %4.1fx/%.1fx%s\n", kernel_backend_name(backend), stats_ns, normal_ns,
+               scalar_stats / stats_ns, scalar_normal / normal_ns, backend_errors ? "  MISMATCH" : "");
+    }
+
+    if (errors > 0) {
+        fprintf(stderr, "%d mismatches against the scalar reference\n", errors);
+        return 1;
+    }
+    return 0;
+}
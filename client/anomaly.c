@@ -0,0 +1,229 @@
+#include "client.h"
+
+// 在线异常检测：每个来源的每个通道各一组检测器，在 add_sensor_data_batch 持有
+// g_data_mutex 时逐点更新，每个数据点只做固定次数的运算（一次开方、一次除法），
+// 不需要单独的分析进程。
+//
+//   滚动 z 分数  以最近 ANOMALY_WINDOW 个数据点的均值和标准差为基线，
+//                z = (x - 均值) / 标准差，|z| >= ANOMALY_Z_LIMIT 为离群点
+//   EWMA         e = λx + (1-λ)e，与基线均值之差以 EWMA 的标准差
+//                σ·sqrt(λ/(2-λ)) 为单位，越过 ±ANOMALY_EWMA_LIMIT 表示持续偏移
+//   CUSUM        S+ = max(0, S+ + z - k)，S- = max(0, S- - z - k)，任一越过
+//                ANOMALY_CUSUM_H 表示缓慢漂移，标记后两者清零重新累积
+//
+// 基线只用当前数据点之前的窗口，窗口填满之前不给出得分。窗口内保存与第一个数据点
+// 的差值，避免转速这类大数值的平方和抵消掉方差；每滑过一整个窗口重新求和一次，
+// 不累积舍入误差。
+
+#define ANOMALY_WINDOW_MASK (ANOMALY_WINDOW - 1)
+
+_Static_assert((ANOMALY_WINDOW & ANOMALY_WINDOW_MASK) == 0, "ANOMALY_WINDOW must be a power of two");
+
+typedef struct {
+    double window[ANOMALY_WINDOW];  // 与 reference 的差值
+    double reference;
+    double sum;
+    double sum_sq;
+    int filled;
+    int next;
+    double ewma;                    // 与 reference 的差值
+    anomaly_stats_t stats;
+} detector_t;
+
+static detector_t g_detectors[MAX_DATA_SOURCES][CHANNEL_COUNT];
+
+static void resum_window(detector_t* detector) {
+    double sum = 0.0, sum_sq = 0.0;
+
+    for (int i = 0; i < ANOMALY_WINDOW; i++) {
+        sum += detector->window[i];
+        sum_sq += detector->window[i] * detector->window[i];
+    }
+    detector->sum = sum;
+    detector->sum_sq = sum_sq;
+}
+
+// Called with g_data_mutex held: run the detectors of one channel over the
+// samples of a batch and add their ANOMALY_FLAG bits to flags[i]. The state is
+// kept in locals for the whole batch; unsubscribed samples (NaN) are skipped.
+void anomaly_update(int source, int channel, const double* values, int count, uint8_t* flags) {
+    const double ewma_scale = 1.0 / sqrt(ANOMALY_EWMA_LAMBDA / (2.0 - ANOMALY_EWMA_LAMBDA));
+
+    if (source < 0 || source >= MAX_DATA_SOURCES) {
+        return;
+    }
+
+    detector_t* detector = &g_detectors[source][channel];
+    anomaly_stats_t* stats = &detector->stats;
+    double* window = detector->window;
+    double reference = detector->reference;
+    double sum = detector->sum, sum_sq = detector->sum_sq, ewma = detector->ewma;
+    double cusum_high = stats->cusum_high, cusum_low = stats->cusum_low;
+    double mean = 0.0, stddev = 0.0, z = 0.0, ewma_score = 0.0;
+    int filled = detector->filled, next = detector->next;
+    int scored = 0;
+    unsigned last_flags = 0;
+    uint64_t events[ANOMALY_DETECTORS] = { 0, 0, 0 };
+
+    for (int i = 0; i < count; i++) {
+        double value = values[i];
+        if (isnan(value)) {
+            continue;
+        }
+        if (filled == 0) {
+            reference = value;
+        }
+        double x = value - reference;
+
+        if (filled == ANOMALY_WINDOW) {
+            unsigned sample_flags = 0;
+            mean = sum * (1.0 / ANOMALY_WINDOW);
+            double variance = (sum_sq - sum * mean) * (1.0 / (ANOMALY_WINDOW - 1));
+            // A flat signal has no spread to measure against; any change then stands out
+            stddev = sqrt(variance > 0.0 ? variance : 0.0) + 1e-9 * (1.0 + fabs(reference));
+            double inv_stddev = 1.0 / stddev;
+
+            z = (x - mean) * inv_stddev;
+            if (fabs(z) >= ANOMALY_Z_LIMIT) {
+                sample_flags |= ANOMALY_Z;
+            }
+
+            ewma += ANOMALY_EWMA_LAMBDA * (x - ewma);
+            ewma_score = (ewma - mean) * inv_stddev * ewma_scale;
+            if (fabs(ewma_score) >= ANOMALY_EWMA_LIMIT) {
+                sample_flags |= ANOMALY_EWMA;
+            }
+
+            // max(s, 0) as (s + |s|) / 2, exact and without a branch: the sums
+            // hover around zero, where a branch would mispredict half the time
+            cusum_high += z - ANOMALY_CUSUM_K;
+            cusum_low -= z + ANOMALY_CUSUM_K;
+            cusum_high = 0.5 * (cusum_high + fabs(cusum_high));
+            cusum_low = 0.5 * (cusum_low + fabs(cusum_low));
+            if (cusum_high >= ANOMALY_CUSUM_H || cusum_low >= ANOMALY_CUSUM_H) {
+                sample_flags |= ANOMALY_CUSUM;
+                cusum_high = cusum_low = 0.0;
+            }
+
+            if (sample_flags) {
+                events[0] += sample_flags & ANOMALY_Z ? 1 : 0;
+                events[1] += sample_flags & ANOMALY_EWMA ? 1 : 0;
+                events[2] += sample_flags & ANOMALY_CUSUM ? 1 : 0;
+                flags[i] |= (uint8_t)ANOMALY_FLAG(channel, sample_flags);
+            }
+            last_flags = sample_flags;
+            scored = 1;
+
+            // Slide the window
+            double old = window[next];
+            sum -= old;
+            sum_sq -= old * old;
+        } else {
+            filled++;
+        }
+
+        window[next] = x;
+        sum += x;
+        sum_sq += x * x;
+        next = (next + 1) & ANOMALY_WINDOW_MASK;
+
+        if (next == 0 && filled == ANOMALY_WINDOW) {
+            detector->sum = sum;
+            detector->sum_sq = sum_sq;
+            resum_window(detector);
+            sum = detector->sum;
+            sum_sq = detector->sum_sq;
+            // The EWMA starts from the baseline once there is one
+            if (!stats->ready && !scored) {
+                ewma = sum * (1.0 / ANOMALY_WINDOW);
+            }
+        }
+    }
+
+    detector->reference = reference;
+    detector->sum = sum;
+    detector->sum_sq = sum_sq;
+    detector->ewma = ewma;
+    detector->filled = filled;
+    detector->next = next;
+    stats->cusum_high = cusum_high;
+    stats->cusum_low = cusum_low;
+    if (scored) {
+        stats->ready = 1;
+        stats->mean = mean + reference;
+        stats->stddev = stddev;
+        stats->z = z;
+        stats->ewma = ewma_score;
+        stats->flags = last_flags;
+        for (int d = 0; d < ANOMALY_DETECTORS; d++) {
+            stats->events[d] += events[d];
+        }
+    }
+}
+
+// Called with g_data_mutex held, when the store is (re)initialized
+void anomaly_reset(void) {
+    memset(g_detectors, 0, sizeof(g_detectors));
+}
+
+// Scores as JSON numbers of bounded width; a non-finite score becomes null
+static const char* format_score(char* buf, size_t size, double value) {
+    if (!isfinite(value)) {
+        return "null";
+    }
+    snprintf(buf, size, "%.10g", value);
+    return buf;
+}
+
+// Longest source entry: the name plus two channels of bounded-width numbers
+#define ANOMALY_SOURCE_JSON_MAX (DATA_SOURCE_NAME_SIZE + 2 * 400)
+
+// Current scores of every source as the "anomaly" object of /api/stats.
+// Returns the length, or 0 if the buffer is too small.
+size_t get_anomaly_json(char* out, size_t size) {
+    static const char* const channel_names[CHANNEL_COUNT] = { "centrifugeSpeed", "powerOutput" };
+    char* p = out;
+    char* end = out + size;
+
+    if (size < 64 + ANOMALY_SOURCE_JSON_MAX) {
+        return 0;
+    }
+    p += snprintf(p, end - p, "{\"window\":%d,\"sources\":[", ANOMALY_WINDOW);
+
+    for (int source = 0; source < MAX_DATA_SOURCES && (size_t)(end - p) >= 8 + ANOMALY_SOURCE_JSON_MAX; source++) {
+        char name[DATA_SOURCE_NAME_SIZE];
+        anomaly_stats_t stats[CHANNEL_COUNT];
+
+        if (get_data_source_name(source, name, sizeof(name)) != 0) {
+            break;
+        }
+        pthread_mutex_lock(&g_data_mutex);
+        for (int channel = 0; channel < CHANNEL_COUNT; channel++) {
+            stats[channel] = g_detectors[source][channel].stats;
+        }
+        pthread_mutex_unlock(&g_data_mutex);
+
+        p += snprintf(p, end - p, "%s{\"source\":\"%s\"", source > 0 ? "," : "", name);
+        for (int channel = 0; channel < CHANNEL_COUNT; channel++) {
+            const anomaly_stats_t* c = &stats[channel];
+            char mean[32], stddev[32], z[32], ewma[32], high[32], low[32];
+            if (!c->ready) {
+                p += snprintf(p, end - p, ",\"%s\":{\"ready\":false}", channel_names[channel]);
+                continue;
+            }
+            p += snprintf(p, end - p,
+                ",\"%s\":{\"ready\":true,\"mean\":%s,\"stddev\":%s,\"z\":%s,\"ewma\":%s,"
+                "\"cusumHigh\":%s,\"cusumLow\":%s,\"flags\":%u,"
+                "\"events\":{\"z\":%llu,\"ewma\":%llu,\"cusum\":%llu}}",
+                channel_names[channel],
+                format_score(mean, sizeof(mean), c->mean), format_score(stddev, sizeof(stddev), c->stddev),
+                format_score(z, sizeof(z), c->z), format_score(ewma, sizeof(ewma), c->ewma),
+                format_score(high, sizeof(high), c->cusum_high), format_score(low, sizeof(low), c->cusum_low),
+                c->flags, (unsigned long long)c->events[0], (unsigned long long)c->events[1],
+                (unsigned long long)c->events[2]);
+        }
+        p += snprintf(p, end - p, "}");
+    }
+    p += snprintf(p, end - p, "]}");
+    return (size_t)(p - out);
+}
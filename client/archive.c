@@ -0,0 +1,481 @@
+#include "client.h"
+
+// 长期保留：Gorilla 风格的压缩数据块
+//
+// 每个新数据点先写入未压缩的当前块；写满 ARCHIVE_BLOCK_ROWS 个后压缩（封存）
+// 进启动时预留的环形存储区，空间不足时淘汰最旧的块。编码方式：
+//   时间戳  差值的差值（delta-of-delta），等间隔采样每点 1 位
+//   数值    与上一个值按位异或，只保存有效位；变化缓慢的信号每点几位
+//   来源    与上一个相同时 1 位
+// 查询时按需解码单个块（最近解码的块会被缓存），当前块直接读取。
+//
+// 数据点按到达顺序追加，时间戳是服务端的采样时间：重连后补发的数据比其他来源
+// 已写入的数据更早，因此时间戳在块之间不保证递增。每个块记录自己的时间范围，
+// 以及到该块为止的最大时间戳（单调不减，用于按时间二分查找起点）。
+//
+// 除 archive_init/archive_cleanup/archive_get_stats 外，所有函数都在持有
+// g_data_mutex 时调用。
+
+typedef struct {
+    uint64_t first_seq;        // 块内第一个数据点的全局序号
+    int64_t min_ts;            // 块内的时间范围
+    int64_t max_ts;
+    int64_t max_ts_so_far;     // 到本块为止所有块的最大时间戳
+    size_t offset;             // 在存储区中的偏移
+    uint32_t bytes;
+} archive_block_t;
+
+typedef struct {
+    uint64_t prev;
+    int leading;               // 上一个有效位窗口，leading < 0 表示尚无窗口
+    int trailing;
+} xor_state_t;
+
+typedef struct {
+    unsigned char* data;
+    size_t size;
+    uint64_t bits;             // 已读写的位数
+} bit_stream_t;
+
+typedef struct {
+    unsigned char* data;       // 压缩块的环形存储区
+    size_t size;
+    size_t write_offset;
+    size_t used_bytes;
+    archive_block_t* blocks;   // 块描述符环，按时间从旧到新
+    int max_blocks;
+    int first_block;
+    int block_count;
+    uint64_t sealed_seq;       // 当前块第一个数据点的全局序号
+    uint64_t appended;
+    archive_rows_t open;       // 未压缩的当前块
+    int64_t open_min_ts;       // 当前块的时间范围
+    int64_t open_max_ts;
+    int64_t max_ts;            // 已追加的所有数据点的最大时间戳
+    archive_rows_t decoded;    // 最近解码的封存块
+    unsigned char* encode_buffer;
+} archive_t;
+
+// Worst case per row: 68 bits of timestamp, 77 bits per value, 9 bits of source
+#define ARCHIVE_ROW_MAX_BYTES 32
+#define ARCHIVE_BLOCK_MAX_BYTES (ARCHIVE_BLOCK_ROWS * ARCHIVE_ROW_MAX_BYTES + 64)
+// Best case: 4 bits per row after the raw first row
+#define ARCHIVE_BLOCK_MIN_BYTES (ARCHIVE_BLOCK_ROWS / 2)
+#define ARCHIVE_NO_BLOCK UINT64_MAX
+
+static archive_t g_archive;
+
+static void put_bits(bit_stream_t* s, uint64_t value, int count) {
+    while (count > 0) {
+        size_t byte = (size_t)(s->bits >> 3);
+        int room = 8 - (int)(s->bits & 7);
+        int take = count < room ? count : room;
+        unsigned chunk = (unsigned)(value >> (count - take)) & ((1u << take) - 1);
+
+        s->data[byte] |= (unsigned char)(chunk << (room - take));
+        s->bits += take;
+        count -= take;
+    }
+}
+
+static uint64_t get_bits(bit_stream_t* s, int count) {
+    uint64_t value = 0;
+
+    while (count > 0) {
+        size_t byte = (size_t)(s->bits >> 3);
+        int room = 8 - (int)(s->bits & 7);
+        int take = count < room ? count : room;
+        unsigned chunk = byte < s->size ? s->data[byte] : 0;
+
+        value = (value << take) | ((chunk >> (room - take)) & ((1u << take) - 1));
+        s->bits += take;
+        count -= take;
+    }
+    return value;
+}
+
+static uint64_t double_bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double bits_double(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static int64_t sign_extend(uint64_t value, int bits) {
+    uint64_t sign = 1ULL << (bits - 1);
+    return (int64_t)((value ^ sign) - sign);
+}
+
+// Delta-of-delta buckets: control bits '0', '10', '110', '1110', '1111'
+static void put_dod(bit_stream_t* s, int64_t dod) {
+    if (dod == 0) {
+        put_bits(s, 0, 1);
+    } else if (dod >= -64 && dod < 64) {
+        put_bits(s, 0x2, 2);
+        put_bits(s, (uint64_t)dod, 7);
+    } else if (dod >= -256 && dod < 256) {
+        put_bits(s, 0x6, 3);
+        put_bits(s, (uint64_t)dod, 9);
+    } else if (dod >= -2048 && dod < 2048) {
+        put_bits(s, 0xe, 4);
+        put_bits(s, (uint64_t)dod, 12);
+    } else {
+        put_bits(s, 0xf, 4);
+        put_bits(s, (uint64_t)dod, 64);
+    }
+}
+
+static int64_t get_dod(bit_stream_t* s) {
+    if (get_bits(s, 1) == 0) {
+        return 0;
+    }
+    if (get_bits(s, 1) == 0) {
+        return sign_extend(get_bits(s, 7), 7);
+    }
+    if (get_bits(s, 1) == 0) {
+        return sign_extend(get_bits(s, 9), 9);
+    }
+    if (get_bits(s, 1) == 0) {
+        return sign_extend(get_bits(s, 12), 12);
+    }
+    return (int64_t)get_bits(s, 64);
+}
+
+// XOR against the previous value: '0' unchanged, '10' meaningful bits in the
+// previous window, '11' new window (5 bits leading zeros, 6 bits length - 1)
+static void put_xor(bit_stream_t* s, xor_state_t* state, double value) {
+    uint64_t bits = double_bits(value);
+    uint64_t x = bits ^ state->prev;
+
+    state->prev = bits;
+    if (x == 0) {
+        put_bits(s, 0, 1);
+        return;
+    }
+
+    int leading = __builtin_clzll(x);
+    int trailing = __builtin_ctzll(x);
+    if (leading > 31) {
+        leading = 31;
+    }
+    if (state->leading >= 0 && leading >= state->leading && trailing >= state->trailing) {
+        put_bits(s, 0x2, 2);
+        put_bits(s, x >> state->trailing, 64 - state->leading - state->trailing);
+        return;
+    }
+
+    int significant = 64 - leading - trailing;
+    put_bits(s, 0x3, 2);
+    put_bits(s, (uint64_t)leading, 5);
+    put_bits(s, (uint64_t)(significant - 1), 6);
+    put_bits(s, x >> trailing, significant);
+    state->leading = leading;
+    state->trailing = trailing;
+}
+
+static double get_xor(bit_stream_t* s, xor_state_t* state) {
+    if (get_bits(s, 1) != 0) {
+        if (get_bits(s, 1) != 0) {
+            state->leading = (int)get_bits(s, 5);
+            int significant = (int)get_bits(s, 6) + 1;
+            state->trailing = 64 - state->leading - significant;
+        }
+        int significant = 64 - state->leading - state->trailing;
+        state->prev ^= get_bits(s, significant) << state->trailing;
+    }
+    return bits_double(state->prev);
+}
+
+// Compress rows into out (zeroed, ARCHIVE_BLOCK_MAX_BYTES); returns the size in bytes
+static size_t encode_block(const archive_rows_t* rows, unsigned char* out) {
+    bit_stream_t s = { out, ARCHIVE_BLOCK_MAX_BYTES, 0 };
+    xor_state_t speed = { 0, -1, 0 };
+    xor_state_t power = { 0, -1, 0 };
+    int64_t prev_ts = rows->timestamp_ms[0];
+    int64_t prev_delta = 0;
+    uint8_t prev_source = rows->source[0];
+
+    put_bits(&s, (uint64_t)prev_ts, 64);
+    put_bits(&s, prev_source, 8);
+    for (int i = 0; i < rows->rows; i++) {
+        if (i > 0) {
+            int64_t delta = (int64_t)((uint64_t)rows->timestamp_ms[i] - (uint64_t)prev_ts);
+            put_dod(&s, (int64_t)((uint64_t)delta - (uint64_t)prev_delta));
+            prev_ts = rows->timestamp_ms[i];
+            prev_delta = delta;
+
+            if (rows->source[i] == prev_source) {
+                put_bits(&s, 0, 1);
+            } else {
+                put_bits(&s, 1, 1);
+                put_bits(&s, rows->source[i], 8);
+                prev_source = rows->source[i];
+            }
+        }
+        put_xor(&s, &speed, rows->centrifuge_speed[i]);
+        put_xor(&s, &power, rows->power_output[i]);
+    }
+    return (size_t)((s.bits + 7) >> 3);
+}
+
+static void decode_block(const archive_block_t* block, archive_rows_t* rows) {
+    bit_stream_t s = { g_archive.data + block->offset, block->bytes, 0 };
+    xor_state_t speed = { 0, -1, 0 };
+    xor_state_t power = { 0, -1, 0 };
+    int64_t ts = (int64_t)get_bits(&s, 64);
+    int64_t delta = 0;
+    uint8_t source = (uint8_t)get_bits(&s, 8);
+
+    for (int i = 0; i < ARCHIVE_BLOCK_ROWS; i++) {
+        if (i > 0) {
+            delta = (int64_t)((uint64_t)delta + (uint64_t)get_dod(&s));
+            ts = (int64_t)((uint64_t)ts + (uint64_t)delta);
+            if (get_bits(&s, 1) != 0) {
+                source = (uint8_t)get_bits(&s, 8);
+            }
+        }
+        rows->timestamp_ms[i] = ts;
+        rows->source[i] = source;
+        rows->centrifuge_speed[i] = get_xor(&s, &speed);
+        rows->power_output[i] = get_xor(&s, &power);
+    }
+    rows->first_seq = block->first_seq;
+    rows->rows = ARCHIVE_BLOCK_ROWS;
+}
+
+static void evict_oldest(void) {
+    archive_block_t* oldest = &g_archive.blocks[g_archive.first_block];
+
+    if (g_archive.decoded.first_seq == oldest->first_seq) {
+        g_archive.decoded.first_seq = ARCHIVE_NO_BLOCK;
+    }
+    g_archive.used_bytes -= oldest->bytes;
+    g_archive.first_block = (g_archive.first_block + 1) % g_archive.max_blocks;
+    g_archive.block_count--;
+}
+
+// Compress the full head block into the ring, evicting the oldest blocks it overlaps
+static void seal_open_block(void) {
+    archive_rows_t* open = &g_archive.open;
+    unsigned char* buffer = g_archive.encode_buffer;
+
+    memset(buffer, 0, ARCHIVE_BLOCK_MAX_BYTES);
+    size_t bytes = encode_block(open, buffer);
+
+    // Blocks are laid out in time order, so the oldest ones sit right after the
+    // write position; wrapping first retires those left at the end of the area
+    if (g_archive.write_offset + bytes > g_archive.size) {
+        while (g_archive.block_count > 0 &&
+               g_archive.blocks[g_archive.first_block].offset >= g_archive.write_offset) {
+            evict_oldest();
+        }
+        g_archive.write_offset = 0;
+    }
+    while (g_archive.block_count > 0) {
+        archive_block_t* oldest = &g_archive.blocks[g_archive.first_block];
+        int overlaps = oldest->offset < g_archive.write_offset + bytes &&
+                       g_archive.write_offset < oldest->offset + oldest->bytes;
+        if (!overlaps && g_archive.block_count < g_archive.max_blocks) {
+            break;
+        }
+        evict_oldest();
+    }
+
+    archive_block_t* block = &g_archive.blocks[(g_archive.first_block + g_archive.block_count) %
+                                               g_archive.max_blocks];
+    block->first_seq = open->first_seq;
+    block->min_ts = g_archive.open_min_ts;
+    block->max_ts = g_archive.open_max_ts;
+    block->max_ts_so_far = g_archive.max_ts;
+    block->offset = g_archive.write_offset;
+    block->bytes = (uint32_t)bytes;
+    memcpy(g_archive.data + block->offset, buffer, bytes);
+    g_archive.block_count++;
+    g_archive.write_offset += bytes;
+    g_archive.used_bytes += bytes;
+
+    g_archive.sealed_seq = g_archive.appended;
+    open->first_seq = g_archive.sealed_seq;
+    open->rows = 0;
+}
+
+static int alloc_rows(archive_rows_t* rows) {
+    rows->timestamp_ms = malloc(ARCHIVE_BLOCK_ROWS * sizeof(int64_t));
+    rows->centrifuge_speed = malloc(ARCHIVE_BLOCK_ROWS * sizeof(double));
+    rows->power_output = malloc(ARCHIVE_BLOCK_ROWS * sizeof(double));
+    rows->source = malloc(ARCHIVE_BLOCK_ROWS);
+    rows->first_seq = ARCHIVE_NO_BLOCK;
+    rows->rows = 0;
+    return (rows->timestamp_ms && rows->centrifuge_speed && rows->power_output && rows->source) ? 0 : -1;
+}
+
+static void free_rows(archive_rows_t* rows) {
+    free(rows->timestamp_ms);
+    free(rows->centrifuge_speed);
+    free(rows->power_output);
+    free(rows->source);
+}
+
+int archive_init(size_t bytes) {
+    archive_t* archive = &g_archive;
+
+    pthread_mutex_lock(&g_data_mutex);
+    memset(archive, 0, sizeof(*archive));
+    archive->size = bytes;
+    archive->max_blocks = (int)(bytes / ARCHIVE_BLOCK_MIN_BYTES) + 1;
+    archive->data = malloc(bytes);
+    archive->blocks = calloc(archive->max_blocks, sizeof(archive_block_t));
+    archive->encode_buffer = malloc(ARCHIVE_BLOCK_MAX_BYTES);
+
+    int failed = bytes < ARCHIVE_BLOCK_MAX_BYTES || !archive->data || !archive->blocks ||
+                 !archive->encode_buffer || alloc_rows(&archive->open) != 0 ||
+                 alloc_rows(&archive->decoded) != 0;
+    if (failed) {
+        pthread_mutex_unlock(&g_data_mutex);
+        fprintf(stderr, "Failed to reserve %zu bytes for the archive\n", bytes);
+        archive_cleanup();
+        return -1;
+    }
+
+    // Archived sequence numbers continue the store's
+    archive->appended = g_sensor_store.appended;
+    archive->sealed_seq = archive->appended;
+    archive->open.first_seq = archive->appended;
+    memset(archive->data, 0, bytes);
+    pthread_mutex_unlock(&g_data_mutex);
+
+    memory_account("archive", bytes + archive->max_blocks * sizeof(archive_block_t) +
+                   ARCHIVE_BLOCK_MAX_BYTES +
+                   2 * ARCHIVE_BLOCK_ROWS * (sizeof(int64_t) + 2 * sizeof(double) + sizeof(uint8_t)));
+    printf("Archive initialized: %zu bytes, %d samples per block\n", bytes, ARCHIVE_BLOCK_ROWS);
+    return 0;
+}
+
+void archive_append(int64_t timestamp_ms, double centrifuge_speed, double power_output, uint8_t source) {
+    archive_rows_t* open = &g_archive.open;
+
+    if (!g_archive.data) {
+        return;
+    }
+    if (open->rows == 0 || timestamp_ms < g_archive.open_min_ts) {
+        g_archive.open_min_ts = timestamp_ms;
+    }
+    if (open->rows == 0 || timestamp_ms > g_archive.open_max_ts) {
+        g_archive.open_max_ts = timestamp_ms;
+    }
+    if (g_archive.appended == 0 || timestamp_ms > g_archive.max_ts) {
+        g_archive.max_ts = timestamp_ms;
+    }
+    open->timestamp_ms[open->rows] = timestamp_ms;
+    open->centrifuge_speed[open->rows] = centrifuge_speed;
+    open->power_output[open->rows] = power_output;
+    open->source[open->rows] = source;
+    open->rows++;
+    g_archive.appended++;
+
+    if (open->rows == ARCHIVE_BLOCK_ROWS) {
+        seal_open_block();
+    }
+}
+
+uint64_t archive_oldest_seq(void) {
+    if (g_archive.block_count > 0) {
+        return g_archive.blocks[g_archive.first_block].first_seq;
+    }
+    return g_archive.sealed_seq;
+}
+
+// First sample of the oldest block that may hold data at or after from_ms
+uint64_t archive_find_seq(int64_t from_ms) {
+    int lo = 0, hi = g_archive.block_count;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (g_archive.blocks[(g_archive.first_block + mid) % g_archive.max_blocks].max_ts_so_far < from_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < g_archive.block_count) {
+        return g_archive.blocks[(g_archive.first_block + lo) % g_archive.max_blocks].first_seq;
+    }
+    return g_archive.sealed_seq;
+}
+
+// First sample at or after seq in a block whose time range overlaps
+// [from_ms, to_ms]; blocks outside the range are skipped without decoding.
+// Returns the number of appended samples if no later block overlaps.
+uint64_t archive_next_in_range(uint64_t seq, int64_t from_ms, int64_t to_ms) {
+    uint64_t oldest = archive_oldest_seq();
+
+    if (seq < oldest) {
+        seq = oldest;
+    }
+    while (seq < g_archive.sealed_seq) {
+        int index = (int)((seq - oldest) / ARCHIVE_BLOCK_ROWS);
+        const archive_block_t* block = &g_archive.blocks[(g_archive.first_block + index) % g_archive.max_blocks];
+        if (block->min_ts <= to_ms && block->max_ts >= from_ms) {
+            return seq;
+        }
+        seq = block->first_seq + ARCHIVE_BLOCK_ROWS;
+    }
+    if (seq < g_archive.appended && g_archive.open_min_ts <= to_ms && g_archive.open_max_ts >= from_ms) {
+        return seq;
+    }
+    return g_archive.appended;
+}
+
+// Rows of the block holding sample seq: the head block as is, a sealed block
+// decoded. The result stays valid until g_data_mutex is released.
+const archive_rows_t* archive_rows_at(uint64_t seq) {
+    if (!g_archive.data || seq >= g_archive.appended || seq < archive_oldest_seq()) {
+        return NULL;
+    }
+    if (seq >= g_archive.sealed_seq) {
+        return &g_archive.open;
+    }
+
+    // Sealed blocks all hold ARCHIVE_BLOCK_ROWS samples, so the block is found by division
+    int index = (int)((seq - archive_oldest_seq()) / ARCHIVE_BLOCK_ROWS);
+    const archive_block_t* block = &g_archive.blocks[(g_archive.first_block + index) % g_archive.max_blocks];
+    if (g_archive.decoded.first_seq != block->first_seq) {
+        decode_block(block, &g_archive.decoded);
+    }
+    return &g_archive.decoded;
+}
+
+void archive_get_stats(archive_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    pthread_mutex_lock(&g_data_mutex);
+    if (g_archive.data) {
+        stats->capacity_bytes = g_archive.size;
+        stats->used_bytes = g_archive.used_bytes;
+        stats->blocks = g_archive.block_count;
+        stats->sealed_samples = (uint64_t)g_archive.block_count * ARCHIVE_BLOCK_ROWS;
+        stats->samples = stats->sealed_samples + g_archive.open.rows;
+        if (g_archive.block_count > 0) {
+            stats->oldest_ms = g_archive.blocks[g_archive.first_block].min_ts;
+        } else if (g_archive.open.rows > 0) {
+            stats->oldest_ms = g_archive.open_min_ts;
+        }
+    }
+    pthread_mutex_unlock(&g_data_mutex);
+}
+
+void archive_cleanup(void) {
+    pthread_mutex_lock(&g_data_mutex);
+    free(g_archive.data);
+    free(g_archive.blocks);
+    free(g_archive.encode_buffer);
+    free_rows(&g_archive.open);
+    free_rows(&g_archive.decoded);
+    memset(&g_archive, 0, sizeof(g_archive));
+    pthread_mutex_unlock(&g_data_mutex);
+}
@@ -1,6 +1,12 @@
 #ifndef CLIENT_H
 #define CLIENT_H
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,58 +16,297 @@
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stdint.h>
 #include <time.h>
+#include <wolfssl/options.h>
 #include <wolfssl/ssl.h>
 #include <wolfssl/error-ssl.h>
+#include "kernels.h"
+#include "log.h"
+#include "mempool.h"
+#include "protocol.h"
+#include "rt.h"
 
 // 配置常量
 #define DEFAULT_SERVER_IP "127.0.0.1"
 #define TLS_PORT 8443
 #define HTTP_PORT 8080
 #define BUFFER_SIZE 1024
-#define MAX_DATA_POINTS 50
-#define API_RESPONSE_SIZE 8192
+#define MAX_DATA_POINTS 50       // 存储总容量为此值乘以上游数，所有来源按到达顺序共用
+#define MAX_UPSTREAMS 8          // 同时连接的上游TLS服务器数量上限
+#define MAX_DATA_SOURCES MAX_UPSTREAMS
+#define DATA_SOURCE_NAME_SIZE 80
+#define API_RESPONSE_SIZE 16384  // /api/stats 响应，含每个来源的异常检测得分
+#define RX_BUFFER_SIZE 16384     // 每个上游会话的帧重组缓冲区，可容纳一个完整的TLS记录
+#define INGEST_BATCH 256         // 接收线程每批写入存储的数据点数上限
+#define RECONNECT_MIN_MS 200     // 上游断开后首次重连的等待时间，之后每次加倍
+#define RECONNECT_MAX_MS 5000
+#define CONNECT_TIMEOUT_SEC 2    // 连接加握手的总时限；两者都是非阻塞的，不会阻塞接收线程
+#define HTTP_RESPONSE_BUFFERS 1  // 预留的 /api/data 响应缓冲区数量（HTTP 请求由单线程处理）
+#define MAX_RELAY_SUBSCRIBERS 16 // 中继模式下游订阅者数量上限
+#define RELAY_QUEUE_FRAMES 64    // 每个下游订阅者的待发送帧队列长度
+#define RELAY_IO_TIMEOUT_SEC 2   // 下游握手/发送超时，超时即断开
+#define MAX_EXPORTS 4            // 同时进行的 /api/export 数量上限
+#define EXPORT_CHUNK_ROWS 256    // 导出时每个 HTTP 块包含的数据点数
+#define EXPORT_IO_TIMEOUT_SEC 10 // 导出接收方长时间不读取即中止
+#define SUMMARY_DEFAULT_WINDOW 10 // /api/summary 默认每 10 个数据点汇总一次
+#define ARCHIVE_BLOCK_ROWS 256   // 每个压缩块的数据点数
+#define ARCHIVE_DEFAULT_MB 8     // 压缩存储区默认大小，可用 --retention-mb 修改
+#define RW_QUEUE_SIZE 8192       // 远程写入内存队列长度，满时丢弃新数据点
+#define RW_DEFAULT_BATCH 500     // 远程写入每批数据点数，可用 --rw-batch 修改
+#define RW_DEFAULT_FLUSH_MS 1000 // 不足一批时的最长等待时间，可用 --rw-flush-ms 修改
+#define RW_DEFAULT_JOURNAL "remote-write.journal"
+#define SHM_DEFAULT_SLOTS 4096   // 共享内存环形缓冲区槽数（2 的幂），可用 --shm-slots 修改
+#define ANOMALY_WINDOW 64        // 滚动 z 分数的窗口（数据点数，2 的幂），也是检测前的预热长度
+#define ANOMALY_Z_LIMIT 4.0      // |z| 达到此值标记为离群点
+#define ANOMALY_EWMA_LAMBDA 0.2  // EWMA 平滑系数
+#define ANOMALY_EWMA_LIMIT 3.0   // EWMA 控制限（以 EWMA 自身的标准差计）
+#define ANOMALY_CUSUM_K 0.5      // CUSUM 允许的偏移（以标准差计）
+#define ANOMALY_CUSUM_H 5.0      // CUSUM 判定阈值，越过后标记并清零
 
 // 证书路径
 #define CLIENT_CERT "certs/client-cert.pem"
 #define CLIENT_KEY "certs/client-key.pem"
 #define CA_CERT "certs/ca-cert.pem"
+#define RELAY_CERT "certs/server-cert.pem"  // 中继监听使用的服务端证书
+#define RELAY_KEY "certs/server-key.pem"
+
+#define CACHE_LINE_SIZE 64
+
+// 传感器数据存储：结构数组（SoA）布局的环形缓冲区
+// 每列单独按缓存行对齐，每个数据点占 26 字节；时间戳以整数保存，
+// 仅在序列化时格式化为可读字符串
+typedef struct {
+    int64_t* timestamp_ms;     // 采样时间（Unix 毫秒）
+    double* centrifuge_speed;  // 离心机转速
+    double* power_output;      // 发电量
+    uint8_t* source;           // 数据来源（上游服务器）编号
+    uint8_t* anomaly;          // 写入时各检测器的标记，见 ANOMALY_FLAG
+    int head;                  // 最旧数据点所在下标
+    int count;
+    int capacity;
+    uint64_t appended;         // 累计写入的数据点数，即下一个数据点的全局序号
+} sensor_store_t;
+
+// 导出游标：按全局序号分批读取存储，每批单独加锁，导出期间不阻塞写入
+typedef struct {
+    uint64_t next;             // 下一个待读取数据点的全局序号
+    uint64_t end;              // 导出开始时的写入位置，之后写入的数据点不导出
+    int source;                // < 0 表示所有来源
+    int64_t from_ms;           // 时间范围（含两端，Unix 毫秒）
+    int64_t to_ms;
+    uint64_t skipped;          // 读取前已被覆盖而丢失的数据点
+} export_cursor_t;
+
+// 长期保留的压缩数据块（archive.c）：一个块的各列，封存块解码后或当前块本身
+typedef struct {
+    uint64_t first_seq;        // 第一行的全局序号
+    int rows;
+    int64_t* timestamp_ms;
+    double* centrifuge_speed;
+    double* power_output;
+    uint8_t* source;
+} archive_rows_t;
+
+typedef struct {
+    size_t capacity_bytes;     // 预留的压缩存储区大小
+    size_t used_bytes;         // 封存块实际占用
+    int blocks;
+    uint64_t samples;          // 可查询的数据点（含未压缩的当前块）
+    uint64_t sealed_samples;
+    int64_t oldest_ms;         // 最旧数据点的时间，0 表示尚无数据
+} archive_stats_t;
+
+// 在线异常检测（anomaly.c）：每个来源的每个通道独立检测，每个数据点 O(1)。
+// 标记按通道排列，每个通道占 ANOMALY_DETECTORS 位
+#define ANOMALY_Z 0x1            // 相对滚动窗口均值的 z 分数越限
+#define ANOMALY_EWMA 0x2         // EWMA 越出控制限（持续的小幅偏移）
+#define ANOMALY_CUSUM 0x4        // CUSUM 累积偏移越过阈值（缓慢漂移）
+#define ANOMALY_DETECTORS 3
+#define ANOMALY_FLAG(channel, detector) ((unsigned)(detector) << ((channel) * ANOMALY_DETECTORS))
+
+typedef struct {
+    int ready;                   // 窗口已满，以下得分有效
+    double mean;                 // 滚动窗口的均值和标准差
+    double stddev;
+    double z;                    // 最近一个数据点的得分
+    double ewma;                 // 以控制限的单位计，|ewma| >= ANOMALY_EWMA_LIMIT 越限
+    double cusum_high;
+    double cusum_low;
+    unsigned flags;              // 最近一个数据点的 ANOMALY_Z/EWMA/CUSUM
+    uint64_t events[ANOMALY_DETECTORS];  // 各检测器标记过的数据点数
+} anomaly_stats_t;
+
+// /api/data 的二进制列式格式（小端），浏览器可直接用 TypedArray 包装各列：
+//
+//   偏移 0   "NPPC" 魔数
+//        4   uint16 版本号，6 uint16 列数，8 uint32 行数 n，12 uint32 保留
+//        16  int64[n] 时间戳（Unix 毫秒）
+//            float64[n] 离心机转速，float64[n] 发电量（未订阅的通道为 NaN）
+//            uint8[n] 来源编号，补零到 8 字节的整数倍
+//
+// 每列起始偏移都是 8 的倍数
+#define COLUMNAR_MAGIC "NPPC"
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_COLUMNS 4
+#define COLUMNAR_HEADER_SIZE 16
+#define COLUMNAR_SIZE(rows) (COLUMNAR_HEADER_SIZE + (size_t)(rows) * 24 + (((size_t)(rows) + 7) & ~(size_t)7))
 
-// 传感器数据结构
+// TLS接收统计
 typedef struct {
-    double centrifuge_speed;  // 离心机转速
-    double power_output;      // 发电量
-    char timestamp[32];       // 时间戳
-} sensor_data_t;
+    uint64_t frames_received;
+    uint64_t frames_invalid;
+    unsigned last_hops;          // 最近一帧经过的中继数
+    unsigned max_hops;
+    uint64_t latency_frames;     // 带采集时间、计入延迟的数据帧
+    int64_t latency_last_us;     // 源服务器到本地的端到端延迟
+    int64_t latency_total_us;
+    int64_t latency_max_us;
+    uint64_t alarms_received;    // 报警帧单独统计，与数据帧延迟分开
+    unsigned alarms_active;      // 当前置位的报警数（各上游各通道）
+    int64_t alarm_latency_last_us;
+    int64_t alarm_latency_total_us;
+    int64_t alarm_latency_max_us;
+    uint64_t reconnects;         // 断开后重新连接成功的次数
+    uint64_t resumed;            // 以会话票据恢复、免去完整握手的重连次数
+    uint64_t seq_gaps;           // 序号不连续而缺失的数据帧（仅全量订阅时统计）
+    uint64_t backfilled;         // 重连后服务端按 RESUME 补发的数据点
+    uint64_t backfill_lost;      // 已不在服务端历史中、无法补发的数据点
+} tls_stats_t;
+
+// 中继转发统计
+typedef struct {
+    int port;                    // 0 表示未启用中继
+    int subscribers;
+    uint64_t frames_forwarded;
+    uint64_t frames_dropped;     // 队列溢出或超过最大跳数而丢弃的帧
+    int64_t hop_latency_total_us; // 本跳从接收到转发出去的耗时
+    int64_t hop_latency_max_us;
+} relay_stats_t;
+
+// 远程写入配置
+typedef struct {
+    const char* url;             // http://<ipv4>[:port]/path
+    int batch_size;
+    int flush_ms;
+    const char* journal_path;    // 下游不可达时暂存数据的日志文件
+} remote_write_config_t;
+
+// 远程写入统计
+typedef struct {
+    int enabled;
+    int reachable;               // 最近一次发送是否连上了下游
+    uint64_t sent;
+    uint64_t batches;
+    uint64_t failures;           // 失败的发送尝试次数
+    uint64_t rejected;           // 被下游以 4xx 拒绝而丢弃的数据点
+    uint64_t dropped;            // 队列或日志已满而丢弃的数据点
+    uint64_t invalid;            // 值为无穷大、无法编码为行协议而跳过的数据点
+    uint64_t queued;             // 内存队列中的数据点
+    uint64_t journaled;          // 日志中等待重放的数据点
+} remote_write_stats_t;
+
+// 共享内存发布统计
+typedef struct {
+    int enabled;
+    int slots;
+    uint64_t published;
+    int waiters;                 // 正在等待新数据的本机读者数
+} shm_stats_t;
 
 // 全局变量声明
 extern volatile int g_client_running;
-extern WOLFSSL* g_ssl;
-extern sensor_data_t* g_sensor_data;
-extern int g_data_count;
-extern int g_data_capacity;
+extern sensor_store_t g_sensor_store;
 extern pthread_mutex_t g_data_mutex;
 extern int g_actual_http_port;  // 实际使用的HTTP端口
 
 // TLS客户端函数
-int tls_client_init(const char* server_ip);
+int tls_client_init(const char* const* servers, int server_count, const char* subscription);
 void* tls_data_receiver(void* arg);
 void tls_client_cleanup(void);
+void tls_client_get_stats(tls_stats_t* stats);
+size_t tls_client_ingest(int source, char* data, size_t length);
+
+// 中继函数
+int relay_server_init(int port);
+void relay_forward_frame(const char* frame, size_t length);
+void relay_get_stats(relay_stats_t* stats);
+void relay_server_cleanup(void);
 
 // HTTP服务器函数
 int http_server_init(void);
+void http_server_cleanup(void);
+int http_responses_init(void);
+void http_responses_cleanup(void);
 void* http_server_thread(void* arg);
-void handle_http_request(int client_socket);
+int handle_http_request(int client_socket);  // 返回非零表示套接字已交给其他线程
+int get_query_param(const char* query, const char* key, char* value, size_t value_size);
+int http_send_all(int client_socket, const char* data, size_t length);
 void send_http_response(int client_socket, const char* status, const char* content_type, const char* body);
-void send_api_data(int client_socket);
+void send_http_binary(int client_socket, const char* status, const char* content_type,
+                      const char* body, size_t length);
+void send_api_data(int client_socket, const char* query, const char* accept);
+void send_api_stats(int client_socket);
+void send_api_summary(int client_socket, const char* query);
+
+// 流式导出（/api/export）
+int export_init(void);
+int send_api_export(int client_socket, const char* query);
+void export_cleanup(void);
 void send_static_file(int client_socket, const char* path);
 
 // 数据管理函数
-void add_sensor_data(double centrifuge_speed, double power_output);
-char* get_sensor_data_json(void);
-void init_data_storage(void);
+void add_sensor_data(int source, double centrifuge_speed, double power_output);
+void add_sensor_data_batch(int source, const int64_t* timestamp_ms, const double* centrifuge_speed,
+                           const double* power_output, int count);
+// 序列化到调用方提供的缓冲区，返回长度，缓冲区不足时返回 0
+// source < 0 表示所有来源按时间合并
+size_t sensor_response_max_size(void);
+size_t get_sensor_data_json(int source, char* out, size_t size);
+size_t get_sensor_data_columnar(int source, char* out, size_t size);
+size_t get_sensor_data_cbor(int source, char* out, size_t size);
+size_t get_sensor_summary_json(int source, int window, char* out, size_t size);
+size_t encode_columnar_rows(char* out, const int64_t* timestamp_ms, const double* centrifuge_speed,
+                            const double* power_output, const uint8_t* source, int rows);
+void export_cursor_init(export_cursor_t* cursor, int source, int64_t from_ms, int64_t to_ms);
+int export_read_rows(export_cursor_t* cursor, int64_t* timestamp_ms, double* centrifuge_speed,
+                     double* power_output, uint8_t* source, int max_rows);
+int register_data_source(const char* name);
+int find_data_source(const char* name_or_id);
+int get_data_source_name(int source, char* name, size_t size);
+void init_data_storage(int capacity);
 void cleanup_data_storage(void);
 
+// 压缩块存储函数 (archive.c)
+int archive_init(size_t bytes);
+void archive_append(int64_t timestamp_ms, double centrifuge_speed, double power_output, uint8_t source);
+uint64_t archive_oldest_seq(void);
+uint64_t archive_find_seq(int64_t from_ms);
+uint64_t archive_next_in_range(uint64_t seq, int64_t from_ms, int64_t to_ms);
+const archive_rows_t* archive_rows_at(uint64_t seq);
+void archive_get_stats(archive_stats_t* stats);
+void archive_cleanup(void);
+
+// 远程写入函数 (remote_write.c)
+int remote_write_init(const remote_write_config_t* config);
+void remote_write_enqueue(const int64_t* timestamp_ms, const double* centrifuge_speed, const double* power_output,
+                          int count, int source);
+void remote_write_get_stats(remote_write_stats_t* stats);
+void remote_write_cleanup(void);
+
+// 共享内存发布函数 (shm_publish.c)
+int shm_publish_init(const char* name, int slots);
+void shm_publish_source(int source, const char* name);
+void shm_publish_samples(const int64_t* timestamp_ms, const double* centrifuge_speed, const double* power_output,
+                         const uint8_t* anomaly, int count, int source);
+void shm_publish_get_stats(shm_stats_t* stats);
+void shm_publish_cleanup(void);
+
+// 异常检测函数 (anomaly.c)
+void anomaly_update(int source, int channel, const double* values, int count, uint8_t* flags);
+void anomaly_reset(void);
+size_t get_anomaly_json(char* out, size_t size);
+
 // 工具函数
 void signal_handler(int sig);
 void print_usage(const char* program_name);
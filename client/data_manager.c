@@ -1,127 +1,841 @@
 #include "client.h"
 
 // 全局数据存储
-sensor_data_t* g_sensor_data = NULL;
-int g_data_count = 0;
-int g_data_capacity = 0;
+sensor_store_t g_sensor_store = { NULL, NULL, NULL, NULL, NULL, 0, 0, 0, 0 };
 pthread_mutex_t g_data_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-void init_data_storage(void) {
+// 数据来源（上游服务器）名称表，下标即来源编号
+static char g_source_names[MAX_DATA_SOURCES][DATA_SOURCE_NAME_SIZE];
+static int g_source_count = 0;
+
+// Contiguous copy of the selected rows for /api/summary: the store's columns
+// wrap around the ring, the statistics kernels want one flat array each
+static unsigned char* g_summary_scratch = NULL;
+
+// The merged view in time order, as ring offsets from head, and the per-source
+// chains it is merged from (see merged_order)
+static int* g_merge_order = NULL;
+static int* g_merge_next = NULL;
+
+// 序列化时使用的时间格式缓存：同一秒内的数据点复用已格式化的字符串
+typedef struct {
+    int64_t second;
+    char text[16];
+} ts_format_cache_t;
+
+static int64_t current_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static const char* format_timestamp(ts_format_cache_t* cache, int64_t timestamp_ms) {
+    int64_t second = timestamp_ms / 1000;
+
+    if (second != cache->second) {
+        time_t t = (time_t)second;
+        struct tm tm_info;
+        localtime_r(&t, &tm_info);
+        strftime(cache->text, sizeof(cache->text), "%H:%M:%S", &tm_info);
+        cache->second = second;
+    }
+    return cache->text;
+}
+
+// CBOR major types and RFC 8746 typed array tags used by /api/data
+#define CBOR_MAJOR_UINT 0
+#define CBOR_MAJOR_BYTES 2
+#define CBOR_MAJOR_TEXT 3
+#define CBOR_MAJOR_ARRAY 4
+#define CBOR_MAJOR_MAP 5
+#define CBOR_MAJOR_TAG 6
+#define CBOR_TAG_UINT8 64
+#define CBOR_TAG_SINT64_LE 79
+#define CBOR_TAG_FLOAT64_LE 86
+
+// Format a channel value for JSON; channels the upstream did not send are stored as NaN
+static const char* format_json_value(char* buf, size_t size, double value) {
+    if (isnan(value)) {
+        return "null";
+    }
+    snprintf(buf, size, "%.1f", value);
+    return buf;
+}
+
+// Round a column size up to a whole number of cache lines
+static size_t column_bytes(int capacity, size_t elem_size) {
+    size_t bytes = (size_t)capacity * elem_size;
+    return (bytes + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+}
+
+void init_data_storage(int capacity) {
     pthread_mutex_lock(&g_data_mutex);
-    
-    g_data_capacity = MAX_DATA_POINTS;
-    g_sensor_data = malloc(g_data_capacity * sizeof(sensor_data_t));
-    g_data_count = 0;
-    
-    if (!g_sensor_data) {
+
+    size_t ts_bytes = column_bytes(capacity, sizeof(int64_t));
+    size_t value_bytes = column_bytes(capacity, sizeof(double));
+    size_t source_bytes = column_bytes(capacity, sizeof(uint8_t));
+    size_t total_bytes = ts_bytes + 2 * value_bytes + 2 * source_bytes;
+    void* block = NULL;
+
+    // All columns share one cache-line aligned block
+    if (capacity <= 0 || posix_memalign(&block, CACHE_LINE_SIZE, total_bytes) != 0) {
+        block = NULL;
+    }
+
+    g_sensor_store.head = 0;
+    g_sensor_store.count = 0;
+    g_sensor_store.appended = 0;
+    anomaly_reset();
+
+    if (!block) {
         fprintf(stderr, "Failed to allocate memory for sensor data\n");
-        g_data_capacity = 0;
+        g_sensor_store.capacity = 0;
     } else {
-        printf("Data storage initialized with capacity for %d data points\n", g_data_capacity);
+        g_sensor_store.timestamp_ms = (int64_t*)block;
+        g_sensor_store.centrifuge_speed = (double*)((char*)block + ts_bytes);
+        g_sensor_store.power_output = (double*)((char*)block + ts_bytes + value_bytes);
+        g_sensor_store.source = (uint8_t*)block + ts_bytes + 2 * value_bytes;
+        g_sensor_store.anomaly = g_sensor_store.source + source_bytes;
+        g_sensor_store.capacity = capacity;
+        printf("Data storage initialized with capacity for %d data points (%zu bytes)\n",
+               capacity, total_bytes);
+        memory_account("sensor store", total_bytes);
+
+        size_t scratch_bytes = (size_t)capacity * (sizeof(int64_t) + 2 * sizeof(double) + sizeof(uint8_t));
+        if (posix_memalign((void**)&g_summary_scratch, CACHE_LINE_SIZE, scratch_bytes) == 0) {
+            memory_account("summary scratch", scratch_bytes);
+        } else {
+            g_summary_scratch = NULL;
+        }
+
+        // Without it the merged view falls back to arrival order
+        size_t merge_bytes = (size_t)capacity * 2 * sizeof(int);
+        g_merge_order = malloc(merge_bytes);
+        if (g_merge_order) {
+            g_merge_next = g_merge_order + capacity;
+            memory_account("merge order", merge_bytes);
+        }
     }
-    
+
     pthread_mutex_unlock(&g_data_mutex);
 }
 
-void add_sensor_data(double centrifuge_speed, double power_output) {
+int register_data_source(const char* name) {
+    pthread_mutex_lock(&g_data_mutex);
+
+    // Reuse the id of a source that was registered before
+    for (int i = 0; i < g_source_count; i++) {
+        if (strcmp(g_source_names[i], name) == 0) {
+            pthread_mutex_unlock(&g_data_mutex);
+            return i;
+        }
+    }
+
+    int id = -1;
+    if (g_source_count < MAX_DATA_SOURCES) {
+        id = g_source_count++;
+        snprintf(g_source_names[id], DATA_SOURCE_NAME_SIZE, "%s", name);
+        shm_publish_source(id, name);
+    }
+
+    pthread_mutex_unlock(&g_data_mutex);
+    return id;
+}
+
+// Resolve a source given either its numeric id or its "host:port" name
+int find_data_source(const char* name_or_id) {
+    int id = -1;
+
+    pthread_mutex_lock(&g_data_mutex);
+    for (int i = 0; i < g_source_count; i++) {
+        if (strcmp(g_source_names[i], name_or_id) == 0) {
+            id = i;
+            break;
+        }
+    }
+    if (id < 0) {
+        char* end;
+        long value = strtol(name_or_id, &end, 10);
+        if (*name_or_id != '\0' && *end == '\0' && value >= 0 && value < g_source_count) {
+            id = (int)value;
+        }
+    }
+    pthread_mutex_unlock(&g_data_mutex);
+
+    return id;
+}
+
+int get_data_source_name(int source, char* name, size_t size) {
+    int result = -1;
+
+    pthread_mutex_lock(&g_data_mutex);
+    if (source >= 0 && source < g_source_count) {
+        snprintf(name, size, "%s", g_source_names[source]);
+        result = 0;
+    }
+    pthread_mutex_unlock(&g_data_mutex);
+
+    return result;
+}
+
+// Samples that arrived in one read take a single pass through the store lock,
+// the archive, shared memory and remote-write queue. Each keeps its own
+// timestamp, so a burst or a backfill is stored with its original spacing.
+void add_sensor_data_batch(int source, const int64_t* timestamp_ms, const double* centrifuge_speed,
+                           const double* power_output, int count) {
+    // Larger batches are stored in pieces of at most INGEST_BATCH samples
+    for (; count > INGEST_BATCH; count -= INGEST_BATCH) {
+        add_sensor_data_batch(source, timestamp_ms, centrifuge_speed, power_output, INGEST_BATCH);
+        timestamp_ms += INGEST_BATCH;
+        centrifuge_speed += INGEST_BATCH;
+        power_output += INGEST_BATCH;
+    }
+    if (count <= 0) {
+        return;
+    }
+
     pthread_mutex_lock(&g_data_mutex);
-    
-    if (!g_sensor_data || g_data_capacity == 0) {
+
+    sensor_store_t* store = &g_sensor_store;
+    if (!store->timestamp_ms || store->capacity == 0) {
         pthread_mutex_unlock(&g_data_mutex);
         return;
     }
-    
-    // If we've reached capacity, remove the oldest data point
-    if (g_data_count >= g_data_capacity) {
-        // Shift all data points left by one position
-        memmove(&g_sensor_data[0], &g_sensor_data[1], 
-                (g_data_capacity - 1) * sizeof(sensor_data_t));
-        g_data_count = g_data_capacity - 1;
-    }
-    
-    // Add new data point
-    sensor_data_t* new_data = &g_sensor_data[g_data_count];
-    new_data->centrifuge_speed = centrifuge_speed;
-    new_data->power_output = power_output;
-    
-    // Generate timestamp
-    time_t now = time(NULL);
-    struct tm* tm_info = localtime(&now);
-    // strftime(new_data->timestamp, sizeof(new_data->timestamp), 
-    //          "%Y-%m-%d %H:%M:%S", tm_info);
-    strftime(new_data->timestamp, sizeof(new_data->timestamp), 
-             "%H:%M:%S", tm_info);
-    
-    g_data_count++;
-    
-    printf("Added sensor data: Centrifuge=%.1f RPM, Power=%.1f MW, Time=%s\n",
-           centrifuge_speed, power_output, new_data->timestamp);
-    
+
+    // Online detectors see every sample once, in arrival order
+    uint8_t anomaly[INGEST_BATCH];
+    memset(anomaly, 0, (size_t)count);
+    anomaly_update(source, CHANNEL_CENTRIFUGE_SPEED, centrifuge_speed, count, anomaly);
+    anomaly_update(source, CHANNEL_POWER_OUTPUT, power_output, count, anomaly);
+
+    // Write into the next ring slots; when full, overwrite the oldest data points
+    int slot = store->head + store->count;
+    if (slot >= store->capacity) {
+        slot -= store->capacity;
+    }
+    for (int i = 0; i < count; i++) {
+        store->timestamp_ms[slot] = timestamp_ms[i];
+        store->centrifuge_speed[slot] = centrifuge_speed[i];
+        store->power_output[slot] = power_output[i];
+        store->source[slot] = (uint8_t)source;
+        store->anomaly[slot] = anomaly[i];
+        if (++slot == store->capacity) {
+            slot = 0;
+        }
+
+        // The archive keeps the same sample beyond the ring's retention
+        archive_append(timestamp_ms[i], centrifuge_speed[i], power_output[i], (uint8_t)source);
+    }
+
+    int total = store->count + count;
+    if (total <= store->capacity) {
+        store->count = total;
+    } else {
+        store->head = (store->head + total - store->capacity) % store->capacity;
+        store->count = store->capacity;
+    }
+    store->appended += (uint64_t)count;
+
+    // Local shared-memory readers; the store lock makes this the single writer
+    shm_publish_samples(timestamp_ms, centrifuge_speed, power_output, anomaly, count, source);
+
     pthread_mutex_unlock(&g_data_mutex);
+
+    // Forwarded outside the store lock; only queues the samples
+    remote_write_enqueue(timestamp_ms, centrifuge_speed, power_output, count, source);
+
+    LOG_RATELIMITED(LOG_LEVEL_DEBUG, 1000,
+                    "Added sensor data: Source=%d, %d point(s), Centrifuge=%.1f RPM, Power=%.1f MW\n",
+                    source, count, centrifuge_speed[count - 1], power_output[count - 1]);
 }
 
-char* get_sensor_data_json(void) {
+void add_sensor_data(int source, double centrifuge_speed, double power_output) {
+    int64_t timestamp_ms = current_time_ms();
+
+    add_sensor_data_batch(source, &timestamp_ms, &centrifuge_speed, &power_output, 1);
+}
+
+// Largest encoded JSON item: two "%.1f" doubles can each take ~310 characters
+#define JSON_ROW_MAX 768
+#define JSON_ROW_ESTIMATE 150
+
+// Upper bound for any /api/data response, so the HTTP server can reserve its
+// response buffers once at startup
+size_t sensor_response_max_size(void) {
+    int capacity = g_sensor_store.capacity;
+    size_t sources = MAX_DATA_SOURCES * (DATA_SOURCE_NAME_SIZE + 9);
+    size_t json = 1024 + JSON_ROW_MAX + (size_t)capacity * JSON_ROW_ESTIMATE + sources;
+    size_t cbor = 256 + (size_t)capacity * (sizeof(int64_t) + 2 * sizeof(double) + 1) + sources;
+    size_t columnar = COLUMNAR_SIZE(capacity);
+
+    size_t size = json > cbor ? json : cbor;
+    return size > columnar ? size : columnar;
+}
+
+// Ring slot of the sample `offset` places after the oldest one
+static int ring_slot(const sensor_store_t* store, int offset) {
+    int slot = store->head + offset;
+    return slot >= store->capacity ? slot - store->capacity : slot;
+}
+
+// Samples from every source share one ring in arrival order. Each source's
+// samples are in time order, but a backfill after a reconnect is stored at its
+// origin time behind newer samples of other sources, so the merged view is a
+// k-way merge of the per-source runs (at most MAX_DATA_SOURCES). Returns ring
+// offsets from head in time order, ties in arrival order, or NULL when arrival
+// order already is time order (the common case) and the ring can be scanned
+// directly. Called with g_data_mutex held.
+static const int* merged_order(const sensor_store_t* store) {
+    int heads[MAX_DATA_SOURCES];
+    int64_t last_ms = INT64_MIN;
+    int sorted = 1;
+
+    for (int i = 0; i < store->count && sorted; i++) {
+        int64_t timestamp_ms = store->timestamp_ms[ring_slot(store, i)];
+        sorted = timestamp_ms >= last_ms;
+        last_ms = timestamp_ms;
+    }
+    if (sorted || !g_merge_order) {
+        return NULL;
+    }
+
+    // Chain each source's samples oldest first
+    for (int s = 0; s < MAX_DATA_SOURCES; s++) {
+        heads[s] = -1;
+    }
+    for (int i = store->count - 1; i >= 0; i--) {
+        int s = store->source[ring_slot(store, i)];
+        if (s >= MAX_DATA_SOURCES) {
+            return NULL;
+        }
+        g_merge_next[i] = heads[s];
+        heads[s] = i;
+    }
+
+    for (int row = 0; row < store->count; row++) {
+        int best = -1;
+        int64_t best_ms = 0;
+        for (int s = 0; s < MAX_DATA_SOURCES; s++) {
+            if (heads[s] < 0) {
+                continue;
+            }
+            int64_t timestamp_ms = store->timestamp_ms[ring_slot(store, heads[s])];
+            if (best < 0 || timestamp_ms < best_ms || (timestamp_ms == best_ms && heads[s] < heads[best])) {
+                best = s;
+                best_ms = timestamp_ms;
+            }
+        }
+        g_merge_order[row] = heads[best];
+        heads[best] = g_merge_next[heads[best]];
+    }
+    return g_merge_order;
+}
+
+// The merged view is in time order (see merged_order); a per-source view skips
+// the other sources
+size_t get_sensor_data_json(int source, char* json_buffer, size_t buffer_size) {
     pthread_mutex_lock(&g_data_mutex);
-    
-    if (!g_sensor_data || g_data_count == 0) {
+
+    sensor_store_t* store = &g_sensor_store;
+    if (!store->timestamp_ms || store->count == 0) {
         pthread_mutex_unlock(&g_data_mutex);
-        char* empty_json = malloc(64);
-        if (empty_json) {
-            strcpy(empty_json, "{\"data\":[],\"count\":0,\"message\":\"No data available\"}");
-        }
-        return empty_json;
-    }
-    
-    // Calculate required buffer size
-    // Each data point needs approximately 120 characters in JSON format
-    size_t buffer_size = 1024 + (g_data_count * 150);
-    char* json_buffer = malloc(buffer_size);
-    
-    if (!json_buffer) {
+        int len = snprintf(json_buffer, buffer_size, "{\"data\":[],\"count\":0,\"message\":\"No data available\"}");
+        return (len > 0 && (size_t)len < buffer_size) ? (size_t)len : 0;
+    }
+
+    // Room kept for the metadata and source table after the last item
+    size_t trailer_size = 256 + g_source_count * (DATA_SOURCE_NAME_SIZE + 4);
+    if (buffer_size < trailer_size + JSON_ROW_MAX) {
         pthread_mutex_unlock(&g_data_mutex);
-        return NULL;
+        return 0;
     }
-    
+
     // Start building JSON
-    strcpy(json_buffer, "{\"data\":[");
-    
-    for (int i = 0; i < g_data_count; i++) {
-        char data_item[200];
-        snprintf(data_item, sizeof(data_item),
-            "%s{\"centrifugeSpeed\":%.1f,\"powerOutput\":%.1f,\"timestamp\":\"%s\"}",
-            (i > 0) ? "," : "",
-            g_sensor_data[i].centrifuge_speed,
-            g_sensor_data[i].power_output,
-            g_sensor_data[i].timestamp);
-        
-        strcat(json_buffer, data_item);
-    }
-    
-    // Add metadata
-    char metadata[200];
-    snprintf(metadata, sizeof(metadata),
-        "],\"count\":%d,\"capacity\":%d,\"message\":\"Data retrieved successfully\"}",
-        g_data_count, g_data_capacity);
-    
-    strcat(json_buffer, metadata);
-    
+    char* out = json_buffer;
+    char* end = json_buffer + buffer_size;
+    ts_format_cache_t ts_cache = { -1, "" };
+    int matched = 0;
+
+    out += snprintf(out, end - out, "{\"data\":[");
+
+    const int* order = source < 0 ? merged_order(store) : NULL;
+    for (int i = 0; i < store->count && (size_t)(end - out) >= trailer_size + JSON_ROW_MAX; i++) {
+        int slot = ring_slot(store, order ? order[i] : i);
+        if (source >= 0 && store->source[slot] != source) {
+            continue;
+        }
+        char speed[32], power[32];
+        out += snprintf(out, end - out,
+            "%s{\"centrifugeSpeed\":%s,\"powerOutput\":%s,\"timestamp\":\"%s\",\"ts\":%lld,\"source\":%d",
+            (matched > 0) ? "," : "",
+            format_json_value(speed, sizeof(speed), store->centrifuge_speed[slot]),
+            format_json_value(power, sizeof(power), store->power_output[slot]),
+            format_timestamp(&ts_cache, store->timestamp_ms[slot]),
+            (long long)store->timestamp_ms[slot],
+            store->source[slot]);
+        // Only flagged points carry the detector flags, which keeps the common row short
+        if (store->anomaly[slot]) {
+            out += snprintf(out, end - out, ",\"anomaly\":%u", store->anomaly[slot]);
+        }
+        *out++ = '}';
+        matched++;
+    }
+
+    // Add metadata and the source table
+    out += snprintf(out, end - out,
+        "],\"count\":%d,\"capacity\":%d,\"sources\":[",
+        matched, store->capacity);
+    for (int i = 0; i < g_source_count; i++) {
+        out += snprintf(out, end - out, "%s\"%s\"", (i > 0) ? "," : "", g_source_names[i]);
+    }
+    out += snprintf(out, end - out, "],\"message\":\"Data retrieved successfully\"}");
+
+    pthread_mutex_unlock(&g_data_mutex);
+    return (size_t)(out - json_buffer);
+}
+
+void export_cursor_init(export_cursor_t* cursor, int source, int64_t from_ms, int64_t to_ms) {
+    pthread_mutex_lock(&g_data_mutex);
+
+    // Exports read the archive, which reaches back much further than the ring;
+    // its block index skips whole blocks that end before from_ms
+    cursor->next = archive_find_seq(from_ms);
+    cursor->end = g_sensor_store.appended;
+    cursor->source = source;
+    cursor->from_ms = from_ms;
+    cursor->to_ms = to_ms;
+    cursor->skipped = 0;
+
+    pthread_mutex_unlock(&g_data_mutex);
+}
+
+// Copy up to max_rows matching samples into the given columns and advance the
+// cursor. Returns the number of rows copied; the export is finished once
+// cursor->next reaches cursor->end. The lock is held for one batch only, and a
+// batch scans a bounded number of samples even when few of them match.
+int export_read_rows(export_cursor_t* cursor, int64_t* timestamp_ms, double* centrifuge_speed,
+                     double* power_output, uint8_t* source, int max_rows) {
+    const archive_rows_t* block = NULL;
+    int rows = 0;
+
+    pthread_mutex_lock(&g_data_mutex);
+
+    // Blocks evicted since the previous batch are lost to this export
+    uint64_t oldest = archive_oldest_seq();
+    if (cursor->next < oldest) {
+        uint64_t lost = (oldest < cursor->end ? oldest : cursor->end) - cursor->next;
+        cursor->skipped += lost;
+        cursor->next += lost;
+    }
+
+    uint64_t scan_end = cursor->next + (uint64_t)max_rows * MAX_DATA_SOURCES;
+    if (scan_end > cursor->end) {
+        scan_end = cursor->end;
+    }
+    while (cursor->next < scan_end && rows < max_rows) {
+        if (!block || cursor->next >= block->first_seq + block->rows) {
+            // Backfilled samples make time order differ from storage order, so
+            // the scan runs to the end; blocks outside the range are skipped
+            // whole and do not count against the batch's scan budget
+            uint64_t next = archive_next_in_range(cursor->next, cursor->from_ms, cursor->to_ms);
+            if (next >= cursor->end) {
+                cursor->next = cursor->end;
+                break;
+            }
+            scan_end += next - cursor->next;
+            scan_end = scan_end < cursor->end ? scan_end : cursor->end;
+            cursor->next = next;
+            block = archive_rows_at(cursor->next);
+            if (!block) {
+                cursor->next = cursor->end;
+                break;
+            }
+        }
+        int i = (int)(cursor->next - block->first_seq);
+        int64_t ts = block->timestamp_ms[i];
+        cursor->next++;
+        if (ts < cursor->from_ms || ts > cursor->to_ms ||
+            (cursor->source >= 0 && block->source[i] != cursor->source)) {
+            continue;
+        }
+        timestamp_ms[rows] = ts;
+        centrifuge_speed[rows] = block->centrifuge_speed[i];
+        power_output[rows] = block->power_output[i];
+        source[rows] = block->source[i];
+        rows++;
+    }
+
+    pthread_mutex_unlock(&g_data_mutex);
+    return rows;
+}
+
+// Number of rows a (possibly per-source) view selects; called with g_data_mutex held
+static int count_rows(const sensor_store_t* store, int source) {
+    if (source < 0) {
+        return store->count;
+    }
+    int rows = 0;
+    for (int i = 0; i < store->count; i++) {
+        int slot = store->head + i;
+        if (slot >= store->capacity) {
+            slot -= store->capacity;
+        }
+        rows += (store->source[slot] == source);
+    }
+    return rows;
+}
+
+// Copy the selected rows, oldest first, into four output columns; called with
+// g_data_mutex held. A merged view already in time order is at most two
+// memcpy() per column (the ring wraps once); otherwise the rows are gathered
+// in merged order, and a per-source view gathers matching rows. Destinations
+// need not be aligned, so CBOR byte strings can be filled in place.
+static void copy_columns(const sensor_store_t* store, int source, unsigned char* ts,
+                         unsigned char* speed, unsigned char* power, unsigned char* src) {
+    const int* order = source < 0 ? merged_order(store) : NULL;
+
+    if (order) {
+        for (int row = 0; row < store->count; row++) {
+            int slot = ring_slot(store, order[row]);
+            memcpy(ts + row * sizeof(int64_t), &store->timestamp_ms[slot], sizeof(int64_t));
+            memcpy(speed + row * sizeof(double), &store->centrifuge_speed[slot], sizeof(double));
+            memcpy(power + row * sizeof(double), &store->power_output[slot], sizeof(double));
+            src[row] = store->source[slot];
+        }
+        return;
+    }
+
+    if (source < 0) {
+        int first = store->capacity - store->head;
+        if (first > store->count) {
+            first = store->count;
+        }
+        int second = store->count - first;
+
+        memcpy(ts, store->timestamp_ms + store->head, first * sizeof(int64_t));
+        memcpy(speed, store->centrifuge_speed + store->head, first * sizeof(double));
+        memcpy(power, store->power_output + store->head, first * sizeof(double));
+        memcpy(src, store->source + store->head, first);
+        memcpy(ts + first * sizeof(int64_t), store->timestamp_ms, second * sizeof(int64_t));
+        memcpy(speed + first * sizeof(double), store->centrifuge_speed, second * sizeof(double));
+        memcpy(power + first * sizeof(double), store->power_output, second * sizeof(double));
+        memcpy(src + first, store->source, second);
+        return;
+    }
+
+    int row = 0;
+    for (int i = 0; i < store->count; i++) {
+        int slot = store->head + i;
+        if (slot >= store->capacity) {
+            slot -= store->capacity;
+        }
+        if (store->source[slot] != source) {
+            continue;
+        }
+        memcpy(ts + row * sizeof(int64_t), &store->timestamp_ms[slot], sizeof(int64_t));
+        memcpy(speed + row * sizeof(double), &store->centrifuge_speed[slot], sizeof(double));
+        memcpy(power + row * sizeof(double), &store->power_output[slot], sizeof(double));
+        src[row] = store->source[slot];
+        row++;
+    }
+}
+
+// The wire formats are little-endian; on big-endian hosts swap 8-byte columns in place
+static void column_to_le64(unsigned char* column, int rows) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (int i = 0; i < rows; i++) {
+        unsigned char* v = column + i * 8;
+        for (int j = 0; j < 4; j++) {
+            unsigned char t = v[j];
+            v[j] = v[7 - j];
+            v[7 - j] = t;
+        }
+    }
+#else
+    (void)column;
+    (void)rows;
+#endif
+}
+
+static void put_le16(unsigned char* p, uint16_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put_le32(unsigned char* p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void write_columnar_header(unsigned char* buffer, int rows) {
+    memcpy(buffer, COLUMNAR_MAGIC, 4);
+    put_le16(buffer + 4, COLUMNAR_VERSION);
+    put_le16(buffer + 6, COLUMNAR_COLUMNS);
+    put_le32(buffer + 8, (uint32_t)rows);
+    put_le32(buffer + 12, 0);
+}
+
+// Encode rows already copied out of the store (e.g. one export batch) as a
+// complete columnar block; out must hold COLUMNAR_SIZE(rows) bytes
+size_t encode_columnar_rows(char* out, const int64_t* timestamp_ms, const double* centrifuge_speed,
+                            const double* power_output, const uint8_t* source, int rows) {
+    unsigned char* buffer = (unsigned char*)out;
+    unsigned char* ts = buffer + COLUMNAR_HEADER_SIZE;
+    unsigned char* speed = ts + rows * sizeof(int64_t);
+    unsigned char* power = speed + rows * sizeof(double);
+    unsigned char* src = power + rows * sizeof(double);
+    size_t size = COLUMNAR_SIZE(rows);
+
+    write_columnar_header(buffer, rows);
+    memcpy(ts, timestamp_ms, rows * sizeof(int64_t));
+    memcpy(speed, centrifuge_speed, rows * sizeof(double));
+    memcpy(power, power_output, rows * sizeof(double));
+    memcpy(src, source, rows);
+    memset(src + rows, 0, buffer + size - (src + rows));
+    column_to_le64(ts, rows);
+    column_to_le64(speed, rows);
+    column_to_le64(power, rows);
+    return size;
+}
+
+size_t get_sensor_data_columnar(int source, char* out, size_t out_size) {
+    pthread_mutex_lock(&g_data_mutex);
+
+    sensor_store_t* store = &g_sensor_store;
+    int rows = store->timestamp_ms ? count_rows(store, source) : 0;
+    size_t size = COLUMNAR_SIZE(rows);
+    unsigned char* buffer = (unsigned char*)out;
+
+    if (size > out_size) {
+        pthread_mutex_unlock(&g_data_mutex);
+        return 0;
+    }
+
+    write_columnar_header(buffer, rows);
+
+    unsigned char* ts = buffer + COLUMNAR_HEADER_SIZE;
+    unsigned char* speed = ts + rows * sizeof(int64_t);
+    unsigned char* power = speed + rows * sizeof(double);
+    unsigned char* src = power + rows * sizeof(double);
+    if (rows > 0) {
+        copy_columns(store, source, ts, speed, power, src);
+    }
+
+    pthread_mutex_unlock(&g_data_mutex);
+
+    memset(src + rows, 0, buffer + size - (src + rows));
+    column_to_le64(ts, rows);
+    column_to_le64(speed, rows);
+    column_to_le64(power, rows);
+
+    return size;
+}
+
+// Minimal CBOR (RFC 8949) encoding helpers: write an item head, return the new end
+static unsigned char* cbor_put_head(unsigned char* p, int major, uint64_t value) {
+    int bytes;
+
+    if (value < 24) {
+        *p++ = (unsigned char)(major << 5 | value);
+        return p;
+    } else if (value <= 0xff) {
+        *p++ = (unsigned char)(major << 5 | 24);
+        bytes = 1;
+    } else if (value <= 0xffff) {
+        *p++ = (unsigned char)(major << 5 | 25);
+        bytes = 2;
+    } else if (value <= 0xffffffffu) {
+        *p++ = (unsigned char)(major << 5 | 26);
+        bytes = 4;
+    } else {
+        *p++ = (unsigned char)(major << 5 | 27);
+        bytes = 8;
+    }
+    for (int i = bytes - 1; i >= 0; i--) {
+        *p++ = (unsigned char)(value >> (i * 8));
+    }
+    return p;
+}
+
+static unsigned char* cbor_put_text(unsigned char* p, const char* text) {
+    size_t len = strlen(text);
+    p = cbor_put_head(p, CBOR_MAJOR_TEXT, len);
+    memcpy(p, text, len);
+    return p + len;
+}
+
+// Typed array (RFC 8746): tag followed by a byte string; returns the payload start
+static unsigned char* cbor_put_typed_array(unsigned char** p, uint64_t tag, size_t bytes) {
+    *p = cbor_put_head(*p, CBOR_MAJOR_TAG, tag);
+    *p = cbor_put_head(*p, CBOR_MAJOR_BYTES, bytes);
+    unsigned char* payload = *p;
+    *p += bytes;
+    return payload;
+}
+
+size_t get_sensor_data_cbor(int source, char* out, size_t out_size) {
+    pthread_mutex_lock(&g_data_mutex);
+
+    sensor_store_t* store = &g_sensor_store;
+    int rows = store->timestamp_ms ? count_rows(store, source) : 0;
+    // Item heads are at most 9 bytes; a tag plus byte string head at most 18
+    size_t size = 256 + (size_t)rows * (sizeof(int64_t) + 2 * sizeof(double) + 1) +
+                  g_source_count * (DATA_SOURCE_NAME_SIZE + 9);
+    unsigned char* buffer = (unsigned char*)out;
+
+    if (size > out_size) {
+        pthread_mutex_unlock(&g_data_mutex);
+        return 0;
+    }
+
+    unsigned char* p = cbor_put_head(buffer, CBOR_MAJOR_MAP, 7);
+    p = cbor_put_text(p, "count");
+    p = cbor_put_head(p, CBOR_MAJOR_UINT, rows);
+    p = cbor_put_text(p, "capacity");
+    p = cbor_put_head(p, CBOR_MAJOR_UINT, store->capacity);
+
+    p = cbor_put_text(p, "ts");
+    unsigned char* ts = cbor_put_typed_array(&p, CBOR_TAG_SINT64_LE, rows * sizeof(int64_t));
+    p = cbor_put_text(p, "centrifugeSpeed");
+    unsigned char* speed = cbor_put_typed_array(&p, CBOR_TAG_FLOAT64_LE, rows * sizeof(double));
+    p = cbor_put_text(p, "powerOutput");
+    unsigned char* power = cbor_put_typed_array(&p, CBOR_TAG_FLOAT64_LE, rows * sizeof(double));
+    p = cbor_put_text(p, "source");
+    unsigned char* src = cbor_put_typed_array(&p, CBOR_TAG_UINT8, rows);
+    if (rows > 0) {
+        copy_columns(store, source, ts, speed, power, src);
+    }
+
+    p = cbor_put_text(p, "sources");
+    p = cbor_put_head(p, CBOR_MAJOR_ARRAY, g_source_count);
+    for (int i = 0; i < g_source_count; i++) {
+        p = cbor_put_text(p, g_source_names[i]);
+    }
+
     pthread_mutex_unlock(&g_data_mutex);
-    return json_buffer;
+
+    column_to_le64(ts, rows);
+    column_to_le64(speed, rows);
+    column_to_le64(power, rows);
+
+    return (size_t)(p - buffer);
+}
+
+// Format a statistic for JSON; empty selections have no min/max/mean
+static const char* format_json_stat(char* buf, size_t size, double value, int decimals) {
+    if (isnan(value) || isinf(value)) {
+        return "null";
+    }
+    snprintf(buf, size, "%.*f", decimals, value);
+    return buf;
+}
+
+static char* append_channel_stats(char* out, char* end, const char* name, const kernel_stats_t* stats) {
+    char min[32], max[32], mean[32], variance[32];
+
+    out += snprintf(out, end - out,
+        "\"%s\":{\"count\":%llu,\"min\":%s,\"max\":%s,\"mean\":%s,\"variance\":%s}",
+        name, (unsigned long long)stats->count,
+        format_json_stat(min, sizeof(min), stats->min, 1),
+        format_json_stat(max, sizeof(max), stats->max, 1),
+        format_json_stat(mean, sizeof(mean), kernel_stats_mean(stats), 1),
+        format_json_stat(variance, sizeof(variance), kernel_stats_variance(stats), 2));
+    return out;
+}
+
+// Windows summarised per kernel_rollup() call
+#define SUMMARY_ROLLUP_BATCH 32
+
+// Statistics over the selected rows and, when window > 0, one rollup entry
+// [ts, speedMin, speedMean, speedMax, powerMin, powerMean, powerMax] per
+// `window` consecutive rows. Both channels are reduced with the vectorised
+// kernels over contiguous copies of the store columns.
+size_t get_sensor_summary_json(int source, int window, char* json_buffer, size_t buffer_size) {
+    pthread_mutex_lock(&g_data_mutex);
+
+    sensor_store_t* store = &g_sensor_store;
+    int rows = (store->timestamp_ms && g_summary_scratch) ? count_rows(store, source) : 0;
+    unsigned char* ts_bytes = g_summary_scratch;
+    unsigned char* speed_bytes = ts_bytes + rows * sizeof(int64_t);
+    unsigned char* power_bytes = speed_bytes + rows * sizeof(double);
+    if (rows > 0) {
+        copy_columns(store, source, ts_bytes, speed_bytes, power_bytes,
+                     power_bytes + rows * sizeof(double));
+    }
+    const int64_t* ts = (const int64_t*)ts_bytes;
+    const double* speed = (const double*)speed_bytes;
+    const double* power = (const double*)power_bytes;
+
+    char* out = json_buffer;
+    char* end = json_buffer + buffer_size;
+    kernel_stats_t speed_stats, power_stats;
+
+    if (buffer_size < 1024 + JSON_ROW_MAX) {
+        pthread_mutex_unlock(&g_data_mutex);
+        return 0;
+    }
+
+    kernel_stats_init(&speed_stats);
+    kernel_stats_init(&power_stats);
+    kernel_stats_accumulate(&speed_stats, speed, rows);
+    kernel_stats_accumulate(&power_stats, power, rows);
+
+    out += snprintf(out, end - out, "{\"count\":%d,\"window\":%d,\"backend\":\"%s\",",
+                    rows, window, kernel_backend_name(kernel_get_backend()));
+    out = append_channel_stats(out, end, "centrifugeSpeed", &speed_stats);
+    out += snprintf(out, end - out, ",");
+    out = append_channel_stats(out, end, "powerOutput", &power_stats);
+    out += snprintf(out, end - out, ",\"rollup\":[");
+
+    int emitted = 0;
+    for (int start = 0; window > 0 && start < rows; start += SUMMARY_ROLLUP_BATCH * window) {
+        kernel_stats_t speed_windows[SUMMARY_ROLLUP_BATCH];
+        kernel_stats_t power_windows[SUMMARY_ROLLUP_BATCH];
+        size_t span = (size_t)(rows - start);
+        if (span > (size_t)SUMMARY_ROLLUP_BATCH * window) {
+            span = (size_t)SUMMARY_ROLLUP_BATCH * window;
+        }
+        size_t windows = kernel_rollup(speed + start, span, window, speed_windows);
+        kernel_rollup(power + start, span, window, power_windows);
+
+        for (size_t w = 0; w < windows && (size_t)(end - out) > 256 + JSON_ROW_MAX; w++) {
+            char v[6][32];
+            out += snprintf(out, end - out, "%s[%lld,%s,%s,%s,%s,%s,%s]",
+                (emitted > 0) ? "," : "",
+                (long long)ts[start + w * window],
+                format_json_stat(v[0], sizeof(v[0]), speed_windows[w].min, 1),
+                format_json_stat(v[1], sizeof(v[1]), kernel_stats_mean(&speed_windows[w]), 1),
+                format_json_stat(v[2], sizeof(v[2]), speed_windows[w].max, 1),
+                format_json_stat(v[3], sizeof(v[3]), power_windows[w].min, 1),
+                format_json_stat(v[4], sizeof(v[4]), kernel_stats_mean(&power_windows[w]), 1),
+                format_json_stat(v[5], sizeof(v[5]), power_windows[w].max, 1));
+            emitted++;
+        }
+    }
+    out += snprintf(out, end - out, "]}");
+
+    pthread_mutex_unlock(&g_data_mutex);
+    return (size_t)(out - json_buffer);
 }
 
 void cleanup_data_storage(void) {
     pthread_mutex_lock(&g_data_mutex);
-    
-    if (g_sensor_data) {
-        free(g_sensor_data);
-        g_sensor_data = NULL;
-    }
-    
-    g_data_count = 0;
-    g_data_capacity = 0;
-    
+
+    // The columns share the block starting at timestamp_ms
+    if (g_sensor_store.timestamp_ms) {
+        free(g_sensor_store.timestamp_ms);
+    }
+    memset(&g_sensor_store, 0, sizeof(g_sensor_store));
+    free(g_summary_scratch);
+    g_summary_scratch = NULL;
+    free(g_merge_order);
+    g_merge_order = NULL;
+    g_merge_next = NULL;
+
     printf("Data storage cleaned up\n");
-    
+
     pthread_mutex_unlock(&g_data_mutex);
     pthread_mutex_destroy(&g_data_mutex);
-}
\ No newline at end of file
+}
@@ -0,0 +1,273 @@
+#include "client.h"
+#include <sys/uio.h>
+
+// 流式导出：/api/export?from=<ms>&to=<ms>&source=<id>&format=csv|json|bin
+//
+// 每次从存储读取 EXPORT_CHUNK_ROWS 个数据点，编码后作为一个 chunked 块发送；
+// 上一块交给内核后才读取下一批，接收方读得慢时导出随之变慢，内存占用固定。
+// 每个导出在独立线程中运行，每批只短暂持有数据锁，不影响其他 HTTP 请求和数据写入。
+
+// Largest text row: two "%.1f" doubles plus the fixed JSON keys
+#define EXPORT_ROW_MAX 1024
+#define EXPORT_BUFFER_SIZE (64 * 1024)
+
+typedef enum {
+    EXPORT_FORMAT_CSV,
+    EXPORT_FORMAT_JSON,
+    EXPORT_FORMAT_BIN
+} export_format_t;
+
+// One running export; the batch columns and output buffer live in the job so
+// that jobs come whole from a pool reserved at startup
+typedef struct {
+    int sockfd;
+    export_format_t format;
+    export_cursor_t cursor;
+    int64_t ts[EXPORT_CHUNK_ROWS];
+    double speed[EXPORT_CHUNK_ROWS];
+    double power[EXPORT_CHUNK_ROWS];
+    uint8_t source[EXPORT_CHUNK_ROWS];
+    char buffer[EXPORT_BUFFER_SIZE];
+} export_job_t;
+
+static const char* g_export_content_types[] = { "text/csv", "application/json", "application/octet-stream" };
+static const char* g_export_extensions[] = { "csv", "json", "bin" };
+
+static mempool_t g_export_pool;
+
+// Send one chunk of a chunked response; an empty chunk ends the body
+static int send_chunk(int sockfd, const char* data, size_t length) {
+    char size_line[24];
+    struct iovec iov[3];
+    struct msghdr msg;
+    int size_len = snprintf(size_line, sizeof(size_line), "%zx\r\n", length);
+
+    iov[0].iov_base = size_line;
+    iov[0].iov_len = size_len;
+    iov[1].iov_base = (void*)data;
+    iov[1].iov_len = length;
+    iov[2].iov_base = (void*)"\r\n";
+    iov[2].iov_len = 2;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 3;
+
+    // Blocks while the receiver's window is full (bounded by SO_SNDTIMEO)
+    while (msg.msg_iovlen > 0) {
+        ssize_t sent = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return -1;
+        }
+        while (msg.msg_iovlen > 0 && (size_t)sent >= msg.msg_iov->iov_len) {
+            sent -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = (char*)msg.msg_iov->iov_base + sent;
+            msg.msg_iov->iov_len -= sent;
+        }
+    }
+    return 0;
+}
+
+// Append a channel value; unsubscribed channels (NaN) become empty CSV fields or JSON null
+static int format_value(char* out, size_t size, double value, export_format_t format) {
+    if (isnan(value)) {
+        return snprintf(out, size, "%s", format == EXPORT_FORMAT_JSON ? "null" : "");
+    }
+    return snprintf(out, size, "%.1f", value);
+}
+
+// Format as many rows as fit in the buffer; returns the number of rows formatted
+static int format_text_rows(char* out, size_t size, size_t* length, export_format_t format,
+                            uint64_t exported, const int64_t* ts, const double* speed,
+                            const double* power, const uint8_t* source, int rows) {
+    size_t len = 0;
+    int i;
+
+    for (i = 0; i < rows && size - len > EXPORT_ROW_MAX; i++) {
+        if (format == EXPORT_FORMAT_CSV) {
+            len += snprintf(out + len, size - len, "%lld,", (long long)ts[i]);
+            len += format_value(out + len, size - len, speed[i], format);
+            len += snprintf(out + len, size - len, ",");
+            len += format_value(out + len, size - len, power[i], format);
+            len += snprintf(out + len, size - len, ",%d\n", source[i]);
+        } else {
+            len += snprintf(out + len, size - len, "%s{\"centrifugeSpeed\":",
+                            (exported + i > 0) ? "," : "");
+            len += format_value(out + len, size - len, speed[i], format);
+            len += snprintf(out + len, size - len, ",\"powerOutput\":");
+            len += format_value(out + len, size - len, power[i], format);
+            len += snprintf(out + len, size - len, ",\"ts\":%lld,\"source\":%d}",
+                            (long long)ts[i], source[i]);
+        }
+    }
+    *length = len;
+    return i;
+}
+
+static void* export_thread(void* arg) {
+    export_job_t* job = (export_job_t*)arg;
+    int64_t* ts = job->ts;
+    double* speed = job->speed;
+    double* power = job->power;
+    uint8_t* source = job->source;
+    char* buffer = job->buffer;
+    uint64_t exported = 0;
+    int failed = 0;
+    char header[BUFFER_SIZE];
+    int header_len = snprintf(header, sizeof(header),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Disposition: attachment; filename=\"export.%s\"\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Connection: close\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "\r\n",
+        g_export_content_types[job->format], g_export_extensions[job->format]);
+
+    failed = http_send_all(job->sockfd, header, header_len) != 0;
+    if (!failed && job->format != EXPORT_FORMAT_BIN) {
+        const char* prologue = (job->format == EXPORT_FORMAT_CSV)
+            ? "ts,centrifugeSpeed,powerOutput,source\n" : "{\"data\":[";
+        failed = send_chunk(job->sockfd, prologue, strlen(prologue)) != 0;
+    }
+
+    while (!failed && g_client_running && job->cursor.next < job->cursor.end) {
+        int rows = export_read_rows(&job->cursor, ts, speed, power, source, EXPORT_CHUNK_ROWS);
+        if (rows == 0) {
+            continue;
+        }
+
+        // Binary exports are a sequence of self-describing columnar blocks
+        if (job->format == EXPORT_FORMAT_BIN) {
+            size_t len = encode_columnar_rows(buffer, ts, speed, power, source, rows);
+            failed = send_chunk(job->sockfd, buffer, len) != 0;
+            exported += rows;
+            continue;
+        }
+        for (int done = 0; done < rows && !failed;) {
+            size_t len;
+            int formatted = format_text_rows(buffer, EXPORT_BUFFER_SIZE, &len, job->format, exported,
+                                             ts + done, speed + done, power + done, source + done,
+                                             rows - done);
+            failed = send_chunk(job->sockfd, buffer, len) != 0;
+            done += formatted;
+            exported += formatted;
+        }
+    }
+
+    if (!failed && job->format == EXPORT_FORMAT_JSON) {
+        int len = snprintf(buffer, EXPORT_BUFFER_SIZE, "],\"count\":%llu,\"skipped\":%llu}",
+                           (unsigned long long)exported, (unsigned long long)job->cursor.skipped);
+        failed = send_chunk(job->sockfd, buffer, len) != 0;
+    }
+    if (!failed) {
+        failed = send_chunk(job->sockfd, "", 0) != 0;
+    }
+
+    if (failed) {
+        LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "Export aborted after %llu rows\n",
+                        (unsigned long long)exported);
+    } else {
+        LOG_INFO("Export finished: %llu rows, %llu overwritten before they were sent\n",
+                 (unsigned long long)exported, (unsigned long long)job->cursor.skipped);
+    }
+
+    close(job->sockfd);
+    mempool_free(&g_export_pool, job);
+    pthread_exit(NULL);
+}
+
+// Parse an optional integer millisecond bound; returns -1 if present but malformed
+static int parse_time_param(const char* query, const char* key, int64_t* value) {
+    char text[32];
+    char* end;
+
+    if (get_query_param(query, key, text, sizeof(text)) != 0) {
+        return 0;
+    }
+    errno = 0;
+    long long parsed = strtoll(text, &end, 10);
+    if (text[0] == '\0' || *end != '\0' || errno != 0) {
+        return -1;
+    }
+    *value = parsed;
+    return 0;
+}
+
+// Returns 1 once the socket has been handed to an export thread, 0 if the
+// caller still owns it (an error response was sent)
+int send_api_export(int client_socket, const char* query) {
+    char param[DATA_SOURCE_NAME_SIZE];
+    int64_t from_ms = INT64_MIN;
+    int64_t to_ms = INT64_MAX;
+    int source = -1;
+    export_format_t format = EXPORT_FORMAT_CSV;
+
+    if (parse_time_param(query, "from", &from_ms) != 0 || parse_time_param(query, "to", &to_ms) != 0 ||
+        from_ms > to_ms) {
+        send_http_response(client_socket, "400 Bad Request", "text/plain", "Invalid time range");
+        return 0;
+    }
+    if (get_query_param(query, "format", param, sizeof(param)) == 0) {
+        if (strcmp(param, "json") == 0) {
+            format = EXPORT_FORMAT_JSON;
+        } else if (strcmp(param, "bin") == 0) {
+            format = EXPORT_FORMAT_BIN;
+        } else if (strcmp(param, "csv") != 0) {
+            send_http_response(client_socket, "400 Bad Request", "text/plain", "Unknown format");
+            return 0;
+        }
+    }
+    if (get_query_param(query, "source", param, sizeof(param)) == 0) {
+        source = find_data_source(param);
+        if (source < 0) {
+            send_http_response(client_socket, "404 Not Found", "text/plain", "Unknown data source");
+            return 0;
+        }
+    }
+
+    // The pool holds MAX_EXPORTS jobs, so it also caps concurrent exports
+    export_job_t* job = mempool_alloc(&g_export_pool);
+    pthread_t thread_id;
+    if (!job) {
+        send_http_response(client_socket, "503 Service Unavailable", "text/plain", "Too many exports");
+        return 0;
+    }
+    job->sockfd = client_socket;
+    job->format = format;
+    export_cursor_init(&job->cursor, source, from_ms, to_ms);
+
+    // A receiver that stops reading aborts the export instead of pinning its thread
+    struct timeval io_timeout = { EXPORT_IO_TIMEOUT_SEC, 0 };
+    setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, &io_timeout, sizeof(io_timeout));
+
+    if (pthread_create(&thread_id, NULL, export_thread, job) != 0) {
+        fprintf(stderr, "Export: thread creation failed\n");
+        mempool_free(&g_export_pool, job);
+        send_http_response(client_socket, "500 Internal Server Error", "text/plain", "Export failed");
+        return 0;
+    }
+    pthread_detach(thread_id);
+    return 1;
+}
+
+int export_init(void) {
+    return mempool_init(&g_export_pool, "export jobs", sizeof(export_job_t), MAX_EXPORTS);
+}
+
+// Wait for running exports; they stop at their next batch once g_client_running is cleared
+void export_cleanup(void) {
+    if (!g_export_pool.base) {
+        return;
+    }
+    while (mempool_in_use(&g_export_pool) > 0) {
+        usleep(10000);
+    }
+    mempool_destroy(&g_export_pool);
+}
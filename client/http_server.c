@@ -2,6 +2,85 @@
 
 static int g_http_sockfd = -1;
 static pthread_t g_http_thread;
+static int g_http_thread_started = 0;
+
+// /api/data responses are encoded into buffers reserved at startup, sized for
+// a full store (see sensor_response_max_size)
+static mempool_t g_response_pool;
+
+// Copy the value of "key" from a "a=1&b=2" query string; returns 0 if found
+int get_query_param(const char* query, const char* key, char* value, size_t value_size) {
+    size_t key_len = strlen(key);
+
+    while (query && *query) {
+        const char* next = strchr(query, '&');
+        size_t pair_len = next ? (size_t)(next - query) : strlen(query);
+
+        if (pair_len > key_len && strncmp(query, key, key_len) == 0 && query[key_len] == '=') {
+            size_t len = pair_len - key_len - 1;
+            if (len >= value_size) {
+                len = value_size - 1;
+            }
+            memcpy(value, query + key_len + 1, len);
+            value[len] = '\0';
+            return 0;
+        }
+        query = next ? next + 1 : NULL;
+    }
+    return -1;
+}
+
+// Copy the value of request header "name" (without the trailing CRLF); returns 0 if found
+static int get_header_value(const char* request, const char* name, char* value, size_t value_size) {
+    size_t name_len = strlen(name);
+    const char* line = strstr(request, "\r\n");
+
+    while (line && line[2] != '\r' && line[2] != '\0') {
+        line += 2;
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char* start = line + name_len + 1;
+            while (*start == ' ' || *start == '\t') {
+                start++;
+            }
+            size_t len = strcspn(start, "\r\n");
+            if (len >= value_size) {
+                len = value_size - 1;
+            }
+            memcpy(value, start, len);
+            value[len] = '\0';
+            return 0;
+        }
+        line = strstr(line, "\r\n");
+    }
+    return -1;
+}
+
+// Send the whole buffer, waiting for the socket to drain; returns -1 on error or timeout
+int http_send_all(int client_socket, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(client_socket, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return -1;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+// Reserve the response buffers for the current store capacity; separate from
+// the listener so requests can also be handled in-process (bench/client_bench.c)
+int http_responses_init(void) {
+    return mempool_init(&g_response_pool, "http responses", sensor_response_max_size(),
+                        HTTP_RESPONSE_BUFFERS);
+}
+
+void http_responses_cleanup(void) {
+    mempool_destroy(&g_response_pool);
+}
 
 int http_server_init(void) {
     struct sockaddr_in server_addr;
@@ -9,17 +88,22 @@ int http_server_init(void) {
     int port = HTTP_PORT;
     int max_attempts = 100; // 最多尝试100个端口
 
+    if (http_responses_init() != 0) {
+        return -1;
+    }
+
     // Create socket
     g_http_sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (g_http_sockfd < 0) {
         perror("HTTP socket creation failed");
+        http_server_cleanup();
         return -1;
     }
 
     // Set socket options
     if (setsockopt(g_http_sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
         perror("HTTP setsockopt failed");
-        close(g_http_sockfd);
+        http_server_cleanup();
         return -1;
     }
 
@@ -40,7 +124,7 @@ int http_server_init(void) {
         
         if (attempt == max_attempts - 1) {
             fprintf(stderr, "HTTP bind failed: Unable to find available port after %d attempts\n", max_attempts);
-            close(g_http_sockfd);
+            http_server_cleanup();
             return -1;
         }
         
@@ -51,7 +135,7 @@ int http_server_init(void) {
     // Listen for connections
     if (listen(g_http_sockfd, 10) < 0) {
         perror("HTTP listen failed");
-        close(g_http_sockfd);
+        http_server_cleanup();
         return -1;
     }
 
@@ -60,20 +144,42 @@ int http_server_init(void) {
     // Start HTTP server thread
     if (pthread_create(&g_http_thread, NULL, http_server_thread, NULL) != 0) {
         fprintf(stderr, "Failed to create HTTP server thread\n");
-        close(g_http_sockfd);
+        http_server_cleanup();
         return -1;
     }
+    g_http_thread_started = 1;
 
     printf("HTTP server initialized successfully.\n");
     return 0;
 }
 
+// Stop accepting, wait for the request in progress and release the response
+// buffers. The thread leaves its loop once g_client_running is cleared;
+// shutting the listening socket down wakes it from accept().
+void http_server_cleanup(void) {
+    if (g_http_sockfd >= 0) {
+        shutdown(g_http_sockfd, SHUT_RDWR);
+    }
+    if (g_http_thread_started) {
+        pthread_join(g_http_thread, NULL);
+        g_http_thread_started = 0;
+    }
+    if (g_http_sockfd >= 0) {
+        close(g_http_sockfd);
+        g_http_sockfd = -1;
+    }
+    http_responses_cleanup();
+}
+
 void* http_server_thread(void* arg) {
     (void)arg;
     struct sockaddr_in client_addr;
     socklen_t client_len = sizeof(client_addr);
     int client_socket;
 
+    // Export threads are started from here and inherit this placement
+    rt_thread_setup("http", 0);
+
     while (g_client_running) {
         client_socket = accept(g_http_sockfd, (struct sockaddr*)&client_addr, &client_len);
         if (client_socket < 0) {
@@ -83,17 +189,19 @@ void* http_server_thread(void* arg) {
             continue;
         }
 
-        printf("HTTP client connected from %s:%d\n", 
-               inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+        LOG_RATELIMITED(LOG_LEVEL_DEBUG, 1000, "HTTP client connected from %s:%d\n",
+                        inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
 
-        handle_http_request(client_socket);
-        close(client_socket);
+        // Long-running responses (exports) take over the socket
+        if (!handle_http_request(client_socket)) {
+            close(client_socket);
+        }
     }
 
     pthread_exit(NULL);
 }
 
-void handle_http_request(int client_socket) {
+int handle_http_request(int client_socket) {
     char buffer[BUFFER_SIZE];
     char method[16], path[256], version[16];
     int bytes_read;
@@ -101,22 +209,37 @@ void handle_http_request(int client_socket) {
     // Read HTTP request
     bytes_read = recv(client_socket, buffer, BUFFER_SIZE - 1, 0);
     if (bytes_read <= 0) {
-        return;
+        return 0;
     }
     buffer[bytes_read] = '\0';
 
     // Parse request line
     if (sscanf(buffer, "%15s %255s %15s", method, path, version) != 3) {
         send_http_response(client_socket, "400 Bad Request", "text/plain", "Bad Request");
-        return;
+        return 0;
     }
 
-    printf("HTTP Request: %s %s %s\n", method, path, version);
+    LOG_RATELIMITED(LOG_LEVEL_DEBUG, 1000, "HTTP Request: %s %s %s\n", method, path, version);
+
+    char accept[256] = "";
+    get_header_value(buffer, "Accept", accept, sizeof(accept));
+
+    // Split off the query string
+    char* query = strchr(path, '?');
+    if (query) {
+        *query++ = '\0';
+    }
 
     // Handle different routes
     if (strcmp(method, "GET") == 0) {
         if (strcmp(path, "/api/data") == 0) {
-            send_api_data(client_socket);
+            send_api_data(client_socket, query, accept);
+        } else if (strcmp(path, "/api/export") == 0) {
+            return send_api_export(client_socket, query);
+        } else if (strcmp(path, "/api/summary") == 0) {
+            send_api_summary(client_socket, query);
+        } else if (strcmp(path, "/api/stats") == 0) {
+            send_api_stats(client_socket);
         } else if (strcmp(path, "/") == 0 || strcmp(path, "/index.html") == 0) {
             send_static_file(client_socket, "public/index.html");
         } else {
@@ -128,33 +251,205 @@ void handle_http_request(int client_socket) {
     } else {
         send_http_response(client_socket, "405 Method Not Allowed", "text/plain", "Method Not Allowed");
     }
+    return 0;
 }
 
-void send_http_response(int client_socket, const char* status, const char* content_type, const char* body) {
-    char response[BUFFER_SIZE * 4];
-    int content_length = strlen(body);
-
-    snprintf(response, sizeof(response),
+// The body is sent straight from the caller's buffer, so its size is not limited
+static void send_http_body(int client_socket, const char* status, const char* content_type,
+                           const char* extra_headers, const char* body, size_t length) {
+    char header[BUFFER_SIZE];
+    int header_len = snprintf(header, sizeof(header),
         "HTTP/1.1 %s\r\n"
         "Content-Type: %s\r\n"
-        "Content-Length: %d\r\n"
+        "Content-Length: %zu\r\n"
+        "%s"
         "Connection: close\r\n"
         "Access-Control-Allow-Origin: *\r\n"
-        "\r\n"
-        "%s",
-        status, content_type, content_length, body);
+        "\r\n",
+        status, content_type, length, extra_headers);
 
-    send(client_socket, response, strlen(response), 0);
+    if (http_send_all(client_socket, header, header_len) == 0) {
+        http_send_all(client_socket, body, length);
+    }
+}
+
+void send_http_response(int client_socket, const char* status, const char* content_type, const char* body) {
+    send_http_body(client_socket, status, content_type, "", body, strlen(body));
+}
+
+// Response whose encoding was negotiated from the Accept header
+void send_http_binary(int client_socket, const char* status, const char* content_type,
+                      const char* body, size_t length) {
+    send_http_body(client_socket, status, content_type, "Vary: Accept\r\n", body, length);
+}
+
+void send_api_data(int client_socket, const char* query, const char* accept) {
+    char source_param[DATA_SOURCE_NAME_SIZE];
+    char format[16] = "";
+    int source = -1;
+
+    // ?source=<id|host:port> selects one upstream; otherwise all are merged by time
+    if (get_query_param(query, "source", source_param, sizeof(source_param)) == 0) {
+        source = find_data_source(source_param);
+        if (source < 0) {
+            send_http_response(client_socket, "404 Not Found", "text/plain", "Unknown data source");
+            return;
+        }
+    }
+
+    // Binary formats are chosen with ?format=bin|cbor or the Accept header;
+    // JSON stays the default. Both binary encodings copy the store's columns
+    // as raw little-endian arrays, with no per-value formatting.
+    if (get_query_param(query, "format", format, sizeof(format)) != 0) {
+        if (strstr(accept, "application/octet-stream")) {
+            strcpy(format, "bin");
+        } else if (strstr(accept, "application/cbor")) {
+            strcpy(format, "cbor");
+        }
+    }
+    if (format[0] != '\0' && strcmp(format, "json") != 0 && strcmp(format, "bin") != 0 &&
+        strcmp(format, "cbor") != 0) {
+        send_http_response(client_socket, "400 Bad Request", "text/plain", "Unknown format");
+        return;
+    }
+
+    char* body = mempool_alloc(&g_response_pool);
+    if (!body) {
+        send_http_response(client_socket, "503 Service Unavailable", "text/plain", "Server busy");
+        return;
+    }
+
+    size_t length;
+    const char* content_type;
+    if (strcmp(format, "bin") == 0) {
+        length = get_sensor_data_columnar(source, body, g_response_pool.block_size);
+        content_type = "application/octet-stream";
+    } else if (strcmp(format, "cbor") == 0) {
+        length = get_sensor_data_cbor(source, body, g_response_pool.block_size);
+        content_type = "application/cbor";
+    } else {
+        length = get_sensor_data_json(source, body, g_response_pool.block_size);
+        content_type = "application/json";
+    }
+
+    if (length > 0) {
+        send_http_binary(client_socket, "200 OK", content_type, body, length);
+    } else {
+        send_http_response(client_socket, "500 Internal Server Error", "text/plain", "Failed to encode data");
+    }
+    mempool_free(&g_response_pool, body);
 }
 
-void send_api_data(int client_socket) {
-    char* json_data = get_sensor_data_json();
-    if (json_data) {
-        send_http_response(client_socket, "200 OK", "application/json", json_data);
-        free(json_data);
+// /api/summary?source=<id>&window=<rows>: statistics over the retained data
+// plus min/mean/max per `window` rows (0 disables the rollup)
+void send_api_summary(int client_socket, const char* query) {
+    char param[DATA_SOURCE_NAME_SIZE];
+    int source = -1;
+    int window = SUMMARY_DEFAULT_WINDOW;
+
+    if (get_query_param(query, "source", param, sizeof(param)) == 0) {
+        source = find_data_source(param);
+        if (source < 0) {
+            send_http_response(client_socket, "404 Not Found", "text/plain", "Unknown data source");
+            return;
+        }
+    }
+    if (get_query_param(query, "window", param, sizeof(param)) == 0) {
+        char* end;
+        long parsed = strtol(param, &end, 10);
+        if (param[0] == '\0' || *end != '\0' || parsed < 0 || parsed > MAX_DATA_POINTS * MAX_DATA_SOURCES) {
+            send_http_response(client_socket, "400 Bad Request", "text/plain", "Invalid window");
+            return;
+        }
+        window = (int)parsed;
+    }
+
+    char* body = mempool_alloc(&g_response_pool);
+    if (!body) {
+        send_http_response(client_socket, "503 Service Unavailable", "text/plain", "Server busy");
+        return;
+    }
+
+    size_t length = get_sensor_summary_json(source, window, body, g_response_pool.block_size);
+    if (length > 0) {
+        send_http_response(client_socket, "200 OK", "application/json", body);
+    } else {
+        send_http_response(client_socket, "500 Internal Server Error", "text/plain", "Failed to encode summary");
+    }
+    mempool_free(&g_response_pool, body);
+}
+
+void send_api_stats(int client_socket) {
+    tls_stats_t tls;
+    relay_stats_t relay;
+    log_stats_t log;
+    memory_stats_t memory;
+    archive_stats_t archive;
+    remote_write_stats_t remote_write;
+    shm_stats_t shm;
+    char body[API_RESPONSE_SIZE];
+
+    tls_client_get_stats(&tls);
+    relay_get_stats(&relay);
+    log_get_stats(&log);
+    memory_get_stats(&memory);
+    archive_get_stats(&archive);
+    remote_write_get_stats(&remote_write);
+    shm_publish_get_stats(&shm);
+
+    snprintf(body, sizeof(body),
+        "{\"upstream\":{\"framesReceived\":%llu,\"framesInvalid\":%llu,"
+        "\"hops\":%u,\"maxHops\":%u,\"latencyUs\":%lld,\"avgLatencyUs\":%lld,\"maxLatencyUs\":%lld,"
+        "\"reconnects\":%llu,\"resumed\":%llu,\"seqGaps\":%llu,\"backfilled\":%llu,\"backfillLost\":%llu},"
+        "\"alarms\":{\"received\":%llu,\"active\":%u,\"latencyUs\":%lld,\"avgLatencyUs\":%lld,"
+        "\"maxLatencyUs\":%lld},"
+        "\"relay\":{\"enabled\":%s,\"port\":%d,\"subscribers\":%d,\"framesForwarded\":%llu,"
+        "\"framesDropped\":%llu,\"avgHopLatencyUs\":%lld,\"maxHopLatencyUs\":%lld},"
+        "\"log\":{\"written\":%llu,\"dropped\":%llu,\"suppressed\":%llu},"
+        "\"memory\":{\"reservedBytes\":%zu,\"peakRssBytes\":%zu,\"poolExhausted\":%llu},"
+        "\"archive\":{\"blocks\":%d,\"samples\":%llu,\"usedBytes\":%zu,\"capacityBytes\":%zu,"
+        "\"bytesPerSample\":%.2f,\"oldestTs\":%lld},"
+        "\"remoteWrite\":{\"enabled\":%s,\"reachable\":%s,\"sent\":%llu,\"batches\":%llu,"
+        "\"failures\":%llu,\"rejected\":%llu,\"dropped\":%llu,\"invalid\":%llu,\"queued\":%llu,\"journaled\":%llu},"
+        "\"shm\":{\"enabled\":%s,\"slots\":%d,\"published\":%llu,\"waiters\":%d},\"anomaly\":",
+        (unsigned long long)tls.frames_received, (unsigned long long)tls.frames_invalid,
+        tls.last_hops, tls.max_hops, (long long)tls.latency_last_us,
+        (long long)(tls.latency_frames ? tls.latency_total_us / (int64_t)tls.latency_frames : 0),
+        (long long)tls.latency_max_us,
+        (unsigned long long)tls.reconnects, (unsigned long long)tls.resumed, (unsigned long long)tls.seq_gaps,
+        (unsigned long long)tls.backfilled, (unsigned long long)tls.backfill_lost,
+        (unsigned long long)tls.alarms_received, tls.alarms_active, (long long)tls.alarm_latency_last_us,
+        (long long)(tls.alarms_received ? tls.alarm_latency_total_us / (int64_t)tls.alarms_received : 0),
+        (long long)tls.alarm_latency_max_us,
+        relay.port ? "true" : "false", relay.port, relay.subscribers,
+        (unsigned long long)relay.frames_forwarded, (unsigned long long)relay.frames_dropped,
+        (long long)(relay.frames_forwarded ? relay.hop_latency_total_us / (int64_t)relay.frames_forwarded : 0),
+        (long long)relay.hop_latency_max_us,
+        (unsigned long long)log.written, (unsigned long long)log.dropped,
+        (unsigned long long)log.suppressed,
+        memory.reserved_bytes, memory.peak_rss_bytes, (unsigned long long)memory.exhausted,
+        archive.blocks, (unsigned long long)archive.samples, archive.used_bytes, archive.capacity_bytes,
+        archive.sealed_samples ? (double)archive.used_bytes / (double)archive.sealed_samples : 0.0,
+        (long long)archive.oldest_ms,
+        remote_write.enabled ? "true" : "false", remote_write.reachable ? "true" : "false",
+        (unsigned long long)remote_write.sent, (unsigned long long)remote_write.batches,
+        (unsigned long long)remote_write.failures, (unsigned long long)remote_write.rejected,
+        (unsigned long long)remote_write.dropped, (unsigned long long)remote_write.invalid,
+        (unsigned long long)remote_write.queued,
+        (unsigned long long)remote_write.journaled,
+        shm.enabled ? "true" : "false", shm.slots, (unsigned long long)shm.published, shm.waiters);
+
+    // Per-source detector scores close the object
+    size_t len = strlen(body);
+    size_t anomaly_len = get_anomaly_json(body + len, sizeof(body) - len - 1);
+    if (anomaly_len == 0) {
+        len += snprintf(body + len, sizeof(body) - len, "null");
     } else {
-        send_http_response(client_socket, "500 Internal Server Error", "text/plain", "Failed to generate JSON data");
+        len += anomaly_len;
     }
+    snprintf(body + len, sizeof(body) - len, "}");
+
+    send_http_response(client_socket, "200 OK", "application/json", body);
 }
 
 void send_static_file(int client_socket, const char* path) {
@@ -175,36 +470,32 @@ void send_static_file(int client_socket, const char* path) {
         return;
     }
 
-    // Read file content
-    char* content = malloc(file_size + 1);
-    if (!content) {
-        fclose(file);
-        send_http_response(client_socket, "500 Internal Server Error", "text/plain", "Memory allocation failed");
-        return;
-    }
-
-    size_t bytes_read = fread(content, 1, file_size, file);
-    content[bytes_read] = '\0';
-    fclose(file);
-
     // Determine content type
     const char* content_type = get_mime_type(path);
 
-    // Send response
-    char response_header[BUFFER_SIZE];
-    snprintf(response_header, sizeof(response_header),
+    // Send response header, then stream the file through a fixed buffer
+    char buffer[BUFFER_SIZE * 4];
+    int header_len = snprintf(buffer, sizeof(buffer),
         "HTTP/1.1 200 OK\r\n"
         "Content-Type: %s\r\n"
         "Content-Length: %ld\r\n"
         "Connection: close\r\n"
         "Access-Control-Allow-Origin: *\r\n"
         "\r\n",
-        content_type, bytes_read);
-
-    send(client_socket, response_header, strlen(response_header), 0);
-    send(client_socket, content, bytes_read, 0);
+        content_type, file_size);
+
+    if (http_send_all(client_socket, buffer, header_len) == 0) {
+        long remaining = file_size;
+        while (remaining > 0) {
+            size_t bytes_read = fread(buffer, 1, sizeof(buffer), file);
+            if (bytes_read == 0 || http_send_all(client_socket, buffer, bytes_read) != 0) {
+                break;
+            }
+            remaining -= (long)bytes_read;
+        }
+    }
 
-    free(content);
+    fclose(file);
 }
 
 const char* get_mime_type(const char* path) {
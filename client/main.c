@@ -2,7 +2,6 @@
 
 // 全局变量定义
 volatile int g_client_running = 1;
-WOLFSSL* g_ssl = NULL;
 int g_actual_http_port = HTTP_PORT;  // 实际使用的HTTP端口
 
 void signal_handler(int sig) {
@@ -11,64 +10,267 @@ void signal_handler(int sig) {
 }
 
 void print_usage(const char* program_name) {
-    printf("Usage: %s [server_ip]\n", program_name);
-    printf("  server_ip: IP address of the TLS server (default: %s)\n", DEFAULT_SERVER_IP);
-    printf("  Example: %s 192.168.1.100\n", program_name);
+    printf("Usage: %s [--log-level level] [--relay-port port] [--subscribe spec] [--retention-mb mb]\n"
+           "          [--remote-write url [--rw-batch n] [--rw-flush-ms ms] [--rw-journal path]]\n"
+           "          [--rt-cpus role=cpu,...] [--rt-fifo priority] [--rt-mlock]\n"
+           "          [--shm name [--shm-slots n]]\n"
+           "          [server_ip[:port] ...]\n", program_name);
+    printf("  server_ip: IP address of a TLS server (default: %s)\n", DEFAULT_SERVER_IP);
+    printf("  port:      TLS port of that server (default: %d)\n", TLS_PORT);
+    printf("  Up to %d servers may be given; their streams share one store.\n", MAX_UPSTREAMS);
+    printf("  --log-level:  error, warn, info (default) or debug; debug logs every\n");
+    printf("                sample and HTTP request, rate-limited per call site\n");
+    printf("  --relay-port: also accept mutual-TLS subscribers on this port and\n");
+    printf("                forward the upstream stream to them (single upstream only)\n");
+    printf("  --subscribe:  request a filtered/decimated view from the servers, e.g.\n");
+    printf("                \"speed decim=10 agg=mean\" or \"all rate=0.2 agg=max\"\n");
+    printf("  --retention-mb: memory for compressed history served by /api/export\n");
+    printf("                (default: %d)\n", ARCHIVE_DEFAULT_MB);
+    printf("  --remote-write: also POST every sample to a historian in InfluxDB line\n");
+    printf("                protocol, e.g. http://10.0.0.5:8086/api/v2/write?bucket=npp\n");
+    printf("  --rw-batch:   samples per request (default: %d)\n", RW_DEFAULT_BATCH);
+    printf("  --rw-flush-ms: send a partial batch after this long (default: %d)\n", RW_DEFAULT_FLUSH_MS);
+    printf("  --rw-journal: file that buffers samples while the historian is down\n");
+    printf("                (default: %s)\n", RW_DEFAULT_JOURNAL);
+    printf("  --rt-cpus:    pin threads by role: main, receiver, http, relay,\n");
+    printf("                remote-write, e.g. \"receiver=2,http=3\"\n");
+    printf("  --rt-fifo:    run the TLS receiver under SCHED_FIFO at this priority\n");
+    printf("  --rt-mlock:   lock all memory to avoid page faults\n");
+    printf("  --shm:        publish samples to the shared-memory ring /dev/shm/<name>\n");
+    printf("                for local readers (see common/shm_reader.h)\n");
+    printf("  --shm-slots:  ring size, a power of two (default: %d)\n", SHM_DEFAULT_SLOTS);
+    printf("  Example: %s 192.168.1.100 192.168.1.101:9443\n", program_name);
+    printf("  Relay:   %s --relay-port 9443 192.168.1.100\n", program_name);
     printf("\n");
     printf("The client will:\n");
-    printf("  1. Connect to TLS server on port %d to receive sensor data\n", TLS_PORT);
+    printf("  1. Connect to every TLS server to receive sensor data, retrying any\n");
+    printf("     that is not reachable yet\n");
     printf("  2. Start HTTP server on port %d (or next available port)\n", HTTP_PORT);
     printf("  3. Provide API endpoint and web interface on the HTTP server\n");
     printf("  4. Display actual port numbers when server starts\n");
 }
 
 int main(int argc, char* argv[]) {
-    const char* server_ip = DEFAULT_SERVER_IP;
+    const char* servers[MAX_UPSTREAMS];
+    int server_count = 0;
+    int relay_port = 0;
+    const char* subscription = NULL;
+    int log_level = LOG_LEVEL_INFO;
+    int retention_mb = ARCHIVE_DEFAULT_MB;
+    remote_write_config_t remote_write = { NULL, RW_DEFAULT_BATCH, RW_DEFAULT_FLUSH_MS, RW_DEFAULT_JOURNAL };
+    rt_config_t rt_config = { .pin_count = 0 };
+    const char* shm_name = NULL;
+    int shm_slots = SHM_DEFAULT_SLOTS;
 
     // Set up signal handlers for graceful shutdown
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
     // Parse command line arguments
-    if (argc > 2) {
-        printf("Error: Too many arguments\n\n");
-        print_usage(argv[0]);
-        return -1;
-    }
-    
-    if (argc == 2) {
-        if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
             print_usage(argv[0]);
             return 0;
         }
-        server_ip = argv[1];
+        if (strcmp(argv[i], "--relay-port") == 0) {
+            relay_port = (i + 1 < argc) ? atoi(argv[++i]) : 0;
+            if (relay_port <= 0 || relay_port > 65535) {
+                printf("Error: --relay-port requires a valid port number\n\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--log-level") == 0) {
+            log_level = (i + 1 < argc) ? log_parse_level(argv[++i]) : -1;
+            if (log_level < 0) {
+                printf("Error: --log-level requires error, warn, info or debug\n\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--retention-mb") == 0) {
+            retention_mb = (i + 1 < argc) ? atoi(argv[++i]) : 0;
+            if (retention_mb <= 0 || retention_mb > 65536) {
+                printf("Error: --retention-mb requires a size in megabytes\n\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--remote-write") == 0 || strcmp(argv[i], "--rw-journal") == 0) {
+            if (i + 1 >= argc) {
+                printf("Error: %s requires an argument\n\n", argv[i]);
+                print_usage(argv[0]);
+                return -1;
+            }
+            if (strcmp(argv[i], "--remote-write") == 0) {
+                remote_write.url = argv[++i];
+            } else {
+                remote_write.journal_path = argv[++i];
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--rw-batch") == 0) {
+            remote_write.batch_size = (i + 1 < argc) ? atoi(argv[++i]) : 0;
+            if (remote_write.batch_size <= 0 || remote_write.batch_size > RW_QUEUE_SIZE) {
+                printf("Error: --rw-batch requires a batch size between 1 and %d\n\n", RW_QUEUE_SIZE);
+                print_usage(argv[0]);
+                return -1;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--rw-flush-ms") == 0) {
+            remote_write.flush_ms = (i + 1 < argc) ? atoi(argv[++i]) : 0;
+            if (remote_write.flush_ms <= 0) {
+                printf("Error: --rw-flush-ms requires a positive interval\n\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--rt-cpus") == 0) {
+            if (i + 1 >= argc || rt_parse_cpus(&rt_config, argv[++i]) != 0) {
+                printf("Error: --rt-cpus requires role=cpu[,role=cpu...]\n\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--rt-fifo") == 0) {
+            rt_config.fifo_priority = (i + 1 < argc) ? atoi(argv[++i]) : 0;
+            if (rt_config.fifo_priority < 1 || rt_config.fifo_priority > 99) {
+                printf("Error: --rt-fifo requires a priority between 1 and 99\n\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--shm") == 0) {
+            if (i + 1 >= argc) {
+                printf("Error: --shm requires a shared memory name\n\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            shm_name = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--shm-slots") == 0) {
+            shm_slots = (i + 1 < argc) ? atoi(argv[++i]) : 0;
+            if (shm_slots <= 0 || (shm_slots & (shm_slots - 1)) != 0) {
+                printf("Error: --shm-slots requires a power of two\n\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--rt-mlock") == 0) {
+            rt_config.lock_memory = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--subscribe") == 0) {
+            if (i + 1 >= argc) {
+                printf("Error: --subscribe requires a subscription spec\n\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            subscription = argv[++i];
+            continue;
+        }
+        if (server_count >= MAX_UPSTREAMS) {
+            printf("Error: Too many servers (max %d)\n\n", MAX_UPSTREAMS);
+            print_usage(argv[0]);
+            return -1;
+        }
+        servers[server_count++] = argv[i];
     }
 
+    if (server_count == 0) {
+        servers[server_count++] = DEFAULT_SERVER_IP;
+    }
+
+    // A relay re-publishes exactly one upstream stream
+    if (relay_port && server_count > 1) {
+        printf("Error: relay mode accepts a single upstream server\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    // Placement applies to the main thread first, so every thread started
+    // later (including the logger) inherits it unless its role overrides it
+    rt_init(&rt_config);
+
+    // Start the asynchronous logger before any worker thread
+    log_init((log_level_t)log_level);
+
     printf("=== Nuclear Power Plant Monitoring Client ===\n");
-    printf("TLS Server: %s:%d\n", server_ip, TLS_PORT);
+    for (int i = 0; i < server_count; i++) {
+        printf("TLS Server: %s\n", servers[i]);
+    }
     printf("===============================================\n\n");
 
-    // Initialize data storage
-    init_data_storage();
+    // Initialize data storage with room for MAX_DATA_POINTS per upstream in
+    // total; sources share one FIFO ring, so a faster upstream keeps more of it
+    init_data_storage(MAX_DATA_POINTS * server_count);
+
+    // Modules are started in order and, on failure, everything started before
+    // is stopped in reverse order, the same ladder as the shutdown path: a
+    // remote-write thread or a live shared-memory ring must not outlive main
+    int status = -1;
+
+    // Older samples are kept compressed for exports
+    if (archive_init((size_t)retention_mb * 1024 * 1024) != 0) {
+        goto cleanup_storage;
+    }
+
+    // Local readers see every sample from the first one; sources register later
+    if (shm_name && shm_publish_init(shm_name, shm_slots) != 0) {
+        goto cleanup_archive;
+    }
+
+    // Forwarding to the historian starts before the first sample arrives
+    if (remote_write.url && remote_write_init(&remote_write) != 0) {
+        goto cleanup_shm;
+    }
+
+    // Reserve export jobs before the HTTP thread can accept an export
+    if (export_init() != 0) {
+        goto cleanup_remote_write;
+    }
 
     // Initialize HTTP server
     if (http_server_init() != 0) {
         fprintf(stderr, "Failed to initialize HTTP server\n");
-        cleanup_data_storage();
-        return -1;
+        goto cleanup_export;
+    }
+
+    // From here on the HTTP thread may be serving requests and running
+    // exports; both stop once g_client_running is cleared, so a failed
+    // start-up clears it before unwinding, as a signal does on shutdown
+
+    // Start the relay listener before any upstream frame can arrive
+    if (relay_port && relay_server_init(relay_port) != 0) {
+        fprintf(stderr, "Failed to initialize relay server\n");
+        g_client_running = 0;
+        goto cleanup_http;
     }
 
     // Initialize TLS client
-    if (tls_client_init(server_ip) != 0) {
+    if (tls_client_init(servers, server_count, subscription) != 0) {
         fprintf(stderr, "Failed to initialize TLS client\n");
-        cleanup_data_storage();
-        return -1;
+        g_client_running = 0;
+        goto cleanup_relay;
     }
 
     printf("\n=== Client Ready ===\n");
-    printf("✓ TLS connection established\n");
+    printf("✓ TLS client started (unreachable servers are retried)\n");
     printf("✓ HTTP server running on port %d\n", g_actual_http_port);
-    printf("✓ Data storage initialized\n");
+    if (relay_port) {
+        printf("✓ Relay listening on port %d\n", relay_port);
+    }
+    printf("✓ Data storage initialized\n\n");
+    memory_report();
     printf("\nPress Ctrl+C to exit\n");
     printf("Open http://localhost:%d/ in your browser to view the monitoring dashboard\n\n", g_actual_http_port);
 
@@ -78,11 +280,28 @@ int main(int argc, char* argv[]) {
     }
 
     printf("\n=== Shutting Down ===\n");
+    status = 0;
 
     // Cleanup in reverse order
     tls_client_cleanup();
+cleanup_relay:
+    relay_server_cleanup();
+cleanup_http:
+    http_server_cleanup();
+cleanup_export:
+    export_cleanup();
+cleanup_remote_write:
+    remote_write_cleanup();
+cleanup_shm:
+    shm_publish_cleanup();
+cleanup_archive:
+    archive_cleanup();
+cleanup_storage:
     cleanup_data_storage();
 
-    printf("Client shutdown completed.\n");
-    return 0;
-}
\ No newline at end of file
+    if (status == 0) {
+        printf("Client shutdown completed.\n");
+    }
+    log_shutdown();
+    return status;
+}
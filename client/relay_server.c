@@ -0,0 +1,451 @@
+#include "client.h"
+#include <poll.h>
+
+// 一个优先级的有界帧队列
+typedef struct {
+    char frames[RELAY_QUEUE_FRAMES][FRAME_MAX_SIZE];
+    int lengths[RELAY_QUEUE_FRAMES];
+    int64_t enqueued_us[RELAY_QUEUE_FRAMES];
+    int head;
+    int count;
+} relay_lane_t;
+
+// 下游订阅者：每个订阅者有独立的有界帧队列和发送线程，
+// 慢速订阅者只会丢弃自己最旧的帧，不会阻塞上游接收。
+// 报警帧走优先级队列，每次发送时排在积压的数据帧之前。
+// 中继只转发一路全量数据流、不保留历史，下游发来的控制行（SUB、RESUME）
+// 一律应答 C,ERR,unsupported
+typedef struct {
+    int in_use;
+    int active;                 // TLS握手完成，开始接收转发帧
+    int id;
+    int sockfd;
+    struct sockaddr_in addr;
+    WOLFSSL* ssl;
+    pthread_cond_t cond;
+    relay_lane_t lanes[FRAME_CLASS_COUNT];
+    char rx_buf[BUFFER_SIZE];   // 尚未组成完整行的下游输入
+    size_t rx_len;
+} relay_subscriber_t;
+
+static WOLFSSL_CTX* g_relay_ctx = NULL;
+static int g_relay_sockfd = -1;
+static int g_relay_port = 0;
+static volatile int g_relay_running = 0;
+static pthread_t g_relay_thread;
+static relay_subscriber_t g_subscribers[MAX_RELAY_SUBSCRIBERS];
+static pthread_mutex_t g_relay_mutex = PTHREAD_MUTEX_INITIALIZER;
+static relay_stats_t g_relay_stats;
+
+static void* relay_accept_thread(void* arg);
+static void* relay_subscriber_thread(void* arg);
+
+int relay_server_init(int port) {
+    struct sockaddr_in server_addr;
+    int opt = 1;
+
+    // Create SSL context for the downstream side
+    g_relay_ctx = TLS_CTX_NEW(wolfTLSv1_2_server_method, MAX_RELAY_SUBSCRIBERS);
+    if (g_relay_ctx == NULL) {
+        fprintf(stderr, "Relay: error creating SSL context\n");
+        return -1;
+    }
+
+    // Load relay certificate and private key
+    if (wolfSSL_CTX_use_certificate_file(g_relay_ctx, RELAY_CERT, SSL_FILETYPE_PEM) != SSL_SUCCESS) {
+        fprintf(stderr, "Relay: error loading certificate %s\n", RELAY_CERT);
+        wolfSSL_CTX_free(g_relay_ctx);
+        g_relay_ctx = NULL;
+        return -1;
+    }
+
+    if (wolfSSL_CTX_use_PrivateKey_file(g_relay_ctx, RELAY_KEY, SSL_FILETYPE_PEM) != SSL_SUCCESS) {
+        fprintf(stderr, "Relay: error loading private key %s\n", RELAY_KEY);
+        wolfSSL_CTX_free(g_relay_ctx);
+        g_relay_ctx = NULL;
+        return -1;
+    }
+
+    // Load CA certificate for subscriber verification
+    if (wolfSSL_CTX_load_verify_locations(g_relay_ctx, CA_CERT, NULL) != SSL_SUCCESS) {
+        fprintf(stderr, "Relay: error loading CA certificate\n");
+        wolfSSL_CTX_free(g_relay_ctx);
+        g_relay_ctx = NULL;
+        return -1;
+    }
+
+    // Subscribers must present a certificate, as with the origin server
+    wolfSSL_CTX_set_verify(g_relay_ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+
+    // Create listening socket
+    g_relay_sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (g_relay_sockfd < 0) {
+        perror("Relay socket creation failed");
+        wolfSSL_CTX_free(g_relay_ctx);
+        g_relay_ctx = NULL;
+        return -1;
+    }
+
+    if (setsockopt(g_relay_sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        perror("Relay setsockopt failed");
+        close(g_relay_sockfd);
+        wolfSSL_CTX_free(g_relay_ctx);
+        g_relay_ctx = NULL;
+        return -1;
+    }
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(port);
+
+    if (bind(g_relay_sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0 ||
+        listen(g_relay_sockfd, MAX_RELAY_SUBSCRIBERS) < 0) {
+        perror("Relay bind/listen failed");
+        close(g_relay_sockfd);
+        wolfSSL_CTX_free(g_relay_ctx);
+        g_relay_ctx = NULL;
+        return -1;
+    }
+
+    for (int i = 0; i < MAX_RELAY_SUBSCRIBERS; i++) {
+        pthread_cond_init(&g_subscribers[i].cond, NULL);
+    }
+
+    g_relay_port = port;
+    g_relay_running = 1;
+    if (pthread_create(&g_relay_thread, NULL, relay_accept_thread, NULL) != 0) {
+        fprintf(stderr, "Failed to create relay accept thread\n");
+        g_relay_running = 0;
+        close(g_relay_sockfd);
+        wolfSSL_CTX_free(g_relay_ctx);
+        g_relay_ctx = NULL;
+        return -1;
+    }
+
+    printf("Relay listening on port %d (max %d subscribers)\n", port, MAX_RELAY_SUBSCRIBERS);
+    return 0;
+}
+
+static void* relay_accept_thread(void* arg) {
+    (void)arg;
+    struct sockaddr_in client_addr;
+    socklen_t client_len;
+    int subscriber_id_counter = 0;
+
+    // Subscriber threads are started from here and inherit this placement
+    rt_thread_setup("relay", 0);
+
+    while (g_relay_running && g_client_running) {
+        client_len = sizeof(client_addr);
+        int connfd = accept(g_relay_sockfd, (struct sockaddr*)&client_addr, &client_len);
+        if (connfd < 0) {
+            if (g_relay_running && g_client_running) {
+                perror("Relay accept failed");
+            }
+            continue;
+        }
+
+        // Claim a free subscriber slot
+        relay_subscriber_t* sub = NULL;
+        pthread_mutex_lock(&g_relay_mutex);
+        for (int i = 0; i < MAX_RELAY_SUBSCRIBERS; i++) {
+            if (!g_subscribers[i].in_use) {
+                sub = &g_subscribers[i];
+                sub->in_use = 1;
+                sub->active = 0;
+                memset(sub->lanes, 0, sizeof(sub->lanes));
+                sub->rx_len = 0;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&g_relay_mutex);
+
+        if (sub == NULL) {
+            printf("Relay: maximum subscribers reached (%d), rejecting %s:%d\n",
+                   MAX_RELAY_SUBSCRIBERS, inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+            close(connfd);
+            continue;
+        }
+
+        // A subscriber that stalls its handshake or stops reading is dropped
+        struct timeval io_timeout = { RELAY_IO_TIMEOUT_SEC, 0 };
+        setsockopt(connfd, SOL_SOCKET, SO_SNDTIMEO, &io_timeout, sizeof(io_timeout));
+        setsockopt(connfd, SOL_SOCKET, SO_RCVTIMEO, &io_timeout, sizeof(io_timeout));
+
+        sub->sockfd = connfd;
+        sub->addr = client_addr;
+        sub->id = ++subscriber_id_counter;
+        sub->ssl = NULL;
+
+        pthread_t thread_id;
+        if (pthread_create(&thread_id, NULL, relay_subscriber_thread, sub) != 0) {
+            fprintf(stderr, "Relay: thread creation failed\n");
+            close(connfd);
+            pthread_mutex_lock(&g_relay_mutex);
+            sub->in_use = 0;
+            pthread_mutex_unlock(&g_relay_mutex);
+            continue;
+        }
+        pthread_detach(thread_id);
+    }
+
+    pthread_exit(NULL);
+}
+
+// Answer the control lines a subscriber has sent so far; returns -1 once the
+// subscriber is gone. Only reads when input is already waiting, so the send
+// loop is not held up by a subscriber that never writes.
+static int relay_read_control(relay_subscriber_t* sub) {
+    struct pollfd pfd = { sub->sockfd, POLLIN, 0 };
+
+    if (wolfSSL_pending(sub->ssl) == 0 && poll(&pfd, 1, 0) <= 0) {
+        return 0;
+    }
+    if (sub->rx_len == sizeof(sub->rx_buf) - 1) {
+        // A line longer than the buffer is not a valid command
+        sub->rx_len = 0;
+    }
+    int ret = wolfSSL_read(sub->ssl, sub->rx_buf + sub->rx_len, sizeof(sub->rx_buf) - 1 - sub->rx_len);
+    if (ret <= 0) {
+        int error = wolfSSL_get_error(sub->ssl, ret);
+        return (ret < 0 && (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)) ? 0 : -1;
+    }
+    sub->rx_len += ret;
+    sub->rx_buf[sub->rx_len] = '\0';
+
+    char* start = sub->rx_buf;
+    char* newline;
+    while ((newline = strchr(start, '\n')) != NULL) {
+        *newline = '\0';
+        if (newline > start && newline[-1] == '\r') {
+            newline[-1] = '\0';
+        }
+        if (*start) {
+            char reply[32];
+            int reply_len = snprintf(reply, sizeof(reply), "%c,ERR,unsupported\n", FRAME_TYPE_CONTROL);
+            LOG_RATELIMITED(LOG_LEVEL_INFO, 1000, "[Relay %d] Unsupported request: %s\n", sub->id, start);
+            if (wolfSSL_write(sub->ssl, reply, reply_len) <= 0) {
+                return -1;
+            }
+        }
+        start = newline + 1;
+    }
+    sub->rx_len = strlen(start);
+    memmove(sub->rx_buf, start, sub->rx_len + 1);
+    return 0;
+}
+
+static void* relay_subscriber_thread(void* arg) {
+    relay_subscriber_t* sub = (relay_subscriber_t*)arg;
+    char batch[FRAME_CLASS_COUNT * RELAY_QUEUE_FRAMES * FRAME_MAX_SIZE];
+    int64_t enqueued_us[FRAME_CLASS_COUNT * RELAY_QUEUE_FRAMES];
+    int ret;
+
+    printf("[Relay %d] Connected from %s:%d\n", sub->id,
+           inet_ntoa(sub->addr.sin_addr), ntohs(sub->addr.sin_port));
+
+    sub->ssl = wolfSSL_new(g_relay_ctx);
+    if (sub->ssl == NULL) {
+        fprintf(stderr, "[Relay %d] Error creating SSL object\n", sub->id);
+        goto cleanup;
+    }
+    wolfSSL_set_fd(sub->ssl, sub->sockfd);
+
+    ret = wolfSSL_accept(sub->ssl);
+    if (ret != SSL_SUCCESS) {
+        int error = wolfSSL_get_error(sub->ssl, ret);
+        char error_string[80];
+        wolfSSL_ERR_error_string(error, error_string);
+        fprintf(stderr, "[Relay %d] TLS handshake failed: %s\n", sub->id, error_string);
+        goto cleanup;
+    }
+
+    WOLFSSL_X509* peer_cert = wolfSSL_get_peer_certificate(sub->ssl);
+    if (peer_cert) {
+        char* subject = wolfSSL_X509_NAME_oneline(
+            wolfSSL_X509_get_subject_name(peer_cert), 0, 0);
+        printf("[Relay %d] Certificate subject: %s\n", sub->id, subject);
+        XFREE(subject, 0, DYNAMIC_TYPE_OPENSSL);
+        wolfSSL_X509_free(peer_cert);
+    }
+
+    pthread_mutex_lock(&g_relay_mutex);
+    sub->active = 1;
+    g_relay_stats.subscribers++;
+    pthread_mutex_unlock(&g_relay_mutex);
+
+    printf("[Relay %d] Subscribed\n", sub->id);
+
+    while (g_relay_running && g_client_running) {
+        if (relay_read_control(sub) != 0) {
+            printf("[Relay %d] Subscriber lost\n", sub->id);
+            break;
+        }
+
+        // Wait for queued frames, waking up periodically to notice shutdown
+        // and subscriber input
+        pthread_mutex_lock(&g_relay_mutex);
+        while (sub->lanes[FRAME_CLASS_PRIORITY].count == 0 && sub->lanes[FRAME_CLASS_BULK].count == 0 &&
+               g_relay_running && g_client_running) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1;
+            pthread_cond_timedwait(&sub->cond, &g_relay_mutex, &deadline);
+        }
+
+        // Take every queued frame so they go out in a single write, alarms first
+        int batch_len = 0;
+        int frames = 0;
+        for (int c = 0; c < FRAME_CLASS_COUNT; c++) {
+            relay_lane_t* lane = &sub->lanes[c];
+            for (int i = 0; i < lane->count; i++) {
+                int idx = (lane->head + i) % RELAY_QUEUE_FRAMES;
+                memcpy(batch + batch_len, lane->frames[idx], lane->lengths[idx]);
+                batch_len += lane->lengths[idx];
+                enqueued_us[frames++] = lane->enqueued_us[idx];
+            }
+            lane->head = 0;
+            lane->count = 0;
+        }
+        pthread_mutex_unlock(&g_relay_mutex);
+
+        if (batch_len == 0) {
+            continue;
+        }
+
+        ret = wolfSSL_write(sub->ssl, batch, batch_len);
+        if (ret <= 0) {
+            printf("[Relay %d] Subscriber lost\n", sub->id);
+            break;
+        }
+
+        // Per-hop latency: time from receipt on the upstream side to hand-off downstream
+        int64_t now_us = protocol_now_us();
+        pthread_mutex_lock(&g_relay_mutex);
+        for (int i = 0; i < frames; i++) {
+            int64_t latency_us = now_us - enqueued_us[i];
+            g_relay_stats.hop_latency_total_us += latency_us;
+            if (latency_us > g_relay_stats.hop_latency_max_us) {
+                g_relay_stats.hop_latency_max_us = latency_us;
+            }
+        }
+        g_relay_stats.frames_forwarded += frames;
+        pthread_mutex_unlock(&g_relay_mutex);
+    }
+
+cleanup:
+    pthread_mutex_lock(&g_relay_mutex);
+    if (sub->active) {
+        g_relay_stats.subscribers--;
+    }
+    sub->active = 0;
+    pthread_mutex_unlock(&g_relay_mutex);
+
+    if (sub->ssl) {
+        wolfSSL_shutdown(sub->ssl);
+        wolfSSL_free(sub->ssl);
+        sub->ssl = NULL;
+    }
+    close(sub->sockfd);
+    printf("[Relay %d] Connection closed\n", sub->id);
+
+    // Release the slot last so the accept thread cannot reuse it early
+    pthread_mutex_lock(&g_relay_mutex);
+    sub->in_use = 0;
+    pthread_mutex_unlock(&g_relay_mutex);
+
+    pthread_exit(NULL);
+}
+
+void relay_forward_frame(const char* frame, size_t length) {
+    if (!g_relay_running || length > FRAME_MAX_SIZE) {
+        return;
+    }
+
+    // Copy the encoded frame once and bump its hop counter in place
+    char forwarded[FRAME_MAX_SIZE];
+    memcpy(forwarded, frame, length);
+    if (frame_increment_hops(forwarded, length) < 0) {
+        pthread_mutex_lock(&g_relay_mutex);
+        g_relay_stats.frames_dropped++;
+        pthread_mutex_unlock(&g_relay_mutex);
+        return;
+    }
+
+    int64_t now_us = protocol_now_us();
+    frame_class_t class = frame_class(forwarded);
+
+    pthread_mutex_lock(&g_relay_mutex);
+    for (int i = 0; i < MAX_RELAY_SUBSCRIBERS; i++) {
+        relay_subscriber_t* sub = &g_subscribers[i];
+        if (!sub->active) {
+            continue;
+        }
+
+        // Bounded queue: overwrite the oldest frame when the subscriber falls behind
+        relay_lane_t* lane = &sub->lanes[class];
+        if (lane->count == RELAY_QUEUE_FRAMES) {
+            lane->head = (lane->head + 1) % RELAY_QUEUE_FRAMES;
+            lane->count--;
+            g_relay_stats.frames_dropped++;
+        }
+        int idx = (lane->head + lane->count) % RELAY_QUEUE_FRAMES;
+        memcpy(lane->frames[idx], forwarded, length);
+        lane->lengths[idx] = (int)length;
+        lane->enqueued_us[idx] = now_us;
+        lane->count++;
+        pthread_cond_signal(&sub->cond);
+    }
+    pthread_mutex_unlock(&g_relay_mutex);
+}
+
+void relay_get_stats(relay_stats_t* stats) {
+    pthread_mutex_lock(&g_relay_mutex);
+    *stats = g_relay_stats;
+    stats->port = g_relay_running ? g_relay_port : 0;
+    pthread_mutex_unlock(&g_relay_mutex);
+}
+
+void relay_server_cleanup(void) {
+    if (!g_relay_running) {
+        return;
+    }
+
+    printf("Cleaning up relay server...\n");
+
+    // Unblock accept() and wake every subscriber thread
+    g_relay_running = 0;
+    shutdown(g_relay_sockfd, SHUT_RDWR);
+    close(g_relay_sockfd);
+    g_relay_sockfd = -1;
+    pthread_join(g_relay_thread, NULL);
+
+    pthread_mutex_lock(&g_relay_mutex);
+    for (int i = 0; i < MAX_RELAY_SUBSCRIBERS; i++) {
+        pthread_cond_signal(&g_subscribers[i].cond);
+    }
+    pthread_mutex_unlock(&g_relay_mutex);
+
+    // Wait for all subscriber threads to finish
+    for (;;) {
+        int in_use = 0;
+        pthread_mutex_lock(&g_relay_mutex);
+        for (int i = 0; i < MAX_RELAY_SUBSCRIBERS; i++) {
+            in_use += g_subscribers[i].in_use;
+        }
+        pthread_mutex_unlock(&g_relay_mutex);
+        if (in_use == 0) {
+            break;
+        }
+        usleep(100000); // Sleep for 100ms
+    }
+
+    for (int i = 0; i < MAX_RELAY_SUBSCRIBERS; i++) {
+        pthread_cond_destroy(&g_subscribers[i].cond);
+    }
+
+    wolfSSL_CTX_free(g_relay_ctx);
+    g_relay_ctx = NULL;
+    printf("Relay server cleanup completed.\n");
+}
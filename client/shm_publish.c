@@ -0,0 +1,142 @@
+#include "client.h"
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "shm_ring.h"
+
+// 共享内存发布：把每个数据点写入 /dev/shm/<name> 中的环形缓冲区，布局和读写协议
+// 见 common/shm_ring.h。发布在 add_sensor_data_batch 持有 g_data_mutex 时进行，
+// 因此只有一个写者；发布只是几次内存写入，读者不会反过来影响客户端。
+
+static shm_ring_header_t* g_ring = NULL;
+static shm_ring_slot_t* g_slots = NULL;
+static size_t g_map_size = 0;
+static char g_shm_name[64];
+static uint64_t g_published = 0;
+
+int shm_publish_init(const char* name, int slots) {
+    if (slots <= 0 || (slots & (slots - 1)) != 0) {
+        fprintf(stderr, "Shared memory ring size must be a power of two: %d\n", slots);
+        return -1;
+    }
+    snprintf(g_shm_name, sizeof(g_shm_name), "%s%s", name[0] == '/' ? "" : "/", name);
+
+    // Start from a fresh object: readers of a previous run see it closed and reopen
+    shm_unlink(g_shm_name);
+    int fd = shm_open(g_shm_name, O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+        perror("Shared memory ring");
+        return -1;
+    }
+
+    g_map_size = SHM_RING_HEADER_SIZE + (size_t)slots * sizeof(shm_ring_slot_t);
+    if (ftruncate(fd, (off_t)g_map_size) != 0) {
+        perror("Shared memory ring");
+        close(fd);
+        shm_unlink(g_shm_name);
+        return -1;
+    }
+    void* map = mmap(NULL, g_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("Shared memory ring");
+        shm_unlink(g_shm_name);
+        return -1;
+    }
+
+    // ftruncate zero-fills, so every slot starts with seq 0 (never published)
+    g_ring = (shm_ring_header_t*)map;
+    g_slots = (shm_ring_slot_t*)((char*)map + SHM_RING_HEADER_SIZE);
+    g_ring->version = SHM_RING_VERSION;
+    g_ring->header_size = SHM_RING_HEADER_SIZE;
+    g_ring->slot_size = sizeof(shm_ring_slot_t);
+    g_ring->capacity = (uint32_t)slots;
+    g_ring->writer_pid = (int32_t)getpid();
+    g_ring->state = SHM_RING_LIVE;
+    // The magic goes last: a reader that sees it sees a complete header
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(g_ring->magic, SHM_RING_MAGIC, 4);
+
+    memory_account("shm ring", g_map_size);
+    printf("Publishing samples to shared memory %s (%d slots, %zu bytes)\n", g_shm_name, slots, g_map_size);
+    return 0;
+}
+
+static void wake_readers(void) {
+    // Sequentially consistent, paired with the reader's increment of waiters:
+    // either the reader sees the new notify value or this sees its waiter
+    __atomic_add_fetch(&g_ring->notify, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&g_ring->waiters, __ATOMIC_SEQ_CST) > 0) {
+        syscall(SYS_futex, &g_ring->notify, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+    }
+}
+
+// Called once per new source id, before any sample of that source
+void shm_publish_source(int source, const char* name) {
+    if (!g_ring || source < 0 || source >= SHM_RING_SOURCES) {
+        return;
+    }
+    snprintf(g_ring->source_names[source], SHM_RING_SOURCE_NAME_SIZE, "%s", name);
+    if ((uint32_t)source >= g_ring->source_count) {
+        __atomic_store_n(&g_ring->source_count, (uint32_t)source + 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Called with g_data_mutex held, which makes this the only writer. Samples
+// received together are published with one write_seq update and one wakeup.
+void shm_publish_samples(const int64_t* timestamp_ms, const double* centrifuge_speed, const double* power_output,
+                         const uint8_t* anomaly, int count, int source) {
+    if (!g_ring || count <= 0) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t publish_ns = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    uint32_t mask = g_ring->capacity - 1;
+
+    for (int i = 0; i < count; i++) {
+        uint64_t n = g_published + (uint64_t)i;
+        shm_ring_slot_t* slot = &g_slots[n & mask];
+
+        __atomic_store_n(&slot->seq, 2 * n + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        slot->timestamp_ms = timestamp_ms[i];
+        slot->publish_ns = publish_ns;
+        slot->centrifuge_speed = centrifuge_speed[i];
+        slot->power_output = power_output[i];
+        slot->source = (uint32_t)source;
+        slot->anomaly = anomaly[i];
+        __atomic_store_n(&slot->seq, 2 * n + 2, __ATOMIC_RELEASE);
+    }
+
+    g_published += (uint64_t)count;
+    __atomic_store_n(&g_ring->write_seq, g_published, __ATOMIC_RELEASE);
+    wake_readers();
+}
+
+void shm_publish_get_stats(shm_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!g_ring) {
+        return;
+    }
+    stats->enabled = 1;
+    stats->slots = (int)g_ring->capacity;
+    stats->published = __atomic_load_n(&g_ring->write_seq, __ATOMIC_ACQUIRE);
+    stats->waiters = (int)__atomic_load_n(&g_ring->waiters, __ATOMIC_RELAXED);
+}
+
+void shm_publish_cleanup(void) {
+    if (!g_ring) {
+        return;
+    }
+
+    // Tell attached readers to let go, then remove the name
+    __atomic_store_n(&g_ring->state, SHM_RING_CLOSED, __ATOMIC_RELEASE);
+    wake_readers();
+    munmap(g_ring, g_map_size);
+    shm_unlink(g_shm_name);
+    g_ring = NULL;
+    g_slots = NULL;
+}
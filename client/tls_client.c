@@ -1,20 +1,257 @@
 #include "client.h"
+#include <fcntl.h>
+#include <poll.h>
+
+// 上游会话的连接进度；连接和握手都是非阻塞的，由接收线程的 poll 循环推进
+typedef enum {
+    UPSTREAM_DOWN,        // 未连接，retry_at_ms 到期后重连
+    UPSTREAM_CONNECTING,  // TCP 连接进行中
+    UPSTREAM_HANDSHAKE,   // TLS 握手进行中
+    UPSTREAM_UP
+} upstream_state_t;
+
+// 单个上游TLS服务器的会话
+typedef struct {
+    char host[64];
+    int port;
+    struct sockaddr_in addr;
+    int sockfd;
+    WOLFSSL* ssl;
+    upstream_state_t state;
+    short wait_events;    // 连接或握手等待的 poll 事件
+    int64_t deadline_ms;  // 连接和握手须在此之前完成
+    int established;      // 曾经连接成功，之后的连接计为重连
+    WOLFSSL_SESSION* session;  // 上次连接的会话（含票据），重连时用于恢复
+    int source_id;  // 数据存储中的来源编号
+    char rx_buf[RX_BUFFER_SIZE];  // 尚未组成完整帧的接收数据
+    size_t rx_len;
+    unsigned alarm_mask;  // 该上游当前置位报警的通道
+    uint64_t last_seq;    // 最近收到的数据帧序号，重连后据此请求补发
+    int64_t retry_at_ms;  // 断开后下一次重连的时间
+    int retry_ms;
+} upstream_t;
 
 static WOLFSSL_CTX* g_ctx = NULL;
-static int g_sockfd = -1;
+static upstream_t g_upstreams[MAX_UPSTREAMS];
+static int g_upstream_count = 0;
 static pthread_t g_receiver_thread;
+static const char* g_subscription = NULL;  // 发送给上游的订阅参数，NULL 表示全量
+static tls_stats_t g_tls_stats;
+static pthread_mutex_t g_tls_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-int tls_client_init(const char* server_ip) {
-    struct sockaddr_in server_addr;
-    int ret;
+// Split "<ipv4>[:port]" into its parts; the port defaults to TLS_PORT
+static int parse_upstream_address(const char* spec, upstream_t* upstream) {
+    char* host = upstream->host;
+    size_t host_size = sizeof(upstream->host);
+    int* port = &upstream->port;
+    const char* colon = strrchr(spec, ':');
+    size_t host_len = colon ? (size_t)(colon - spec) : strlen(spec);
+
+    if (host_len == 0 || host_len >= host_size) {
+        return -1;
+    }
+    memcpy(host, spec, host_len);
+    host[host_len] = '\0';
+
+    *port = TLS_PORT;
+    if (colon) {
+        char* end;
+        long value = strtol(colon + 1, &end, 10);
+        if (*end != '\0' || value <= 0 || value > 65535) {
+            return -1;
+        }
+        *port = (int)value;
+    }
+
+    memset(&upstream->addr, 0, sizeof(upstream->addr));
+    upstream->addr.sin_family = AF_INET;
+    upstream->addr.sin_port = htons(*port);
+    if (inet_pton(AF_INET, host, &upstream->addr.sin_addr) <= 0) {
+        return -1;
+    }
+    return 0;
+}
 
-    printf("Connecting to TLS server: %s:%d\n", server_ip, TLS_PORT);
+static void close_upstream(upstream_t* upstream) {
+    if (upstream->ssl) {
+        wolfSSL_shutdown(upstream->ssl);
+        wolfSSL_free(upstream->ssl);
+        upstream->ssl = NULL;
+    }
+    if (upstream->sockfd >= 0) {
+        close(upstream->sockfd);
+        upstream->sockfd = -1;
+    }
+    upstream->rx_len = 0;
+    upstream->state = UPSTREAM_DOWN;
+
+    // Alarms of a lost upstream can no longer be cleared by it
+    pthread_mutex_lock(&g_tls_stats_mutex);
+    g_tls_stats.alarms_active -= __builtin_popcount(upstream->alarm_mask);
+    pthread_mutex_unlock(&g_tls_stats_mutex);
+    upstream->alarm_mask = 0;
+}
+
+// Start a non-blocking connect; the receiver loop completes it. A socket is
+// writable once connected, so the first wait is always for POLLOUT.
+static int start_connect(upstream_t* upstream) {
+    printf("Connecting to TLS server: %s:%d\n", upstream->host, upstream->port);
+
+    // Create socket
+    upstream->sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (upstream->sockfd < 0) {
+        perror("Socket creation failed");
+        return -1;
+    }
+    int flags = fcntl(upstream->sockfd, F_GETFL, 0);
+    fcntl(upstream->sockfd, F_SETFL, flags | O_NONBLOCK);
+
+    // Connect to server
+    if (connect(upstream->sockfd, (struct sockaddr*)&upstream->addr, sizeof(upstream->addr)) < 0 &&
+        errno != EINPROGRESS) {
+        perror("Connection to server failed");
+        close_upstream(upstream);
+        return -1;
+    }
+
+    upstream->state = UPSTREAM_CONNECTING;
+    upstream->wait_events = POLLOUT;
+    upstream->deadline_ms = protocol_now_us() / 1000 + CONNECT_TIMEOUT_SEC * 1000;
+    return 0;
+}
+
+// The handshake is done: report the session and send the opening requests
+static int finish_connect(upstream_t* upstream) {
+    printf("[%s:%d] TLS handshake completed%s\n", upstream->host, upstream->port,
+           wolfSSL_session_reused(upstream->ssl) ? " (session resumed)" : " successfully!");
+
+    // Get server certificate information
+    WOLFSSL_X509* server_cert = wolfSSL_get_peer_certificate(upstream->ssl);
+    if (server_cert) {
+        char* subject = wolfSSL_X509_NAME_oneline(
+            wolfSSL_X509_get_subject_name(server_cert), 0, 0);
+        printf("[%s:%d] Server certificate subject: %s\n", upstream->host, upstream->port, subject);
+        XFREE(subject, 0, DYNAMIC_TYPE_OPENSSL);
+        wolfSSL_X509_free(server_cert);
+    }
+
+    // Display cipher suite information
+    printf("[%s:%d] Cipher suite: %s\n", upstream->host, upstream->port, wolfSSL_get_cipher(upstream->ssl));
+    printf("[%s:%d] Protocol version: %s\n", upstream->host, upstream->port, wolfSSL_get_version(upstream->ssl));
+    printf("\n");
+
+    // Ask the server for a filtered / decimated view instead of the full stream
+    if (g_subscription) {
+        char request[BUFFER_SIZE];
+        int len = snprintf(request, sizeof(request), "SUB %s\n", g_subscription);
+        if (len >= (int)sizeof(request) || wolfSSL_write(upstream->ssl, request, len) <= 0) {
+            fprintf(stderr, "[%s:%d] Failed to send subscription\n", upstream->host, upstream->port);
+            return -1;
+        }
+        printf("[%s:%d] Requested subscription: %s\n", upstream->host, upstream->port, g_subscription);
+    }
+
+    // After a reconnect, ask for what was broadcast while we were away
+    if (upstream->last_seq > 0) {
+        char request[64];
+        int len = snprintf(request, sizeof(request), "RESUME %llu\n", (unsigned long long)upstream->last_seq);
+        if (wolfSSL_write(upstream->ssl, request, len) <= 0) {
+            fprintf(stderr, "[%s:%d] Failed to send resume request\n", upstream->host, upstream->port);
+            return -1;
+        }
+    }
+
+    // Keep the session (and the ticket the server sent with it) for the next connect
+    int resumed = wolfSSL_session_reused(upstream->ssl);
+    if (upstream->session) {
+        wolfSSL_SESSION_free(upstream->session);
+    }
+    upstream->session = wolfSSL_get1_session(upstream->ssl);
+
+    upstream->state = UPSTREAM_UP;
+    upstream->retry_ms = 0;
+    if (upstream->established) {
+        pthread_mutex_lock(&g_tls_stats_mutex);
+        g_tls_stats.reconnects++;
+        g_tls_stats.resumed += resumed;
+        pthread_mutex_unlock(&g_tls_stats_mutex);
+    }
+    upstream->established = 1;
+    return 0;
+}
+
+// Take the connect or handshake one step further once the socket is ready.
+// Returns 0 while it progresses (or has completed), -1 on failure.
+static int advance_connect(upstream_t* upstream) {
+    if (upstream->state == UPSTREAM_CONNECTING) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(upstream->sockfd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+            fprintf(stderr, "[%s:%d] Connection to server failed: %s\n", upstream->host, upstream->port,
+                    strerror(error != 0 ? error : errno));
+            return -1;
+        }
+        printf("Connected to TLS server %s:%d\n", upstream->host, upstream->port);
+
+        // Create SSL object
+        upstream->ssl = wolfSSL_new(g_ctx);
+        if (upstream->ssl == NULL) {
+            fprintf(stderr, "Error creating SSL object\n");
+            return -1;
+        }
+
+        // Offer the previous session; the server falls back to a full handshake
+        // if it cannot open the ticket
+        if (upstream->session) {
+            wolfSSL_set_session(upstream->ssl, upstream->session);
+        }
+
+        // Associate socket with SSL; the shared event loop must never block on it
+        wolfSSL_set_fd(upstream->ssl, upstream->sockfd);
+        wolfSSL_set_using_nonblock(upstream->ssl, 1);
+        upstream->state = UPSTREAM_HANDSHAKE;
+    }
+
+    // Perform TLS handshake, as far as the data received so far allows
+    int ret = wolfSSL_connect(upstream->ssl);
+    if (ret != SSL_SUCCESS) {
+        int error = wolfSSL_get_error(upstream->ssl, ret);
+        if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+            upstream->wait_events = error == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT;
+            return 0;
+        }
+        char error_string[80];
+        wolfSSL_ERR_error_string(error, error_string);
+        fprintf(stderr, "[%s:%d] TLS handshake failed: %s\n", upstream->host, upstream->port, error_string);
+        return -1;
+    }
+    return finish_connect(upstream);
+}
+
+// Disconnected upstreams are retried with exponential backoff, so a server
+// restart (or a graceful upgrade) costs only the reconnect and a backfill
+static void schedule_reconnect(upstream_t* upstream) {
+    int64_t now_ms = protocol_now_us() / 1000;
+
+    upstream->retry_ms = upstream->retry_ms == 0 ? RECONNECT_MIN_MS : upstream->retry_ms * 2;
+    if (upstream->retry_ms > RECONNECT_MAX_MS) {
+        upstream->retry_ms = RECONNECT_MAX_MS;
+    }
+    upstream->retry_at_ms = now_ms + upstream->retry_ms;
+}
+
+int tls_client_init(const char* const* servers, int server_count, const char* subscription) {
+    if (server_count <= 0 || server_count > MAX_UPSTREAMS) {
+        fprintf(stderr, "Invalid number of TLS servers: %d (max %d)\n", server_count, MAX_UPSTREAMS);
+        return -1;
+    }
+    g_subscription = subscription;
 
     // Initialize wolfSSL
     wolfSSL_Init();
 
     // Create SSL context
-    g_ctx = wolfSSL_CTX_new(wolfTLSv1_2_client_method());
+    g_ctx = TLS_CTX_NEW(wolfTLSv1_2_client_method, MAX_UPSTREAMS);
     if (g_ctx == NULL) {
         fprintf(stderr, "Error creating SSL context\n");
         return -1;
@@ -24,6 +261,7 @@ int tls_client_init(const char* server_ip) {
     if (wolfSSL_CTX_use_certificate_file(g_ctx, CLIENT_CERT, SSL_FILETYPE_PEM) != SSL_SUCCESS) {
         fprintf(stderr, "Error loading client certificate\n");
         wolfSSL_CTX_free(g_ctx);
+        g_ctx = NULL;
         return -1;
     }
 
@@ -31,6 +269,7 @@ int tls_client_init(const char* server_ip) {
     if (wolfSSL_CTX_use_PrivateKey_file(g_ctx, CLIENT_KEY, SSL_FILETYPE_PEM) != SSL_SUCCESS) {
         fprintf(stderr, "Error loading client private key\n");
         wolfSSL_CTX_free(g_ctx);
+        g_ctx = NULL;
         return -1;
     }
 
@@ -38,160 +277,427 @@ int tls_client_init(const char* server_ip) {
     if (wolfSSL_CTX_load_verify_locations(g_ctx, CA_CERT, NULL) != SSL_SUCCESS) {
         fprintf(stderr, "Error loading CA certificate\n");
         wolfSSL_CTX_free(g_ctx);
+        g_ctx = NULL;
         return -1;
     }
 
     // Enable server certificate verification
     wolfSSL_CTX_set_verify(g_ctx, SSL_VERIFY_PEER, NULL);
 
-    // Create socket
-    g_sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (g_sockfd < 0) {
-        perror("Socket creation failed");
-        wolfSSL_CTX_free(g_ctx);
-        return -1;
+    // Reconnects, e.g. after a graceful server upgrade, resume the session
+    // from its ticket instead of repeating the full handshake
+    wolfSSL_CTX_set_timeout(g_ctx, TLS_SESSION_LIFETIME_SEC);
+#ifdef HAVE_SESSION_TICKET
+    wolfSSL_CTX_UseSessionTicket(g_ctx);
+#endif
+
+    // A malformed address is a configuration error, not an outage: refuse it
+    // here rather than retrying it forever
+    for (int i = 0; i < server_count; i++) {
+        upstream_t* upstream = &g_upstreams[i];
+        memset(upstream, 0, sizeof(*upstream));
+        upstream->sockfd = -1;
+
+        if (parse_upstream_address(servers[i], upstream) != 0) {
+            fprintf(stderr, "Invalid server address (expected <ipv4>[:port]): %s\n", servers[i]);
+            wolfSSL_CTX_free(g_ctx);
+            g_ctx = NULL;
+            return -1;
+        }
     }
 
-    // Configure server address
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(TLS_PORT);
-    
-    if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0) {
-        fprintf(stderr, "Invalid server IP address: %s\n", server_ip);
-        close(g_sockfd);
+    // Every upstream gets its source id now, reachable or not. The receiver
+    // loop connects them all (retry_at_ms 0 is due at once); one that is down,
+    // or boots after the client, is retried like one that dropped.
+    for (int i = 0; i < server_count; i++) {
+        upstream_t* upstream = &g_upstreams[g_upstream_count];
+        char source_name[80];
+        snprintf(source_name, sizeof(source_name), "%s:%d", upstream->host, upstream->port);
+        upstream->source_id = register_data_source(source_name);
+        g_upstream_count++;
+    }
+
+    if (g_upstream_count == 0) {
+        fprintf(stderr, "No TLS server address\n");
         wolfSSL_CTX_free(g_ctx);
+        g_ctx = NULL;
         return -1;
     }
 
-    // Connect to server
-    if (connect(g_sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("Connection to server failed");
-        close(g_sockfd);
-        wolfSSL_CTX_free(g_ctx);
+    // Start the shared receiver event loop
+    if (pthread_create(&g_receiver_thread, NULL, tls_data_receiver, NULL) != 0) {
+        fprintf(stderr, "Failed to create TLS receiver thread\n");
         return -1;
     }
 
-    printf("Connected to TLS server %s:%d\n", server_ip, TLS_PORT);
+    printf("TLS client initialized with %d upstream server(s), connecting in the background.\n",
+           g_upstream_count);
+    return 0;
+}
 
-    // Create SSL object
-    g_ssl = wolfSSL_new(g_ctx);
-    if (g_ssl == NULL) {
-        fprintf(stderr, "Error creating SSL object\n");
-        close(g_sockfd);
-        wolfSSL_CTX_free(g_ctx);
-        return -1;
+static void process_alarm(upstream_t* upstream, char* line, size_t length) {
+    alarm_frame_t alarm;
+
+    line[length - 1] = '\0';
+    if (frame_parse_alarm(line, &alarm) != 0) {
+        LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "Warning: Invalid alarm frame received: %s\n", line);
+        pthread_mutex_lock(&g_tls_stats_mutex);
+        g_tls_stats.frames_invalid++;
+        pthread_mutex_unlock(&g_tls_stats_mutex);
+        return;
     }
 
-    // Associate socket with SSL
-    wolfSSL_set_fd(g_ssl, g_sockfd);
+    // Only valid frames go downstream
+    line[length - 1] = '\n';
+    relay_forward_frame(line, length);
 
-    // Perform TLS handshake
-    ret = wolfSSL_connect(g_ssl);
-    if (ret != SSL_SUCCESS) {
-        int error = wolfSSL_get_error(g_ssl, ret);
-        char error_string[80];
-        wolfSSL_ERR_error_string(error, error_string);
-        fprintf(stderr, "TLS handshake failed: %s\n", error_string);
-        wolfSSL_free(g_ssl);
-        close(g_sockfd);
-        wolfSSL_CTX_free(g_ctx);
-        return -1;
+    LOG_WARN("[%s:%d] Alarm %s: channel %d at %.2f (limit %.2f)\n", upstream->host, upstream->port,
+             alarm.active ? "raised" : "cleared", alarm.channel, alarm.value, alarm.limit);
+
+    unsigned bit = 1u << alarm.channel;
+    int64_t latency_us = protocol_now_us() - alarm.origin_us;
+    pthread_mutex_lock(&g_tls_stats_mutex);
+    if (alarm.active && !(upstream->alarm_mask & bit)) {
+        upstream->alarm_mask |= bit;
+        g_tls_stats.alarms_active++;
+    } else if (!alarm.active && (upstream->alarm_mask & bit)) {
+        upstream->alarm_mask &= ~bit;
+        g_tls_stats.alarms_active--;
     }
+    g_tls_stats.alarms_received++;
+    g_tls_stats.alarm_latency_last_us = latency_us;
+    g_tls_stats.alarm_latency_total_us += latency_us;
+    if (latency_us > g_tls_stats.alarm_latency_max_us) {
+        g_tls_stats.alarm_latency_max_us = latency_us;
+    }
+    pthread_mutex_unlock(&g_tls_stats_mutex);
+}
 
-    printf("TLS handshake completed successfully!\n");
+// Data frames of one read, stored together once the read has been scanned
+typedef struct {
+    int count;
+    int64_t timestamp_ms[INGEST_BATCH];  // Origin time of each sample
+    double centrifuge_speed[INGEST_BATCH];
+    double power_output[INGEST_BATCH];
+    int64_t now_us;              // Receive time of the read
+    uint64_t frames;
+    uint64_t invalid;
+    uint64_t seq_gaps;
+    unsigned last_hops;
+    unsigned max_hops;
+    uint64_t latency_frames;
+    int64_t latency_last_us;
+    int64_t latency_total_us;
+    int64_t latency_max_us;
+} ingest_batch_t;
 
-    // Get server certificate information
-    WOLFSSL_X509* server_cert = wolfSSL_get_peer_certificate(g_ssl);
-    if (server_cert) {
-        char* subject = wolfSSL_X509_NAME_oneline(
-            wolfSSL_X509_get_subject_name(server_cert), 0, 0);
-        printf("Server certificate subject: %s\n", subject);
-        XFREE(subject, 0, DYNAMIC_TYPE_OPENSSL);
-        wolfSSL_X509_free(server_cert);
+// Store the batch with one call and fold its counters into the stats under one lock
+static void commit_batch(upstream_t* upstream, ingest_batch_t* batch) {
+    if (batch->count > 0) {
+        add_sensor_data_batch(upstream->source_id, batch->timestamp_ms, batch->centrifuge_speed,
+                              batch->power_output, batch->count);
+    }
+    if (batch->frames > 0 || batch->invalid > 0) {
+        pthread_mutex_lock(&g_tls_stats_mutex);
+        g_tls_stats.frames_invalid += batch->invalid;
+        if (batch->frames > 0) {
+            g_tls_stats.frames_received += batch->frames;
+            g_tls_stats.seq_gaps += batch->seq_gaps;
+            g_tls_stats.last_hops = batch->last_hops;
+            if (batch->max_hops > g_tls_stats.max_hops) {
+                g_tls_stats.max_hops = batch->max_hops;
+            }
+        }
+        if (batch->latency_frames > 0) {
+            g_tls_stats.latency_frames += batch->latency_frames;
+            g_tls_stats.latency_last_us = batch->latency_last_us;
+            g_tls_stats.latency_total_us += batch->latency_total_us;
+            if (batch->latency_max_us > g_tls_stats.latency_max_us) {
+                g_tls_stats.latency_max_us = batch->latency_max_us;
+            }
+        }
+        pthread_mutex_unlock(&g_tls_stats_mutex);
     }
+    batch->count = 0;
+    batch->frames = batch->invalid = batch->seq_gaps = 0;
+    batch->max_hops = 0;
+    batch->latency_frames = 0;
+    batch->latency_total_us = batch->latency_max_us = 0;
+}
 
-    // Display cipher suite information
-    printf("Cipher suite: %s\n", wolfSSL_get_cipher(g_ssl));
-    printf("Protocol version: %s\n", wolfSSL_get_version(g_ssl));
-    printf("\n");
+// Parse one data frame line (including its trailing newline) into the batch
+static void ingest_data_frame(upstream_t* upstream, ingest_batch_t* batch, char* line, size_t length) {
+    data_frame_t frame;
 
-    // Start data receiver thread
-    if (pthread_create(&g_receiver_thread, NULL, tls_data_receiver, NULL) != 0) {
-        fprintf(stderr, "Failed to create TLS receiver thread\n");
-        return -1;
+    line[length - 1] = '\0';
+    if (frame_parse_data(line, length - 1, &frame) != 0) {
+        LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "Warning: Invalid data format received: %s\n", line);
+        batch->invalid++;
+        return;
     }
 
-    printf("TLS client initialized and ready to receive data.\n");
-    return 0;
+    // Relays pass a frame that parsed on untouched apart from the hop counter,
+    // so a malformed upstream line never reaches the next tier
+    line[length - 1] = '\n';
+    relay_forward_frame(line, length);
+
+    // Samples are stored at the time the server took them, so a burst (or a
+    // backfill after a reconnect) keeps its spacing; frames without an origin
+    // time get the receive time of the read
+    batch->timestamp_ms[batch->count] = (frame.origin_us > 0 ? frame.origin_us : batch->now_us) / 1000;
+    batch->centrifuge_speed[batch->count] = frame.values[CHANNEL_CENTRIFUGE_SPEED];
+    batch->power_output[batch->count] = frame.values[CHANNEL_POWER_OUTPUT];
+    batch->count++;
+
+    // A decimated view skips sequence numbers by design, so gaps are only
+    // meaningful on the full stream. A lower number means a new stream.
+    if (!g_subscription && upstream->last_seq > 0 && frame.seq > upstream->last_seq + 1) {
+        batch->seq_gaps += frame.seq - upstream->last_seq - 1;
+    }
+    upstream->last_seq = frame.seq;
+
+    batch->frames++;
+    batch->last_hops = frame.hops;
+    if (frame.hops > batch->max_hops) {
+        batch->max_hops = frame.hops;
+    }
+    // Without an origin time there is nothing to measure latency against
+    if (frame.origin_us > 0) {
+        int64_t latency_us = batch->now_us - frame.origin_us;
+        batch->latency_frames++;
+        batch->latency_last_us = latency_us;
+        batch->latency_total_us += latency_us;
+        if (latency_us > batch->latency_max_us) {
+            batch->latency_max_us = latency_us;
+        }
+    }
+
+    if (batch->count == INGEST_BATCH) {
+        commit_batch(upstream, batch);
+    }
 }
 
-void* tls_data_receiver(void* arg) {
-    (void)arg; // Suppress unused parameter warning
-    char buffer[BUFFER_SIZE];
+// Handle one complete alarm or control frame (including its trailing newline)
+static void process_priority_frame(upstream_t* upstream, char* line, size_t length) {
+    if (line[0] == FRAME_TYPE_ALARM) {
+        process_alarm(upstream, line, length);
+        return;
+    }
+
+    // Control replies are meant for this hop only
+    unsigned long long backfill, lost;
+    line[length - 1] = '\0';
+    LOG_INFO("[%s:%d] Server reply: %s\n", upstream->host, upstream->port, line);
+    if (sscanf(line, "C,OK,RESUME,%llu,%llu", &backfill, &lost) == 2) {
+        pthread_mutex_lock(&g_tls_stats_mutex);
+        g_tls_stats.backfilled += backfill;
+        g_tls_stats.backfill_lost += lost;
+        pthread_mutex_unlock(&g_tls_stats_mutex);
+    }
+}
+
+// Process every complete frame in data and return the number of bytes used;
+// the trailing partial frame is left for the next read. The buffer is scanned
+// once: alarms and control replies are handled as they are found, data frames
+// are parsed in place and stored as one batch after the scan, so a backlog of
+// samples never delays an alarm from the same read.
+static size_t process_frames(upstream_t* upstream, char* data, size_t length) {
+    static ingest_batch_t batch;  // Only the receiver thread (or a replay) uses it
+    char* start = data;
+    char* end = data + length;
+    char* newline;
+
+    batch.now_us = protocol_now_us();
+    while ((newline = memchr(start, '\n', end - start)) != NULL) {
+        size_t frame_length = newline - start + 1;
+        if (frame_class(start) == FRAME_CLASS_PRIORITY) {
+            process_priority_frame(upstream, start, frame_length);
+        } else {
+            ingest_data_frame(upstream, &batch, start, frame_length);
+        }
+        start = newline + 1;
+    }
+    commit_batch(upstream, &batch);
+    return start - data;
+}
+
+// Run already received bytes through the receive path as if they came from an
+// upstream of the given source, without a TLS session (used by bench-client)
+size_t tls_client_ingest(int source, char* data, size_t length) {
+    static upstream_t replay = { .host = "replay", .sockfd = -1 };
+
+    replay.source_id = source;
+    return process_frames(&replay, data, length);
+}
+
+// Drain everything currently readable on one session.
+// Returns 0 while the session is healthy, -1 once it has been closed.
+static int receive_from_upstream(upstream_t* upstream) {
     int ret;
-    
-    while (g_client_running && g_ssl != NULL) {
-        memset(buffer, 0, BUFFER_SIZE);
-        ret = wolfSSL_read(g_ssl, buffer, BUFFER_SIZE - 1);
-        
+
+    for (;;) {
+        // A frame larger than the whole buffer can never complete; drop it
+        if (upstream->rx_len == sizeof(upstream->rx_buf)) {
+            LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "[%s:%d] Warning: oversized frame discarded\n",
+                            upstream->host, upstream->port);
+            upstream->rx_len = 0;
+        }
+
+        ret = wolfSSL_read(upstream->ssl, upstream->rx_buf + upstream->rx_len,
+                           (int)(sizeof(upstream->rx_buf) - upstream->rx_len));
+
         if (ret > 0) {
-            printf("Received TLS data: %s\n", buffer);
-            
-            // Parse the received data (format: "centrifuge_speed,power_output")
-            double centrifuge_speed, power_output;
-            if (sscanf(buffer, "%lf,%lf", &centrifuge_speed, &power_output) == 2) {
-                add_sensor_data(centrifuge_speed, power_output);
-            } else {
-                printf("Warning: Invalid data format received: %s\n", buffer);
-            }
+            LOG_RATELIMITED(LOG_LEVEL_DEBUG, 1000, "[%s:%d] Received TLS data: %.*s",
+                            upstream->host, upstream->port, ret, upstream->rx_buf + upstream->rx_len);
+            upstream->rx_len += ret;
+
+            // Process every complete frame and keep the trailing partial one
+            size_t used = process_frames(upstream, upstream->rx_buf, upstream->rx_len);
+            upstream->rx_len -= used;
+            memmove(upstream->rx_buf, upstream->rx_buf + used, upstream->rx_len);
         } else if (ret == 0) {
-            printf("TLS server disconnected\n");
-            g_client_running = 0;
-            break;
+            printf("[%s:%d] TLS server disconnected\n", upstream->host, upstream->port);
+            return -1;
         } else {
-            int error = wolfSSL_get_error(g_ssl, ret);
+            int error = wolfSSL_get_error(upstream->ssl, ret);
             if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
-                usleep(100000); // Sleep 100ms to avoid busy waiting
+                return 0;
+            }
+            printf("[%s:%d] TLS connection lost\n", upstream->host, upstream->port);
+            return -1;
+        }
+    }
+}
+
+static void fail_upstream(upstream_t* upstream) {
+    close_upstream(upstream);
+    schedule_reconnect(upstream);
+    printf("[%s:%d] Reconnecting in %d ms\n", upstream->host, upstream->port, upstream->retry_ms);
+}
+
+// Start the connects that are due and give up on those past their deadline
+static void retry_upstreams(void) {
+    int64_t now_ms = protocol_now_us() / 1000;
+
+    for (int i = 0; i < g_upstream_count; i++) {
+        upstream_t* upstream = &g_upstreams[i];
+        if (upstream->state == UPSTREAM_DOWN && now_ms >= upstream->retry_at_ms) {
+            if (start_connect(upstream) != 0) {
+                fail_upstream(upstream);
+            }
+        } else if ((upstream->state == UPSTREAM_CONNECTING || upstream->state == UPSTREAM_HANDSHAKE) &&
+                   now_ms >= upstream->deadline_ms) {
+            fprintf(stderr, "[%s:%d] %s timed out after %d s\n", upstream->host, upstream->port,
+                    upstream->state == UPSTREAM_CONNECTING ? "Connection" : "TLS handshake",
+                    CONNECT_TIMEOUT_SEC);
+            fail_upstream(upstream);
+        }
+    }
+}
+
+void* tls_data_receiver(void* arg) {
+    (void)arg; // Suppress unused parameter warning
+    struct pollfd fds[MAX_UPSTREAMS];
+    upstream_t* polled[MAX_UPSTREAMS];
+
+    rt_thread_setup("receiver", 1);
+
+    while (g_client_running) {
+        int nfds = 0;
+        int timeout_ms = 500;
+        int64_t now_ms = protocol_now_us() / 1000;
+
+        // Established sessions, connects and handshakes share one poll set, so
+        // an unreachable upstream never holds up the others
+        for (int i = 0; i < g_upstream_count; i++) {
+            upstream_t* upstream = &g_upstreams[i];
+            int64_t wake_ms;
+            if (upstream->state == UPSTREAM_DOWN) {
+                wake_ms = upstream->retry_at_ms;
+            } else {
+                fds[nfds].fd = upstream->sockfd;
+                fds[nfds].events = upstream->state == UPSTREAM_UP ? POLLIN : upstream->wait_events;
+                fds[nfds].revents = 0;
+                polled[nfds] = upstream;
+                nfds++;
+                if (upstream->state == UPSTREAM_UP) {
+                    continue;
+                }
+                wake_ms = upstream->deadline_ms;
+            }
+            if (wake_ms - now_ms < timeout_ms) {
+                timeout_ms = wake_ms > now_ms ? (int)(wake_ms - now_ms) : 0;
+            }
+        }
+
+        // Wake up periodically to notice shutdown requests, due reconnects and deadlines
+        int ready = poll(fds, nfds, timeout_ms);
+        if (ready < 0) {
+            if (errno == EINTR) {
                 continue;
             }
-            printf("TLS connection lost\n");
+            perror("TLS poll failed");
             g_client_running = 0;
             break;
         }
+
+        for (int i = 0; i < nfds && ready > 0; i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            ready--;
+            upstream_t* upstream = polled[i];
+            int failed;
+            if (upstream->state == UPSTREAM_UP) {
+                failed = receive_from_upstream(upstream);
+            } else {
+                failed = advance_connect(upstream);
+                // Records that arrived with the end of the handshake may already be buffered
+                if (failed == 0 && upstream->state == UPSTREAM_UP) {
+                    failed = receive_from_upstream(upstream);
+                }
+            }
+            if (failed != 0) {
+                fail_upstream(upstream);
+            }
+        }
+        retry_upstreams();
     }
-    
+
     pthread_exit(NULL);
 }
 
 void tls_client_cleanup(void) {
     printf("Cleaning up TLS client...\n");
-    
+
     // Wait for receiver thread to finish
     if (g_receiver_thread != 0) {
         printf("Waiting for TLS receiver thread to finish...\n");
         pthread_join(g_receiver_thread, NULL);
     }
-    
-    // Cleanup SSL
-    if (g_ssl) {
-        wolfSSL_shutdown(g_ssl);
-        wolfSSL_free(g_ssl);
-        g_ssl = NULL;
-    }
-    
-    // Close socket
-    if (g_sockfd >= 0) {
-        close(g_sockfd);
-        g_sockfd = -1;
+
+    // Cleanup SSL sessions and sockets
+    for (int i = 0; i < g_upstream_count; i++) {
+        close_upstream(&g_upstreams[i]);
+        if (g_upstreams[i].session) {
+            wolfSSL_SESSION_free(g_upstreams[i].session);
+            g_upstreams[i].session = NULL;
+        }
     }
-    
+    g_upstream_count = 0;
+
     // Cleanup SSL context
     if (g_ctx) {
         wolfSSL_CTX_free(g_ctx);
         g_ctx = NULL;
     }
-    
+
     wolfSSL_Cleanup();
     printf("TLS client cleanup completed.\n");
-}
\ No newline at end of file
+}
+
+void tls_client_get_stats(tls_stats_t* stats) {
+    pthread_mutex_lock(&g_tls_stats_mutex);
+    *stats = g_tls_stats;
+    pthread_mutex_unlock(&g_tls_stats_mutex);
+}
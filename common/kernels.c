@@ -0,0 +1,395 @@
+#include <math.h>
+#include <string.h>
+#include "kernels.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__riscv_vector)
+#define KERNELS_RVV 1
+#include <riscv_vector.h>
+#endif
+
+// Irwin-Hall: the sum of 12 uniforms on [0, 1) has mean 6 and variance 1.
+// Uniforms are built on [1, 2) from the top 52 random bits, hence the 12 + 6.
+#define NORMAL_UNIFORMS 12
+#define NORMAL_OFFSET 18.0
+#define DOUBLE_ONE_BITS 0x3FF0000000000000ULL
+
+typedef struct {
+    void (*stats)(kernel_stats_t* stats, const double* values, size_t n);
+    // Called with n a multiple of KERNEL_RNG_LANES
+    void (*normal)(kernel_rng_t* rng, double* out, size_t n, double mean, double stddev);
+} kernel_ops_t;
+
+// ---------------------------------------------------------------------------
+// Scalar reference
+
+static void stats_scalar(kernel_stats_t* stats, const double* values, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        double v = values[i];
+        if (isnan(v)) {
+            continue;
+        }
+        stats->count++;
+        stats->sum += v;
+        stats->sum_sq += v * v;
+        if (v < stats->min) {
+            stats->min = v;
+        }
+        if (v > stats->max) {
+            stats->max = v;
+        }
+    }
+}
+
+static inline uint64_t xorshift64(uint64_t x) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+}
+
+static void normal_scalar(kernel_rng_t* rng, double* out, size_t n, double mean, double stddev) {
+    for (size_t i = 0; i < n; i++) {
+        uint64_t s = rng->state[i % KERNEL_RNG_LANES];
+        double acc = 0.0;
+        for (int k = 0; k < NORMAL_UNIFORMS; k++) {
+            s = xorshift64(s);
+            uint64_t bits = (s >> 12) | DOUBLE_ONE_BITS;
+            double u;
+            memcpy(&u, &bits, sizeof(u));
+            acc = acc + u;
+        }
+        rng->state[i % KERNEL_RNG_LANES] = s;
+        out[i] = (acc - NORMAL_OFFSET) * stddev + mean;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// x86: SSE2 (always present on x86-64) and AVX2 (runtime detected)
+
+#ifdef KERNELS_X86
+
+static void stats_sse2(kernel_stats_t* stats, const double* values, size_t n) {
+    const __m128d inf = _mm_set1_pd(INFINITY);
+    const __m128d neg_inf = _mm_set1_pd(-INFINITY);
+    __m128d vmin = inf;
+    __m128d vmax = neg_inf;
+    __m128d vsum = _mm_setzero_pd();
+    __m128d vsq = _mm_setzero_pd();
+    __m128i vcount = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        __m128d v = _mm_loadu_pd(values + i);
+        __m128d ok = _mm_cmpord_pd(v, v);       // All ones where v is not NaN
+        __m128d vz = _mm_and_pd(ok, v);          // NaN lanes become 0
+        vsum = _mm_add_pd(vsum, vz);
+        vsq = _mm_add_pd(vsq, _mm_mul_pd(vz, vz));
+        vmin = _mm_min_pd(vmin, _mm_or_pd(vz, _mm_andnot_pd(ok, inf)));
+        vmax = _mm_max_pd(vmax, _mm_or_pd(vz, _mm_andnot_pd(ok, neg_inf)));
+        vcount = _mm_sub_epi64(vcount, _mm_castpd_si128(ok));
+    }
+
+    double lanes_min[2], lanes_max[2], lanes_sum[2], lanes_sq[2];
+    int64_t lanes_count[2];
+    _mm_storeu_pd(lanes_min, vmin);
+    _mm_storeu_pd(lanes_max, vmax);
+    _mm_storeu_pd(lanes_sum, vsum);
+    _mm_storeu_pd(lanes_sq, vsq);
+    _mm_storeu_si128((__m128i*)lanes_count, vcount);
+    for (int l = 0; l < 2; l++) {
+        stats->count += (uint64_t)lanes_count[l];
+        stats->sum += lanes_sum[l];
+        stats->sum_sq += lanes_sq[l];
+        if (lanes_min[l] < stats->min) {
+            stats->min = lanes_min[l];
+        }
+        if (lanes_max[l] > stats->max) {
+            stats->max = lanes_max[l];
+        }
+    }
+    stats_scalar(stats, values + i, n - i);
+}
+
+static inline __m128i xorshift64_sse2(__m128i s) {
+    s = _mm_xor_si128(s, _mm_slli_epi64(s, 13));
+    s = _mm_xor_si128(s, _mm_srli_epi64(s, 7));
+    return _mm_xor_si128(s, _mm_slli_epi64(s, 17));
+}
+
+static void normal_sse2(kernel_rng_t* rng, double* out, size_t n, double mean, double stddev) {
+    const __m128i one_bits = _mm_set1_epi64x((long long)DOUBLE_ONE_BITS);
+    const __m128d offset = _mm_set1_pd(NORMAL_OFFSET);
+    const __m128d vstddev = _mm_set1_pd(stddev);
+    const __m128d vmean = _mm_set1_pd(mean);
+    // Lanes 0-1 and 2-3 in two registers
+    __m128i s0 = _mm_loadu_si128((const __m128i*)&rng->state[0]);
+    __m128i s1 = _mm_loadu_si128((const __m128i*)&rng->state[2]);
+
+    for (size_t i = 0; i < n; i += KERNEL_RNG_LANES) {
+        __m128d acc0 = _mm_setzero_pd();
+        __m128d acc1 = _mm_setzero_pd();
+        for (int k = 0; k < NORMAL_UNIFORMS; k++) {
+            s0 = xorshift64_sse2(s0);
+            s1 = xorshift64_sse2(s1);
+            acc0 = _mm_add_pd(acc0, _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(s0, 12), one_bits)));
+            acc1 = _mm_add_pd(acc1, _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(s1, 12), one_bits)));
+        }
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(_mm_sub_pd(acc0, offset), vstddev), vmean));
+        _mm_storeu_pd(out + i + 2, _mm_add_pd(_mm_mul_pd(_mm_sub_pd(acc1, offset), vstddev), vmean));
+    }
+
+    _mm_storeu_si128((__m128i*)&rng->state[0], s0);
+    _mm_storeu_si128((__m128i*)&rng->state[2], s1);
+}
+
+__attribute__((target("avx2")))
+static void stats_avx2(kernel_stats_t* stats, const double* values, size_t n) {
+    const __m256d inf = _mm256_set1_pd(INFINITY);
+    const __m256d neg_inf = _mm256_set1_pd(-INFINITY);
+    __m256d vmin = inf;
+    __m256d vmax = neg_inf;
+    __m256d vsum = _mm256_setzero_pd();
+    __m256d vsq = _mm256_setzero_pd();
+    __m256i vcount = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_loadu_pd(values + i);
+        __m256d ok = _mm256_cmp_pd(v, v, _CMP_ORD_Q);
+        __m256d vz = _mm256_and_pd(ok, v);
+        vsum = _mm256_add_pd(vsum, vz);
+        vsq = _mm256_add_pd(vsq, _mm256_mul_pd(vz, vz));
+        vmin = _mm256_min_pd(vmin, _mm256_blendv_pd(inf, v, ok));
+        vmax = _mm256_max_pd(vmax, _mm256_blendv_pd(neg_inf, v, ok));
+        vcount = _mm256_sub_epi64(vcount, _mm256_castpd_si256(ok));
+    }
+
+    double lanes_min[4], lanes_max[4], lanes_sum[4], lanes_sq[4];
+    int64_t lanes_count[4];
+    _mm256_storeu_pd(lanes_min, vmin);
+    _mm256_storeu_pd(lanes_max, vmax);
+    _mm256_storeu_pd(lanes_sum, vsum);
+    _mm256_storeu_pd(lanes_sq, vsq);
+    _mm256_storeu_si256((__m256i*)lanes_count, vcount);
+    for (int l = 0; l < 4; l++) {
+        stats->count += (uint64_t)lanes_count[l];
+        stats->sum += lanes_sum[l];
+        stats->sum_sq += lanes_sq[l];
+        if (lanes_min[l] < stats->min) {
+            stats->min = lanes_min[l];
+        }
+        if (lanes_max[l] > stats->max) {
+            stats->max = lanes_max[l];
+        }
+    }
+    stats_scalar(stats, values + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void normal_avx2(kernel_rng_t* rng, double* out, size_t n, double mean, double stddev) {
+    const __m256i one_bits = _mm256_set1_epi64x((long long)DOUBLE_ONE_BITS);
+    const __m256d offset = _mm256_set1_pd(NORMAL_OFFSET);
+    const __m256d vstddev = _mm256_set1_pd(stddev);
+    const __m256d vmean = _mm256_set1_pd(mean);
+    __m256i s = _mm256_loadu_si256((const __m256i*)rng->state);
+
+    for (size_t i = 0; i < n; i += KERNEL_RNG_LANES) {
+        __m256d acc = _mm256_setzero_pd();
+        for (int k = 0; k < NORMAL_UNIFORMS; k++) {
+            s = _mm256_xor_si256(s, _mm256_slli_epi64(s, 13));
+            s = _mm256_xor_si256(s, _mm256_srli_epi64(s, 7));
+            s = _mm256_xor_si256(s, _mm256_slli_epi64(s, 17));
+            acc = _mm256_add_pd(acc, _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(s, 12), one_bits)));
+        }
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(acc, offset), vstddev), vmean));
+    }
+
+    _mm256_storeu_si256((__m256i*)rng->state, s);
+}
+
+#endif // KERNELS_X86
+
+// ---------------------------------------------------------------------------
+// RISC-V Vector 1.0
+
+#ifdef KERNELS_RVV
+
+static void stats_rvv(kernel_stats_t* stats, const double* values, size_t n) {
+    vfloat64m1_t rsum = __riscv_vfmv_v_f_f64m1(0.0, 1);
+    vfloat64m1_t rsq = __riscv_vfmv_v_f_f64m1(0.0, 1);
+    vfloat64m1_t rmin = __riscv_vfmv_v_f_f64m1(stats->min, 1);
+    vfloat64m1_t rmax = __riscv_vfmv_v_f_f64m1(stats->max, 1);
+    uint64_t count = 0;
+
+    // Strip-mined: vl covers the tail, and masked reductions skip NaN
+    for (size_t i = 0; i < n;) {
+        size_t vl = __riscv_vsetvl_e64m4(n - i);
+        vfloat64m4_t v = __riscv_vle64_v_f64m4(values + i, vl);
+        vbool16_t ok = __riscv_vmfeq_vv_f64m4_b16(v, v, vl);
+        rsum = __riscv_vfredusum_vs_f64m4_f64m1_m(ok, v, rsum, vl);
+        rsq = __riscv_vfredusum_vs_f64m4_f64m1_m(ok, __riscv_vfmul_vv_f64m4(v, v, vl), rsq, vl);
+        rmin = __riscv_vfredmin_vs_f64m4_f64m1_m(ok, v, rmin, vl);
+        rmax = __riscv_vfredmax_vs_f64m4_f64m1_m(ok, v, rmax, vl);
+        count += __riscv_vcpop_m_b16(ok, vl);
+        i += vl;
+    }
+
+    stats->count += count;
+    stats->sum += __riscv_vfmv_f_s_f64m1_f64(rsum);
+    stats->sum_sq += __riscv_vfmv_f_s_f64m1_f64(rsq);
+    stats->min = __riscv_vfmv_f_s_f64m1_f64(rmin);
+    stats->max = __riscv_vfmv_f_s_f64m1_f64(rmax);
+}
+
+static void normal_rvv(kernel_rng_t* rng, double* out, size_t n, double mean, double stddev) {
+    // LMUL=2 holds all four lanes at the minimum VLEN of 128
+    size_t vl = __riscv_vsetvl_e64m2(KERNEL_RNG_LANES);
+    if (vl < KERNEL_RNG_LANES) {
+        normal_scalar(rng, out, n, mean, stddev);
+        return;
+    }
+    vuint64m2_t s = __riscv_vle64_v_u64m2(rng->state, vl);
+
+    for (size_t i = 0; i < n; i += KERNEL_RNG_LANES) {
+        vfloat64m2_t acc = __riscv_vfmv_v_f_f64m2(0.0, vl);
+        for (int k = 0; k < NORMAL_UNIFORMS; k++) {
+            s = __riscv_vxor_vv_u64m2(s, __riscv_vsll_vx_u64m2(s, 13, vl), vl);
+            s = __riscv_vxor_vv_u64m2(s, __riscv_vsrl_vx_u64m2(s, 7, vl), vl);
+            s = __riscv_vxor_vv_u64m2(s, __riscv_vsll_vx_u64m2(s, 17, vl), vl);
+            vuint64m2_t bits = __riscv_vor_vx_u64m2(__riscv_vsrl_vx_u64m2(s, 12, vl), DOUBLE_ONE_BITS, vl);
+            acc = __riscv_vfadd_vv_f64m2(acc, __riscv_vreinterpret_v_u64m2_f64m2(bits), vl);
+        }
+        vfloat64m2_t z = __riscv_vfsub_vf_f64m2(acc, NORMAL_OFFSET, vl);
+        z = __riscv_vfadd_vf_f64m2(__riscv_vfmul_vf_f64m2(z, stddev, vl), mean, vl);
+        __riscv_vse64_v_f64m2(out + i, z, vl);
+    }
+
+    __riscv_vse64_v_u64m2(rng->state, s, vl);
+}
+
+#endif // KERNELS_RVV
+
+// ---------------------------------------------------------------------------
+// Dispatch
+
+static const kernel_ops_t g_kernel_ops[KERNEL_BACKEND_COUNT] = {
+    [KERNEL_BACKEND_SCALAR] = { stats_scalar, normal_scalar },
+#ifdef KERNELS_X86
+    [KERNEL_BACKEND_SSE2] = { stats_sse2, normal_sse2 },
+    [KERNEL_BACKEND_AVX2] = { stats_avx2, normal_avx2 },
+#endif
+#ifdef KERNELS_RVV
+    [KERNEL_BACKEND_RVV] = { stats_rvv, normal_rvv },
+#endif
+};
+
+static const char* g_kernel_backend_names[KERNEL_BACKEND_COUNT] = {
+    "scalar", "sse2", "avx2", "rvv"
+};
+
+static int g_kernel_backend = -1;
+
+int kernel_backend_supported(kernel_backend_t backend) {
+    if (backend < 0 || backend >= KERNEL_BACKEND_COUNT || !g_kernel_ops[backend].stats) {
+        return 0;
+    }
+#ifdef KERNELS_X86
+    if (backend == KERNEL_BACKEND_AVX2) {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    return 1;
+}
+
+kernel_backend_t kernel_get_backend(void) {
+    int backend = __atomic_load_n(&g_kernel_backend, __ATOMIC_RELAXED);
+
+    if (backend < 0) {
+        // Pick the widest supported backend; concurrent first calls agree
+        backend = KERNEL_BACKEND_SCALAR;
+        for (int b = KERNEL_BACKEND_COUNT - 1; b > KERNEL_BACKEND_SCALAR; b--) {
+            if (kernel_backend_supported((kernel_backend_t)b)) {
+                backend = b;
+                break;
+            }
+        }
+        __atomic_store_n(&g_kernel_backend, backend, __ATOMIC_RELAXED);
+    }
+    return (kernel_backend_t)backend;
+}
+
+int kernel_set_backend(kernel_backend_t backend) {
+    if (!kernel_backend_supported(backend)) {
+        return -1;
+    }
+    __atomic_store_n(&g_kernel_backend, (int)backend, __ATOMIC_RELAXED);
+    return 0;
+}
+
+const char* kernel_backend_name(kernel_backend_t backend) {
+    return (backend >= 0 && backend < KERNEL_BACKEND_COUNT) ? g_kernel_backend_names[backend] : "unknown";
+}
+
+void kernel_stats_init(kernel_stats_t* stats) {
+    stats->count = 0;
+    stats->min = INFINITY;
+    stats->max = -INFINITY;
+    stats->sum = 0.0;
+    stats->sum_sq = 0.0;
+}
+
+void kernel_stats_accumulate(kernel_stats_t* stats, const double* values, size_t n) {
+    g_kernel_ops[kernel_get_backend()].stats(stats, values, n);
+}
+
+double kernel_stats_mean(const kernel_stats_t* stats) {
+    return stats->count ? stats->sum / (double)stats->count : NAN;
+}
+
+double kernel_stats_variance(const kernel_stats_t* stats) {
+    if (stats->count == 0) {
+        return NAN;
+    }
+    double mean = stats->sum / (double)stats->count;
+    double variance = stats->sum_sq / (double)stats->count - mean * mean;
+    return variance > 0.0 ? variance : 0.0;
+}
+
+size_t kernel_rollup(const double* values, size_t n, size_t window, kernel_stats_t* out) {
+    size_t windows = 0;
+
+    if (window == 0) {
+        return 0;
+    }
+    for (size_t start = 0; start < n; start += window) {
+        size_t len = (n - start < window) ? n - start : window;
+        kernel_stats_init(&out[windows]);
+        kernel_stats_accumulate(&out[windows], values + start, len);
+        windows++;
+    }
+    return windows;
+}
+
+void kernel_rng_seed(kernel_rng_t* rng, uint64_t seed) {
+    // SplitMix64 spreads one seed over the lanes; xorshift needs a non-zero state
+    for (int i = 0; i < KERNEL_RNG_LANES; i++) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        rng->state[i] = z ? z : 1;
+    }
+}
+
+void kernel_normal_fill(kernel_rng_t* rng, double* out, size_t n, double mean, double stddev) {
+    size_t body = n - n % KERNEL_RNG_LANES;
+
+    g_kernel_ops[kernel_get_backend()].normal(rng, out, body, mean, stddev);
+    normal_scalar(rng, out + body, n - body, mean, stddev);
+}
@@ -0,0 +1,63 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 数值内核：窗口统计（最小/最大/均值/方差）、降采样汇总和正态分布随机数生成。
+//
+// 每个内核都有一个可移植的标量参考实现，另有以下向量实现：
+//   x86-64  SSE2（基线）和 AVX2（运行时检测 CPU 后选用）
+//   RISC-V  RVV 1.0（以 -march=rv64gcv 编译时选用，见 make riscv RISCV_MARCH=rv64gcv）
+//
+// 统计内核跳过 NaN（未订阅的通道以 NaN 存储）。向量实现的求和顺序与标量不同，
+// 结果只在舍入误差范围内一致；最小值、最大值、计数以及随机数序列与标量逐位相同。
+
+typedef enum {
+    KERNEL_BACKEND_SCALAR = 0,
+    KERNEL_BACKEND_SSE2,
+    KERNEL_BACKEND_AVX2,
+    KERNEL_BACKEND_RVV,
+    KERNEL_BACKEND_COUNT
+} kernel_backend_t;
+
+// Running statistics over the non-NaN values seen so far
+typedef struct {
+    uint64_t count;
+    double min;
+    double max;
+    double sum;
+    double sum_sq;
+} kernel_stats_t;
+
+// Independent xorshift64 generators, one per vector lane; output i of a fill
+// comes from lane i % KERNEL_RNG_LANES on every backend
+#define KERNEL_RNG_LANES 4
+
+typedef struct {
+    uint64_t state[KERNEL_RNG_LANES];
+} kernel_rng_t;
+
+void kernel_stats_init(kernel_stats_t* stats);
+void kernel_stats_accumulate(kernel_stats_t* stats, const double* values, size_t n);
+double kernel_stats_mean(const kernel_stats_t* stats);      // NaN if empty
+double kernel_stats_variance(const kernel_stats_t* stats);  // Population variance, NaN if empty
+
+// Summarise consecutive windows of `window` values (the last one may be
+// shorter); returns the number of windows written to out
+size_t kernel_rollup(const double* values, size_t n, size_t window, kernel_stats_t* out);
+
+void kernel_rng_seed(kernel_rng_t* rng, uint64_t seed);
+// Fill out with approximately normal samples (sum of 12 uniforms, so the
+// tails are cut at +/-6 standard deviations)
+void kernel_normal_fill(kernel_rng_t* rng, double* out, size_t n, double mean, double stddev);
+
+// Backend selection: the best supported backend is picked on first use;
+// kernel_set_backend() forces one (benchmarks, comparisons) and returns -1
+// if it is not available on this CPU or build
+kernel_backend_t kernel_get_backend(void);
+int kernel_set_backend(kernel_backend_t backend);
+int kernel_backend_supported(kernel_backend_t backend);
+const char* kernel_backend_name(kernel_backend_t backend);
+
+#endif // KERNELS_H
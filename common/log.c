@@ -0,0 +1,191 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "log.h"
+
+// 环形缓冲区容量（必须是 2 的幂）和单条消息长度上限
+#define LOG_RING_SIZE 1024
+#define LOG_RECORD_SIZE 240
+
+// Bounded multi-producer queue: each slot carries a sequence number that
+// tells producers and the consumer whose turn it is, so no lock is needed.
+typedef struct {
+    uint64_t seq;
+    int level;
+    char text[LOG_RECORD_SIZE];
+} log_record_t;
+
+volatile int g_log_level = LOG_LEVEL_INFO;
+
+static log_record_t g_ring[LOG_RING_SIZE];
+static uint64_t g_tail = 0;   // Next position claimed by producers
+static uint64_t g_head = 0;   // Next position read by the output thread
+static volatile int g_log_running = 0;
+static pthread_t g_log_thread;
+static log_stats_t g_log_stats;
+
+static const char* g_level_names[] = { "error", "warn", "info", "debug" };
+
+static int64_t log_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Write every queued record; returns the number written
+static int log_drain(void) {
+    int written = 0;
+
+    for (;;) {
+        log_record_t* record = &g_ring[g_head & (LOG_RING_SIZE - 1)];
+        if (__atomic_load_n(&record->seq, __ATOMIC_ACQUIRE) != g_head + 1) {
+            break;
+        }
+        fputs(record->text, record->level <= LOG_LEVEL_WARN ? stderr : stdout);
+        // Hand the slot back to producers for the next lap
+        __atomic_store_n(&record->seq, g_head + LOG_RING_SIZE, __ATOMIC_RELEASE);
+        g_head++;
+        written++;
+    }
+
+    if (written > 0) {
+        fflush(stdout);
+    }
+    return written;
+}
+
+static void* log_thread(void* arg) {
+    (void)arg;
+
+    while (g_log_running) {
+        if (log_drain() == 0) {
+            usleep(10000); // Sleep 10ms when idle
+        }
+    }
+    log_drain();
+
+    pthread_exit(NULL);
+}
+
+int log_init(log_level_t level) {
+    g_log_level = level;
+    for (uint64_t i = 0; i < LOG_RING_SIZE; i++) {
+        g_ring[i].seq = i;
+    }
+
+    g_log_running = 1;
+    if (pthread_create(&g_log_thread, NULL, log_thread, NULL) != 0) {
+        g_log_running = 0;
+        fprintf(stderr, "Failed to create log thread, logging synchronously\n");
+        return -1;
+    }
+    return 0;
+}
+
+void log_shutdown(void) {
+    if (!g_log_running) {
+        return;
+    }
+    g_log_running = 0;
+    pthread_join(g_log_thread, NULL);
+
+    if (g_log_stats.dropped > 0 || g_log_stats.suppressed > 0) {
+        printf("Log: %llu messages dropped, %llu rate-limited\n",
+               (unsigned long long)g_log_stats.dropped,
+               (unsigned long long)g_log_stats.suppressed);
+    }
+}
+
+int log_parse_level(const char* name) {
+    for (int i = LOG_LEVEL_ERROR; i <= LOG_LEVEL_DEBUG; i++) {
+        if (strcmp(name, g_level_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void log_get_stats(log_stats_t* stats) {
+    stats->written = __atomic_load_n(&g_log_stats.written, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&g_log_stats.dropped, __ATOMIC_RELAXED);
+    stats->suppressed = __atomic_load_n(&g_log_stats.suppressed, __ATOMIC_RELAXED);
+}
+
+void log_write(log_level_t level, log_site_t* site, const char* fmt, ...) {
+    uint32_t suppressed = 0;
+
+    // Per-site rate limit: only the caller that advances next_us may log
+    if (site->interval_us > 0) {
+        int64_t now_us = log_now_us();
+        int64_t next_us = __atomic_load_n(&site->next_us, __ATOMIC_RELAXED);
+        if (now_us < next_us ||
+            !__atomic_compare_exchange_n(&site->next_us, &next_us, now_us + site->interval_us,
+                                         0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            __atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&g_log_stats.suppressed, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+    }
+
+    va_list args;
+
+    // Without the output thread (start-up, tools) fall back to direct output
+    if (!g_log_running) {
+        FILE* out = level <= LOG_LEVEL_WARN ? stderr : stdout;
+        va_start(args, fmt);
+        vfprintf(out, fmt, args);
+        va_end(args);
+        return;
+    }
+
+    // Claim a slot
+    uint64_t pos = __atomic_load_n(&g_tail, __ATOMIC_RELAXED);
+    log_record_t* record;
+    for (;;) {
+        record = &g_ring[pos & (LOG_RING_SIZE - 1)];
+        uint64_t seq = __atomic_load_n(&record->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&g_tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Buffer full: drop rather than block the caller
+            __atomic_fetch_add(&g_log_stats.dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n(&g_tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    va_start(args, fmt);
+    int len = vsnprintf(record->text, LOG_RECORD_SIZE, fmt, args);
+    va_end(args);
+
+    if (len >= LOG_RECORD_SIZE) {
+        // Keep truncated messages newline-terminated
+        len = LOG_RECORD_SIZE - 1;
+        record->text[len - 1] = '\n';
+    }
+    if (suppressed > 0 && len > 0 && record->text[len - 1] == '\n') {
+        // Cut the message short if needed so the suffix and its newline always fit
+        char suffix[40];
+        int suffix_len = snprintf(suffix, sizeof(suffix), " (%u similar suppressed)\n", suppressed);
+        int at = len - 1;
+        if (at > LOG_RECORD_SIZE - 1 - suffix_len) {
+            at = LOG_RECORD_SIZE - 1 - suffix_len;
+        }
+        memcpy(record->text + at, suffix, suffix_len + 1);
+    }
+    record->level = level;
+
+    __atomic_fetch_add(&g_log_stats.written, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&record->seq, pos + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,52 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+
+// 异步日志：调用方把格式化好的消息写入无锁环形缓冲区，由后台线程输出，
+// 热路径上不再直接调用 stdio。每个日志调用点可以单独限速，
+// 被限速的消息只计数，下一条输出时附带被抑制的条数。
+
+typedef enum {
+    LOG_LEVEL_ERROR = 0,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG
+} log_level_t;
+
+// Per call-site state used for rate limiting; declared by the LOG_* macros
+typedef struct {
+    int64_t interval_us;   // Minimum spacing between messages, 0 = unlimited
+    int64_t next_us;       // Earliest time the next message may be emitted
+    uint32_t suppressed;   // Messages skipped since the last one emitted
+} log_site_t;
+
+typedef struct {
+    uint64_t written;      // Messages handed to the output thread
+    uint64_t dropped;      // Messages lost because the buffer was full
+    uint64_t suppressed;   // Messages skipped by rate limiting
+} log_stats_t;
+
+extern volatile int g_log_level;
+
+int log_init(log_level_t level);
+void log_shutdown(void);
+int log_parse_level(const char* name);
+void log_get_stats(log_stats_t* stats);
+void log_write(log_level_t level, log_site_t* site, const char* fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// Log at `level`, emitting at most one message per `interval_ms` from this call site
+#define LOG_RATELIMITED(level, interval_ms, ...) do { \
+        static log_site_t log_site_ = { (int64_t)(interval_ms) * 1000, 0, 0 }; \
+        if ((int)(level) <= g_log_level) { \
+            log_write((level), &log_site_, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_ERROR(...) LOG_RATELIMITED(LOG_LEVEL_ERROR, 0, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_RATELIMITED(LOG_LEVEL_WARN, 0, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_RATELIMITED(LOG_LEVEL_INFO, 0, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_RATELIMITED(LOG_LEVEL_DEBUG, 0, __VA_ARGS__)
+
+#endif // LOG_H
@@ -0,0 +1,203 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#ifdef BOUNDED_MEMORY
+#include <wolfssl/options.h>
+#include <wolfssl/wolfcrypt/memory.h>
+#endif
+#include "mempool.h"
+
+#define MEMPOOL_ALIGN 64
+
+typedef struct {
+    const char* name;
+    size_t bytes;
+    mempool_t* pool;           // NULL for reservations made outside a pool
+} memory_reservation_t;
+
+static memory_reservation_t g_reservations[MEMPOOL_MAX_RESERVATIONS];
+static int g_reservation_count = 0;
+static pthread_mutex_t g_reservation_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void add_reservation(const char* name, size_t bytes, mempool_t* pool) {
+    pthread_mutex_lock(&g_reservation_mutex);
+    if (g_reservation_count < MEMPOOL_MAX_RESERVATIONS) {
+        g_reservations[g_reservation_count].name = name;
+        g_reservations[g_reservation_count].bytes = bytes;
+        g_reservations[g_reservation_count].pool = pool;
+        g_reservation_count++;
+    }
+    pthread_mutex_unlock(&g_reservation_mutex);
+}
+
+int mempool_init(mempool_t* pool, const char* name, size_t block_size, int block_count) {
+    void* base = NULL;
+
+    memset(pool, 0, sizeof(*pool));
+    if (block_size < sizeof(void*)) {
+        block_size = sizeof(void*);
+    }
+    block_size = (block_size + MEMPOOL_ALIGN - 1) & ~(size_t)(MEMPOOL_ALIGN - 1);
+
+    if (block_count <= 0 || posix_memalign(&base, MEMPOOL_ALIGN, block_size * block_count) != 0) {
+        fprintf(stderr, "Failed to reserve memory pool '%s' (%d x %zu bytes)\n",
+                name, block_count, block_size);
+        return -1;
+    }
+    // Touch every block now so the pool is resident before the first request
+    memset(base, 0, block_size * block_count);
+
+    pool->name = name;
+    pool->block_size = block_size;
+    pool->block_count = block_count;
+    pool->base = base;
+    for (int i = block_count - 1; i >= 0; i--) {
+        void* block = pool->base + (size_t)i * block_size;
+        *(void**)block = pool->free_list;
+        pool->free_list = block;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+
+    add_reservation(name, block_size * block_count, pool);
+    return 0;
+}
+
+void* mempool_alloc(mempool_t* pool) {
+    void* block;
+
+    pthread_mutex_lock(&pool->mutex);
+    block = pool->free_list;
+    if (block) {
+        pool->free_list = *(void**)block;
+        if (++pool->in_use > pool->high_water) {
+            pool->high_water = pool->in_use;
+        }
+    } else {
+        pool->exhausted++;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return block;
+}
+
+void mempool_free(mempool_t* pool, void* block) {
+    if (!block) {
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    *(void**)block = pool->free_list;
+    pool->free_list = block;
+    pool->in_use--;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int mempool_in_use(mempool_t* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    int in_use = pool->in_use;
+    pthread_mutex_unlock(&pool->mutex);
+    return in_use;
+}
+
+void mempool_destroy(mempool_t* pool) {
+    pthread_mutex_lock(&g_reservation_mutex);
+    for (int i = 0; i < g_reservation_count; i++) {
+        if (g_reservations[i].pool == pool) {
+            g_reservations[i] = g_reservations[--g_reservation_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_reservation_mutex);
+
+    free(pool->base);
+    pthread_mutex_destroy(&pool->mutex);
+    memset(pool, 0, sizeof(*pool));
+}
+
+void memory_account(const char* name, size_t bytes) {
+    add_reservation(name, bytes, NULL);
+}
+
+void memory_report(void) {
+    size_t total = 0;
+
+    pthread_mutex_lock(&g_reservation_mutex);
+    printf("Memory budget:\n");
+    for (int i = 0; i < g_reservation_count; i++) {
+        memory_reservation_t* r = &g_reservations[i];
+        if (r->pool) {
+            printf("  %-20s %10zu bytes (%d x %zu)\n", r->name, r->bytes,
+                   r->pool->block_count, r->pool->block_size);
+        } else {
+            printf("  %-20s %10zu bytes\n", r->name, r->bytes);
+        }
+        total += r->bytes;
+    }
+    printf("  %-20s %10zu bytes\n", "total", total);
+    pthread_mutex_unlock(&g_reservation_mutex);
+}
+
+void memory_get_stats(memory_stats_t* stats) {
+    struct rusage usage;
+
+    memset(stats, 0, sizeof(*stats));
+    pthread_mutex_lock(&g_reservation_mutex);
+    for (int i = 0; i < g_reservation_count; i++) {
+        stats->reserved_bytes += g_reservations[i].bytes;
+        if (g_reservations[i].pool) {
+            stats->exhausted += __atomic_load_n(&g_reservations[i].pool->exhausted, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&g_reservation_mutex);
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        stats->peak_rss_bytes = (size_t)usage.ru_maxrss * 1024;
+    }
+}
+
+#ifdef BOUNDED_MEMORY
+
+#ifndef WOLFSSL_STATIC_MEMORY
+#error "BOUNDED_MEMORY requires wolfSSL built with --enable-staticmemory"
+#endif
+
+// General-purpose heap per session (handshake state, certificates, keys) and
+// for the context itself; the I/O pool holds one fixed input and one output
+// record buffer per session
+#define TLS_STATIC_GENERAL_PER_SESSION (96 * 1024)
+#define TLS_STATIC_GENERAL_CTX (128 * 1024)
+#define TLS_STATIC_IO_PER_SESSION (2 * (WOLFMEM_IO_SZ + MEMPOOL_ALIGN))
+
+WOLFSSL_CTX* tls_ctx_new_static(WOLFSSL_METHOD* (*method)(void* heap), int max_sessions, const char* name) {
+    WOLFSSL_CTX* ctx = NULL;
+    size_t general_size = TLS_STATIC_GENERAL_CTX + (size_t)max_sessions * TLS_STATIC_GENERAL_PER_SESSION;
+    size_t io_size = (size_t)max_sessions * TLS_STATIC_IO_PER_SESSION;
+    unsigned char* general = NULL;
+    unsigned char* io = NULL;
+
+    // Reserved for the life of the process: wolfSSL keeps using the buffers
+    // until the context is freed at shutdown
+    if (posix_memalign((void**)&general, MEMPOOL_ALIGN, general_size) != 0 ||
+        posix_memalign((void**)&io, MEMPOOL_ALIGN, io_size) != 0) {
+        fprintf(stderr, "Failed to reserve TLS static memory for %s\n", name);
+        free(general);
+        return NULL;
+    }
+    memset(general, 0, general_size);
+    memset(io, 0, io_size);
+
+    if (wolfSSL_CTX_load_static_memory(&ctx, method, general, (unsigned int)general_size,
+                                       WOLFMEM_GENERAL | WOLFMEM_TRACK_STATS, max_sessions) != WOLFSSL_SUCCESS ||
+        wolfSSL_CTX_load_static_memory(&ctx, NULL, io, (unsigned int)io_size,
+                                       WOLFMEM_IO_POOL_FIXED | WOLFMEM_TRACK_STATS, max_sessions) != WOLFSSL_SUCCESS) {
+        fprintf(stderr, "Failed to load TLS static memory for %s\n", name);
+        return NULL;
+    }
+
+    memory_account("tls static memory", general_size + io_size);
+    return ctx;
+}
+
+#endif // BOUNDED_MEMORY
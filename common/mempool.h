@@ -0,0 +1,58 @@
+#ifndef MEMPOOL_H
+#define MEMPOOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wolfssl/ssl.h>
+
+// 定长内存块池：启动时一次性分配全部内存块，运行时的分配和释放只操作空闲链表，
+// 不进入系统分配器。连接上下文、响应缓冲区等按用途各建一个池，池耗尽时调用方
+// 按过载处理（拒绝连接或返回 503），内存占用不会随负载增长。
+//
+// 所有启动时的预留（内存池、数据存储、wolfSSL 静态内存）都登记到同一张表，
+// 启动时打印，/api/stats 中报告总量和实际峰值 RSS。
+
+#define MEMPOOL_MAX_RESERVATIONS 16
+
+typedef struct {
+    const char* name;
+    size_t block_size;         // 按缓存行向上取整后的块大小
+    int block_count;
+    unsigned char* base;
+    void* free_list;           // 空闲块通过块内首个指针串成链表
+    int in_use;
+    int high_water;            // 同时使用的最大块数
+    uint64_t exhausted;        // 池耗尽导致的分配失败次数
+    pthread_mutex_t mutex;
+} mempool_t;
+
+typedef struct {
+    size_t reserved_bytes;     // 启动时预留的内存总量
+    size_t peak_rss_bytes;     // 进程实际峰值常驻内存
+    uint64_t exhausted;        // 所有池的分配失败次数之和
+} memory_stats_t;
+
+int mempool_init(mempool_t* pool, const char* name, size_t block_size, int block_count);
+void* mempool_alloc(mempool_t* pool);
+void mempool_free(mempool_t* pool, void* block);
+int mempool_in_use(mempool_t* pool);
+void mempool_destroy(mempool_t* pool);
+
+// Record a fixed startup reservation made outside a pool (e.g. the data store)
+void memory_account(const char* name, size_t bytes);
+void memory_report(void);
+void memory_get_stats(memory_stats_t* stats);
+
+// TLS contexts: in the bounded-memory build (make BOUNDED_MEMORY=1) wolfSSL
+// allocates from static buffers sized for max_sessions concurrent sessions
+// instead of the system heap. This requires wolfSSL built with
+// --enable-staticmemory.
+#ifdef BOUNDED_MEMORY
+WOLFSSL_CTX* tls_ctx_new_static(WOLFSSL_METHOD* (*method)(void* heap), int max_sessions, const char* name);
+#define TLS_CTX_NEW(method, max_sessions) tls_ctx_new_static(method##_ex, (max_sessions), #method)
+#else
+#define TLS_CTX_NEW(method, max_sessions) ((void)(max_sessions), wolfSSL_CTX_new(method()))
+#endif
+
+#endif // MEMPOOL_H
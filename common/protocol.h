@@ -0,0 +1,322 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 服务端与客户端（以及中继）之间的数据帧格式
+//
+// 每帧为一行文本，以 '\n' 结尾：
+//
+//   D,<hops>,<seq>,<origin_us>,<centrifuge_speed>,<power_output>\n
+//
+//   hops      - 固定两位十进制数，帧经过的中继数量；源服务器发送 00。
+//               字段位置和宽度固定，中继转发时原地递增，无需重新解析或序列化
+//   seq       - 源服务器分配的递增序号
+//   origin_us - 源服务器生成该帧时的 Unix 时间（微秒），用于端到端延迟统计
+//   各通道数值按通道编号排列；未订阅的通道字段为空
+//
+// 报警帧在通道数值越过报警限值（置位）或回落到限值以下（复位）时发送，不受订阅的通道和
+// 降采样限制：
+//
+//   A,<hops>,<seq>,<origin_us>,<channel>,<state>,<value>,<limit>\n
+//
+//   hops/origin_us 同数据帧，seq 为报警帧单独的递增序号
+//   channel   - 通道编号，state 为 1（置位）或 0（复位），value 为触发时的数值
+//
+// 帧分为两个优先级：报警帧和控制帧属于优先级通道，数据帧属于批量通道。每个连接的发送
+// 队列先发送优先级通道中的帧，它们不会排在已积压的数据帧之后；接收端也先处理优先级帧。
+//
+// 客户端可在同一TLS会话上发送订阅控制行（见 server.c）：
+//
+//   SUB <channels> [decim=<N>] [agg=last|mean|min|max] [rate=<Hz>]\n
+//
+//   channels  - "all" 或以逗号分隔的通道名/编号，如 "speed"、"0,1"
+//   decim     - 每 N 个采样输出一帧，期间的采样按 agg 聚合
+//   rate      - 输出帧率上限，超出部分继续聚合到下一帧
+//
+// 服务端以控制帧应答：C,OK,<view>\n 或 C,ERR,<reason>\n
+//
+// 现场采集端（producer）在同一个双向认证端口上推送成批的读数，身份为其证书主题：
+//
+//   P,<batch>;<origin_us>,<centrifuge_speed>,<power_output>[;<origin_us>,...]\n
+//
+//   batch     - 采集端分配的递增批次号，重发的批次只确认不重复写入
+//   origin_us - 采集时间（Unix 微秒），同一采集端内必须递增
+//   每批最多 BATCH_MAX_READINGS 条读数，通道字段可为空（未采集）
+//
+// 服务端按批应答：
+//   C,ACK,<batch>,<accepted>,<rejected>\n  已接收（rejected 为校验失败或迟到的读数）
+//   C,BUSY,<batch>,<retry_ms>\n            超出速率或队列已满，整批未接收，稍后重发
+//   C,ERR,<reason>\n                       格式错误或未被授权为采集端
+
+#define FRAME_MAX_SIZE 128
+#define FRAME_TYPE_DATA 'D'
+#define FRAME_TYPE_CONTROL 'C'
+#define FRAME_TYPE_BATCH 'P'
+#define FRAME_TYPE_ALARM 'A'
+#define BATCH_MAX_READINGS 16
+#define FRAME_HOPS_OFFSET 2
+#define FRAME_MAX_HOPS 99
+
+// TLS 会话的有效期：服务端和客户端都以此为会话超时，服务端的会话票据密钥也按此周期轮换
+// （上一把密钥仍可解密），因此连接时间不超过此值的客户端重连时可以用票据恢复会话
+#define TLS_SESSION_LIFETIME_SEC 86400
+
+// 数据通道
+#define CHANNEL_CENTRIFUGE_SPEED 0
+#define CHANNEL_POWER_OUTPUT 1
+#define CHANNEL_COUNT 2
+#define CHANNEL_MASK_ALL ((1u << CHANNEL_COUNT) - 1)
+
+// 发送与接收的优先级
+typedef enum {
+    FRAME_CLASS_PRIORITY = 0,  // Alarms and control replies
+    FRAME_CLASS_BULK,          // Telemetry samples
+    FRAME_CLASS_COUNT
+} frame_class_t;
+
+// 解析后的数据帧，未包含的通道为 NAN
+typedef struct {
+    unsigned hops;
+    uint64_t seq;
+    int64_t origin_us;
+    double values[CHANNEL_COUNT];
+} data_frame_t;
+
+// 解析后的报警帧
+typedef struct {
+    unsigned hops;
+    uint64_t seq;
+    int64_t origin_us;
+    int channel;
+    int active;
+    double value;
+    double limit;
+} alarm_frame_t;
+
+static inline frame_class_t frame_class(const char* frame) {
+    return (frame[0] == FRAME_TYPE_ALARM || frame[0] == FRAME_TYPE_CONTROL) ?
+           FRAME_CLASS_PRIORITY : FRAME_CLASS_BULK;
+}
+
+static inline int64_t protocol_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Encode a data frame as sent by the originating server (hops = 0), carrying
+// only the channels in channel_mask. Returns the frame length including the
+// trailing newline.
+static inline int frame_format_data(char* buf, size_t size, uint64_t seq, int64_t origin_us,
+                                    const double* values, unsigned channel_mask) {
+    int len = snprintf(buf, size, "%c,00,%llu,%lld", FRAME_TYPE_DATA,
+                       (unsigned long long)seq, (long long)origin_us);
+    for (int i = 0; i < CHANNEL_COUNT && len < (int)size; i++) {
+        if (channel_mask & (1u << i)) {
+            len += snprintf(buf + len, size - len, ",%.2f", values[i]);
+        } else {
+            len += snprintf(buf + len, size - len, ",");
+        }
+    }
+    if (len < (int)size) {
+        len += snprintf(buf + len, size - len, "\n");
+    }
+    return len;
+}
+
+// Encode an alarm frame as sent by the originating server (hops = 0)
+static inline int frame_format_alarm(char* buf, size_t size, uint64_t seq, int64_t origin_us,
+                                     int channel, int active, double value, double limit) {
+    return snprintf(buf, size, "%c,00,%llu,%lld,%d,%d,%.2f,%.2f\n", FRAME_TYPE_ALARM,
+                    (unsigned long long)seq, (long long)origin_us, channel, active ? 1 : 0,
+                    value, limit);
+}
+
+// Increment the hop counter of an encoded frame in place.
+// Returns the new hop count, or -1 if the frame is malformed or at FRAME_MAX_HOPS.
+static inline int frame_increment_hops(char* frame, size_t len) {
+    if (len < FRAME_HOPS_OFFSET + 3 || (frame[0] != FRAME_TYPE_DATA && frame[0] != FRAME_TYPE_ALARM) ||
+        frame[1] != ',' || frame[FRAME_HOPS_OFFSET + 2] != ',') {
+        return -1;
+    }
+    char* digits = frame + FRAME_HOPS_OFFSET;
+    if (digits[0] < '0' || digits[0] > '9' || digits[1] < '0' || digits[1] > '9') {
+        return -1;
+    }
+    int hops = (digits[0] - '0') * 10 + (digits[1] - '0');
+    if (hops >= FRAME_MAX_HOPS) {
+        return -1;
+    }
+    hops++;
+    digits[0] = (char)('0' + hops / 10);
+    digits[1] = (char)('0' + hops % 10);
+    return hops;
+}
+
+// Eight decimal digits at s as one word: 0 and the value in *value, or -1 if
+// any of them is not a digit. Neighbouring digits are combined into pairs,
+// pairs into quads and quads into the result with three multiplications.
+static inline int protocol_parse_8digits(const char* s, uint64_t* value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t chunk;
+
+    memcpy(&chunk, s, 8);
+    if (((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+         (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL) {
+        return -1;
+    }
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFULL;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFULL;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0xFFFFFFFFULL;
+    *value = chunk;
+    return 0;
+#else
+    (void)s;
+    (void)value;
+    return -1;
+#endif
+}
+
+// Unsigned decimal field at *p, which must not run past end; advances *p past
+// its digits. Returns 0 on success.
+static inline int protocol_parse_u64(const char** p, const char* end, uint64_t* value) {
+    const char* s = *p;
+    uint64_t v = 0;
+    uint64_t eight;
+    int digits = 0;
+
+    // Sequence numbers and microsecond timestamps are long: eight digits at a
+    // time while they last. At most 19 digits, which cannot overflow.
+    while (end - s >= 8 && digits <= 11 && protocol_parse_8digits(s, &eight) == 0) {
+        v = v * 100000000 + eight;
+        s += 8;
+        digits += 8;
+    }
+    while (*s >= '0' && *s <= '9' && digits < 19) {
+        v = v * 10 + (uint64_t)(*s++ - '0');
+        digits++;
+    }
+    if (digits == 0 || (*s >= '0' && *s <= '9')) {
+        return -1;
+    }
+    *value = v;
+    *p = s;
+    return 0;
+}
+
+// Channel value at *p, ending at ',' or the end of the line; advances *p past it.
+// Plain decimals as sent by the server ("61234.56") are converted directly: a
+// mantissa below 2^53 and a power of ten up to 1e22 are both exact doubles, so
+// one division gives the same correctly rounded result as strtod. Anything else
+// (exponents, nan, very long numbers) goes through strtod.
+static inline int protocol_parse_value(const char** p, double* value) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* s = *p;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int frac = -1;  // Digits after the decimal point, -1 before it
+    int negative = 0;
+
+    if (*s == '-' || *s == '+') {
+        negative = *s++ == '-';
+    }
+    for (;; s++) {
+        if (*s >= '0' && *s <= '9') {
+            mantissa = mantissa * 10 + (uint64_t)(*s - '0');
+            if (++digits > 19) {
+                break;
+            }
+            frac += frac >= 0;
+        } else if (*s == '.' && frac < 0) {
+            frac = 0;
+        } else {
+            break;
+        }
+    }
+    if (digits > 0 && digits <= 19 && (*s == ',' || *s == '\0') &&
+        mantissa < (1ULL << 53) && frac <= 22) {
+        double v = (double)mantissa;
+        if (frac > 0) {
+            v /= pow10[frac];
+        }
+        *value = negative ? -v : v;
+        *p = s;
+        return 0;
+    }
+
+    char* end;
+    *value = strtod(*p, &end);
+    if (end == *p) {
+        return -1;
+    }
+    *p = end;
+    return 0;
+}
+
+// Parse one frame line of the given length (without the trailing newline,
+// NUL-terminated). Returns 0 on success. The receiver parses every sample with
+// this, so it scans the line once in place instead of going through sscanf.
+static inline int frame_parse_data(const char* line, size_t length, data_frame_t* frame) {
+    const char* end = line + length;
+    const char* p = line + 2;
+    uint64_t hops;
+    uint64_t origin_us;
+    int negative;
+
+    if (length < 2 || line[0] != FRAME_TYPE_DATA || line[1] != ',' ||
+        protocol_parse_u64(&p, end, &hops) != 0 || p - line > FRAME_HOPS_OFFSET + 2 || *p++ != ',' ||
+        protocol_parse_u64(&p, end, &frame->seq) != 0 || *p++ != ',') {
+        return -1;
+    }
+    negative = *p == '-';
+    p += negative;
+    if (protocol_parse_u64(&p, end, &origin_us) != 0) {
+        return -1;
+    }
+    frame->hops = (unsigned)hops;
+    frame->origin_us = negative ? -(int64_t)origin_us : (int64_t)origin_us;
+
+    // Channel values; an empty field means the channel was not subscribed
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        if (*p++ != ',') {
+            return -1;
+        }
+        if (*p == ',' || *p == '\0') {
+            frame->values[i] = NAN;
+            continue;
+        }
+        if (protocol_parse_value(&p, &frame->values[i]) != 0) {
+            return -1;
+        }
+    }
+    return p == end ? 0 : -1;
+}
+
+// Parse one alarm frame line (without the trailing newline). Returns 0 on success.
+static inline int frame_parse_alarm(const char* line, alarm_frame_t* alarm) {
+    unsigned long long seq;
+    long long origin_us;
+    int consumed = 0;
+
+    if (line[0] != FRAME_TYPE_ALARM ||
+        sscanf(line + 1, ",%2u,%llu,%lld,%d,%d,%lf,%lf%n", &alarm->hops, &seq, &origin_us,
+               &alarm->channel, &alarm->active, &alarm->value, &alarm->limit, &consumed) != 7 ||
+        line[1 + consumed] != '\0' || alarm->channel < 0 || alarm->channel >= CHANNEL_COUNT) {
+        return -1;
+    }
+    alarm->seq = seq;
+    alarm->origin_us = origin_us;
+    return 0;
+}
+
+#endif // PROTOCOL_H
@@ -0,0 +1,176 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "log.h"
+#include "rt.h"
+
+// Upper bounds of the histogram buckets in microseconds; the last bucket is open
+static const int64_t g_bucket_us[RT_HISTOGRAM_BUCKETS - 1] = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000
+};
+
+static rt_config_t g_rt_config;
+
+static int64_t rt_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int bucket_of(int64_t ns) {
+    int b = 0;
+    while (b < RT_HISTOGRAM_BUCKETS - 1 && ns >= g_bucket_us[b] * 1000) {
+        b++;
+    }
+    return b;
+}
+
+// Parse "role=cpu[,role=cpu...]", e.g. "generator=2,merger=3"
+int rt_parse_cpus(rt_config_t* config, const char* spec) {
+    char buf[256];
+    char* saveptr = NULL;
+
+    if (strlen(spec) >= sizeof(buf)) {
+        return -1;
+    }
+    strcpy(buf, spec);
+
+    for (char* item = strtok_r(buf, ",", &saveptr); item; item = strtok_r(NULL, ",", &saveptr)) {
+        char* eq = strchr(item, '=');
+        char* end;
+        if (!eq || eq == item || (size_t)(eq - item) >= RT_ROLE_SIZE || config->pin_count == RT_MAX_PINS) {
+            return -1;
+        }
+        long cpu = strtol(eq + 1, &end, 10);
+        if (end == eq + 1 || *end != '\0' || cpu < 0 || cpu >= CPU_SETSIZE) {
+            return -1;
+        }
+        rt_pin_t* pin = &config->pins[config->pin_count++];
+        memcpy(pin->role, item, eq - item);
+        pin->role[eq - item] = '\0';
+        pin->cpu = (int)cpu;
+    }
+    return 0;
+}
+
+// Apply the process-wide settings and the "main" role to the calling thread.
+// Call before other threads start so they inherit its placement. Settings
+// the host refuses (no CAP_SYS_NICE / CAP_IPC_LOCK) are reported and skipped.
+int rt_init(const rt_config_t* config) {
+    g_rt_config = *config;
+
+    if (config->lock_memory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            perror("RT: mlockall failed, memory may be paged");
+        } else {
+            printf("RT: memory locked\n");
+        }
+    }
+    rt_thread_setup("main", 0);
+    return 0;
+}
+
+// Pin the calling thread to the CPU configured for its role and, for
+// time-critical threads, switch it to SCHED_FIFO
+void rt_thread_setup(const char* role, int realtime) {
+    for (int i = 0; i < g_rt_config.pin_count; i++) {
+        if (strcmp(g_rt_config.pins[i].role, role) != 0) {
+            continue;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(g_rt_config.pins[i].cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            fprintf(stderr, "RT: cannot pin %s to CPU %d: %s\n", role, g_rt_config.pins[i].cpu, strerror(err));
+        } else {
+            printf("RT: %s pinned to CPU %d\n", role, g_rt_config.pins[i].cpu);
+        }
+        break;
+    }
+
+    if (realtime && g_rt_config.fifo_priority > 0) {
+        struct sched_param param = { .sched_priority = g_rt_config.fifo_priority };
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            fprintf(stderr, "RT: cannot use SCHED_FIFO for %s: %s\n", role, strerror(err));
+        } else {
+            printf("RT: %s running SCHED_FIFO priority %d\n", role, g_rt_config.fifo_priority);
+        }
+    }
+}
+
+void rt_ticker_start(rt_ticker_t* ticker, int64_t period_ns) {
+    memset(ticker, 0, sizeof(*ticker));
+    ticker->period_ns = period_ns;
+    ticker->next_ns = rt_now_ns() + period_ns;
+}
+
+// Sleep until the next absolute deadline. If the previous period's work ran
+// past it, count a miss and skip to the next deadline still in the future
+// instead of firing a burst of late ticks.
+void rt_ticker_wait(rt_ticker_t* ticker) {
+    int64_t now_ns = rt_now_ns();
+
+    if (now_ns > ticker->next_ns) {
+        int64_t overrun_ns = now_ns - ticker->next_ns;
+        int64_t skip = overrun_ns / ticker->period_ns + 1;
+        ticker->misses++;
+        ticker->skipped += (uint64_t)skip;
+        ticker->overrun_hist[bucket_of(overrun_ns)]++;
+        ticker->next_ns += skip * ticker->period_ns;
+    }
+
+    struct timespec deadline = { (time_t)(ticker->next_ns / 1000000000), (long)(ticker->next_ns % 1000000000) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+
+    int64_t jitter_ns = rt_now_ns() - ticker->next_ns;
+    ticker->ticks++;
+    ticker->jitter_total_ns += jitter_ns;
+    if (jitter_ns > ticker->jitter_max_ns) {
+        ticker->jitter_max_ns = jitter_ns;
+    }
+    ticker->jitter_hist[bucket_of(jitter_ns)]++;
+    ticker->next_ns += ticker->period_ns;
+}
+
+static int format_histogram(char* out, size_t size, const uint64_t* hist) {
+    int len = 0;
+
+    for (int b = 0; b < RT_HISTOGRAM_BUCKETS && len < (int)size; b++) {
+        if (b < RT_HISTOGRAM_BUCKETS - 1) {
+            len += snprintf(out + len, size - len, " <%lld:%llu", (long long)g_bucket_us[b],
+                            (unsigned long long)hist[b]);
+        } else {
+            len += snprintf(out + len, size - len, " >=%lld:%llu", (long long)g_bucket_us[b - 1],
+                            (unsigned long long)hist[b]);
+        }
+    }
+    return len;
+}
+
+void rt_ticker_report(const rt_ticker_t* ticker, const char* name) {
+    char hist[160];
+
+    if (ticker->ticks == 0) {
+        return;
+    }
+    LOG_INFO("[RT %s] period=%lldus ticks=%llu misses=%llu skipped=%llu jitter avg=%.1fus max=%.1fus\n",
+             name, (long long)(ticker->period_ns / 1000), (unsigned long long)ticker->ticks,
+             (unsigned long long)ticker->misses, (unsigned long long)ticker->skipped,
+             ticker->jitter_total_ns / 1000.0 / ticker->ticks, ticker->jitter_max_ns / 1000.0);
+    format_histogram(hist, sizeof(hist), ticker->jitter_hist);
+    LOG_INFO("[RT %s] wake-up jitter us:%s\n", name, hist);
+    if (ticker->misses > 0) {
+        format_histogram(hist, sizeof(hist), ticker->overrun_hist);
+        LOG_INFO("[RT %s] deadline overrun us:%s\n", name, hist);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef RT_H
+#define RT_H
+
+#include <stdint.h>
+
+// 实时调度：周期性工作按绝对截止时间唤醒（clock_nanosleep + TIMER_ABSTIME），
+// 周期不随处理耗时漂移；可选把各线程绑定到指定 CPU、对时间敏感的线程使用
+// SCHED_FIFO、锁定全部内存。每个周期记录唤醒延迟（抖动）和超时（截止时间已过
+// 才开始等待）的直方图，定期写入日志，用于在有负载的主机上验证采样周期。
+//
+// 线程按角色配置，如服务端的 generator、merger，客户端的 receiver、http；
+// 未配置的角色沿用进程的 CPU 亲和性和调度策略。
+
+#define RT_MAX_PINS 16
+#define RT_ROLE_SIZE 16
+#define RT_HISTOGRAM_BUCKETS 10  // 边界见 rt.c，单位微秒
+
+typedef struct {
+    char role[RT_ROLE_SIZE];
+    int cpu;
+} rt_pin_t;
+
+typedef struct {
+    rt_pin_t pins[RT_MAX_PINS];
+    int pin_count;
+    int fifo_priority;         // 0 表示不使用 SCHED_FIFO
+    int lock_memory;           // mlockall(MCL_CURRENT | MCL_FUTURE)
+} rt_config_t;
+
+// 周期定时器；只由所属线程使用
+typedef struct {
+    int64_t period_ns;
+    int64_t next_ns;           // 下一个截止时间（CLOCK_MONOTONIC）
+    uint64_t ticks;
+    uint64_t misses;           // 上一周期的工作超过截止时间的次数
+    uint64_t skipped;          // 因超时跳过的周期数
+    int64_t jitter_total_ns;
+    int64_t jitter_max_ns;
+    uint64_t jitter_hist[RT_HISTOGRAM_BUCKETS];   // 唤醒时间晚于截止时间的分布
+    uint64_t overrun_hist[RT_HISTOGRAM_BUCKETS];  // 超时量的分布
+} rt_ticker_t;
+
+int rt_parse_cpus(rt_config_t* config, const char* spec);
+int rt_init(const rt_config_t* config);
+void rt_thread_setup(const char* role, int realtime);
+
+void rt_ticker_start(rt_ticker_t* ticker, int64_t period_ns);
+void rt_ticker_wait(rt_ticker_t* ticker);
+void rt_ticker_report(const rt_ticker_t* ticker, const char* name);
+
+#endif // RT_H
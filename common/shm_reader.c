@@ -0,0 +1,156 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "shm_reader.h"
+
+int shm_reader_open(shm_reader_t* reader, const char* name) {
+    char path[64];
+    struct stat st;
+
+    memset(reader, 0, sizeof(*reader));
+    snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+
+    // Read-write: waiting readers register themselves in the header's waiters count
+    int fd = shm_open(path, O_RDWR, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < SHM_RING_HEADER_SIZE) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    const shm_ring_header_t* header = (const shm_ring_header_t*)map;
+    // The writer stores the magic last, after the rest of the header
+    int valid = memcmp(header->magic, SHM_RING_MAGIC, 4) == 0;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (!valid || header->version != SHM_RING_VERSION || header->slot_size != sizeof(shm_ring_slot_t) ||
+        header->capacity == 0 || (header->capacity & (header->capacity - 1)) != 0 ||
+        (size_t)st.st_size < header->header_size + (size_t)header->capacity * sizeof(shm_ring_slot_t)) {
+        munmap(map, (size_t)st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+    // A client that is shutting down: wait for the next one to create a new ring
+    if (__atomic_load_n(&header->state, __ATOMIC_ACQUIRE) != SHM_RING_LIVE) {
+        munmap(map, (size_t)st.st_size);
+        errno = ENOENT;
+        return -1;
+    }
+
+    reader->header = header;
+    reader->slots = (const shm_ring_slot_t*)((const char*)map + header->header_size);
+    reader->map_size = (size_t)st.st_size;
+    reader->next = __atomic_load_n(&header->write_seq, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+void shm_reader_rewind(shm_reader_t* reader) {
+    uint64_t written = __atomic_load_n(&reader->header->write_seq, __ATOMIC_ACQUIRE);
+    reader->next = written > reader->header->capacity ? written - reader->header->capacity : 0;
+}
+
+static int writer_closed(const shm_reader_t* reader) {
+    return __atomic_load_n(&reader->header->state, __ATOMIC_ACQUIRE) != SHM_RING_LIVE;
+}
+
+int shm_reader_next(shm_reader_t* reader, shm_sample_t* sample) {
+    const shm_ring_header_t* header = reader->header;
+
+    for (;;) {
+        uint64_t written = __atomic_load_n(&header->write_seq, __ATOMIC_ACQUIRE);
+        if (reader->next >= written) {
+            return writer_closed(reader) ? -1 : 0;
+        }
+        // Fallen a whole ring behind: those samples are gone
+        if (written - reader->next > header->capacity) {
+            reader->lost += written - header->capacity - reader->next;
+            reader->next = written - header->capacity;
+        }
+
+        uint64_t n = reader->next;
+        const shm_ring_slot_t* slot = &reader->slots[n & (header->capacity - 1)];
+        uint64_t before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (before == 2 * n + 2) {
+            sample->seq = n;
+            sample->timestamp_ms = slot->timestamp_ms;
+            sample->publish_ns = slot->publish_ns;
+            sample->centrifuge_speed = slot->centrifuge_speed;
+            sample->power_output = slot->power_output;
+            sample->source = slot->source;
+            sample->anomaly = slot->anomaly;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == before) {
+                reader->next = n + 1;
+                return 1;
+            }
+        }
+        // Overwritten by a newer lap while we looked: count it and move on
+        reader->lost++;
+        reader->next = n + 1;
+    }
+}
+
+int shm_reader_wait(shm_reader_t* reader, int timeout_ms) {
+    shm_ring_header_t* header = (shm_ring_header_t*)reader->header;
+
+    for (;;) {
+        if (writer_closed(reader)) {
+            return -1;
+        }
+        uint32_t notify = __atomic_load_n(&header->notify, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&header->write_seq, __ATOMIC_ACQUIRE) > reader->next) {
+            return 1;
+        }
+
+        // Register as a waiter, then check once more so a publish between the
+        // check above and the wait cannot be missed
+        __atomic_add_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+        int ready = __atomic_load_n(&header->write_seq, __ATOMIC_SEQ_CST) > reader->next;
+        int ret = 0;
+        if (!ready) {
+            struct timespec timeout = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000 };
+            ret = (int)syscall(SYS_futex, &header->notify, FUTEX_WAIT, notify,
+                               timeout_ms < 0 ? NULL : &timeout, NULL, 0);
+        }
+        __atomic_sub_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+
+        if (ready) {
+            return 1;
+        }
+        if (ret != 0 && errno == ETIMEDOUT) {
+            return writer_closed(reader) ? -1 : 0;
+        }
+        // Woken, interrupted, or notify already moved on: look again
+    }
+}
+
+const char* shm_reader_source_name(const shm_reader_t* reader, unsigned source) {
+    uint32_t count = __atomic_load_n(&reader->header->source_count, __ATOMIC_ACQUIRE);
+    if (source >= count || source >= SHM_RING_SOURCES) {
+        return NULL;
+    }
+    return reader->header->source_names[source];
+}
+
+void shm_reader_close(shm_reader_t* reader) {
+    if (reader->header) {
+        munmap((void*)reader->header, reader->map_size);
+        reader->header = NULL;
+    }
+}
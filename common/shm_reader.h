@@ -0,0 +1,51 @@
+#ifndef SHM_READER_H
+#define SHM_READER_H
+
+#include <stdint.h>
+#include "shm_ring.h"
+
+// 共享内存环形缓冲区的读取库（make shm-lib 生成 libnppshm.a），供同一主机上的
+// 进程直接读取客户端发布的实时数据，不经过 HTTP。只依赖 libc，可单独链接：
+//
+//   shm_reader_t reader;
+//   shm_sample_t sample;
+//   if (shm_reader_open(&reader, "npp") != 0) { ... }
+//   while (shm_reader_wait(&reader, 1000) >= 0) {
+//       while (shm_reader_next(&reader, &sample) == 1) { ... }
+//   }
+//   shm_reader_close(&reader);
+//
+// 每个读者独立记录读取位置，互不影响，也不影响写者；读者落后超过环形缓冲区容量时
+// 丢失的数据点计入 lost。shm_reader_wait 返回 -1 表示客户端已退出，需要重新打开。
+
+typedef struct {
+    uint64_t seq;                // 发布序号，从 0 开始连续递增
+    int64_t timestamp_ms;        // 采集时间（Unix 毫秒），含义同 shm_ring_slot_t
+    int64_t publish_ns;          // 发布时的 CLOCK_MONOTONIC
+    double centrifuge_speed;     // 未订阅的通道为 NaN
+    double power_output;
+    unsigned source;
+    unsigned anomaly;            // 异常检测标记：通道 c 的第 0/1/2 位（c*3 起）为 z 分数/EWMA/CUSUM
+} shm_sample_t;
+
+typedef struct {
+    const shm_ring_header_t* header;
+    const shm_ring_slot_t* slots;
+    size_t map_size;
+    uint64_t next;               // 下一个要读取的序号
+    uint64_t lost;               // 被覆盖而未读到的数据点
+} shm_reader_t;
+
+// 打开 /dev/shm/<name>，从最新的数据点之后开始读取
+int shm_reader_open(shm_reader_t* reader, const char* name);
+// 改为从缓冲区中最旧的数据点开始读取
+void shm_reader_rewind(shm_reader_t* reader);
+// 读取下一个数据点：1 成功，0 暂无新数据，-1 客户端已退出
+int shm_reader_next(shm_reader_t* reader, shm_sample_t* sample);
+// 等待新数据：1 有新数据，0 超时，-1 客户端已退出；timeout_ms < 0 表示一直等待
+int shm_reader_wait(shm_reader_t* reader, int timeout_ms);
+// 来源名称（如 "192.168.1.100:8443"），未知时返回 NULL
+const char* shm_reader_source_name(const shm_reader_t* reader, unsigned source);
+void shm_reader_close(shm_reader_t* reader);
+
+#endif // SHM_READER_H
@@ -0,0 +1,71 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdint.h>
+
+// 本机共享内存环形缓冲区：客户端（--shm <name>）把每个数据点发布到 POSIX 共享内存
+// /dev/shm/<name>，同一主机上的读者（历史数据库、报警面板、控制逻辑）直接映射读取，
+// 不经过 HTTP，读者数量不影响客户端。读者使用 common/shm_reader.h 中的读取库。
+//
+// 布局（主机字节序，所有偏移都是 64 的倍数）：
+//
+//   偏移 0     shm_ring_header_t（SHM_RING_HEADER_SIZE 字节）
+//   偏移 SHM_RING_HEADER_SIZE
+//              shm_ring_slot_t[capacity]，capacity 为 2 的幂，每个槽占一个缓存行
+//
+// 写入协议（单写者，每个槽一个序列号）：发布第 n 个数据点（n 从 0 开始）时，
+//   1. 槽 n & (capacity - 1) 的 seq 写为 2n+1（写入中）
+//   2. 写入数据字段
+//   3. 槽的 seq 写为 2n+2（release），再把头部 write_seq 写为 n+1（release）
+//   4. notify 加一；有读者在等待（waiters > 0）时对 notify 调用 FUTEX_WAKE
+// 同一次接收的多个数据点成批发布：逐个完成各槽的 1、2 步，第 3 步的 write_seq 和
+// 第 4 步的唤醒每批只做一次。
+//
+// 读取协议：读者记录下一个要读的序号 n。读取槽的 seq（acquire），等于 2n+2 时复制
+// 数据，再次读取 seq，两次相同则数据有效；seq 大于 2n+2 说明读者落后超过 capacity，
+// 数据已被覆盖，应跳到 write_seq - capacity 继续。没有新数据时，读者在 waiters 上
+// 加一后对 notify 执行 FUTEX_WAIT（非私有 futex，跨进程有效）。
+//
+// 客户端退出时把 state 置为 SHM_RING_CLOSED 并唤醒所有读者；重新启动的客户端
+// 会创建新的映射，读者看到 CLOSED 后应重新打开。
+
+#define SHM_RING_MAGIC "NPPS"
+#define SHM_RING_VERSION 1
+#define SHM_RING_HEADER_SIZE 1024
+#define SHM_RING_SOURCES 8
+#define SHM_RING_SOURCE_NAME_SIZE 80
+#define SHM_RING_LIVE 1
+#define SHM_RING_CLOSED 2
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t header_size;        // SHM_RING_HEADER_SIZE
+    uint32_t slot_size;          // sizeof(shm_ring_slot_t)
+    uint32_t capacity;           // 槽数，2 的幂
+    uint32_t state;              // SHM_RING_LIVE / SHM_RING_CLOSED
+    int32_t writer_pid;
+    uint32_t source_count;       // 先写名称再增加计数
+    char source_names[SHM_RING_SOURCES][SHM_RING_SOURCE_NAME_SIZE];
+    // 写者频繁更新的字段各占一个缓存行，与只读字段分开
+    uint64_t write_seq __attribute__((aligned(64)));  // 已发布的数据点数
+    uint32_t notify __attribute__((aligned(64)));     // futex 字
+    uint32_t waiters;            // 正在等待的读者数
+} shm_ring_header_t;
+
+typedef struct {
+    uint64_t seq;                // 2n+1 写入中，2n+2 第 n 个数据点已完成
+    int64_t timestamp_ms;        // 服务端采集数据点的 Unix 时间（毫秒，取自帧中的 origin_us），
+                                 // 补发的数据点可能早于已发布的数据点；帧未带采集时间时为客户端收到的时间
+    int64_t publish_ns;          // 发布时的 CLOCK_MONOTONIC，用于测量读取延迟
+    double centrifuge_speed;     // 未订阅的通道为 NaN
+    double power_output;
+    uint32_t source;             // 来源编号，名称见 source_names
+    uint32_t anomaly;            // 客户端异常检测的标记，每个通道 3 位（z 分数、EWMA、CUSUM）
+    uint32_t reserved[2];
+} __attribute__((aligned(64))) shm_ring_slot_t;
+
+_Static_assert(sizeof(shm_ring_header_t) <= SHM_RING_HEADER_SIZE, "shm ring header too large");
+_Static_assert(sizeof(shm_ring_slot_t) == 64, "shm ring slot must be one cache line");
+
+#endif // SHM_RING_H
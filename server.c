@@ -1,21 +1,70 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <errno.h>
 #include <signal.h>
 #include <math.h>
 #include <time.h>
+#include <sys/random.h>
+#include <wolfssl/options.h>
 #include <wolfssl/ssl.h>
 #include <wolfssl/error-ssl.h>
+#ifdef HAVE_SESSION_TICKET
+#include <wolfssl/wolfcrypt/chacha20_poly1305.h>
+#endif
+#include "kernels.h"
+#include "log.h"
+#include "mempool.h"
+#include "protocol.h"
+#include "rt.h"
 
 #define PORT 8443
 #define BUFFER_SIZE 1024
 #define MAX_CLIENTS 10
 
+// Producer ingestion
+#define MAX_PRODUCERS MAX_CLIENTS
+#define PRODUCER_SUBJECT_SIZE 256
+#define PRODUCER_RATE_LIMIT 200.0    // Sustained readings per second per producer
+#define PRODUCER_BURST 64.0          // Readings a producer may send at once
+#define PRODUCER_REPORT_SEC 10       // Interval of the per-producer rate log
+#define INGEST_QUEUE_SIZE 4096       // Readings waiting to be merged
+#define INGEST_REORDER_MS 100        // Default wait for late readings from other producers
+#define INGEST_MAX_FUTURE_US 2000000 // Readings further ahead of our clock are rejected
+#define INGEST_EMIT_BATCH 64
+#define SEND_QUEUE_FRAMES 64         // Frames queued per connection and priority class
+#define SEND_BULK_BURST 16           // Bulk frames per write, so alarms wait at most one burst
+#define SEND_TIMEOUT_SEC 5           // A consumer that stops reading is disconnected
+#define ALARM_SPEED_HIGH 63500.0     // Default high limit of the centrifuge speed (RPM)
+#define ALARM_POWER_HIGH 1180.0      // Default high limit of the power output (MW)
+#define ALARM_HYSTERESIS 0.01        // An alarm clears 1% below its limit
+#define GENERATOR_PERIOD_MS 2000     // Default sampling period of the built-in generator
+#define RT_REPORT_SEC 10             // Interval of the generator tick jitter report
+#define HANDSHAKE_WORKERS 2          // Default size of the TLS handshake pool
+#define HANDSHAKE_MAX_WORKERS 16
+#define HANDSHAKE_PENDING 8          // Accepted connections waiting for a handshake worker
+#define HANDSHAKE_TIMEOUT_SEC 5      // A peer that stalls mid-handshake is dropped
+#define ACCEPT_RATE 20.0             // Default sustained new connections per second
+#define ACCEPT_BURST 10.0            // New connections admitted at once after a quiet period
+#define ACCEPT_BACKLOG 128           // Large enough that a connect storm is rejected, not left in SYN retries
+#define HISTORY_SIZE 4096            // Broadcast samples kept for RESUME backfill
+#define DRAIN_MS 2000                // Default time over which an upgraded server disconnects its clients
+#define UPGRADE_ACK_TIMEOUT_SEC 10   // Wait for the new process to confirm it is serving
+#define UPGRADE_MAGIC "NPUP"
+#define UPGRADE_VERSION 2
+#define TICKET_NAME_SIZE 16          // wolfSSL's WOLFSSL_TICKET_NAME_SZ
+#define TICKET_KEY_SIZE 32           // ChaCha20-Poly1305 key
+
 // Certificate and key file paths
 #define SERVER_CERT "certs/server-cert.pem"
 #define SERVER_KEY "certs/server-key.pem"
@@ -32,6 +81,96 @@ static double g_data1 = 0.0;  // 50000-70000 range
 static double g_data2 = 0.0;  // 800-1200 range
 static pthread_mutex_t g_data_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_t g_data_thread;
+static int g_generator_enabled = 1;
+static int g_generator_period_ms = GENERATOR_PERIOD_MS;
+static uint64_t g_frame_seq = 0;  // Sequence number of the last broadcast frame
+
+// Producer accounting, keyed by certificate subject; an entry outlives its
+// connections so counters and rate limits survive reconnects
+typedef struct {
+    char subject[PRODUCER_SUBJECT_SIZE];
+    int connections;
+    double tokens;             // Token bucket refilled at PRODUCER_RATE_LIMIT
+    int64_t refill_us;
+    int64_t last_origin_us;    // Readings must advance per producer
+    uint64_t last_batch;
+    uint64_t batches;
+    uint64_t accepted;
+    uint64_t rejected;         // Invalid, out of order or too far in the future
+    uint64_t late;             // Arrived after newer readings had been broadcast
+    uint64_t throttled;        // Batches answered with BUSY
+    uint64_t reported;         // accepted at the last rate report
+} producer_t;
+
+// Readings from all producers (and the built-in generator) are merged by
+// origin time: each waits in a min-heap for the reorder window, then a single
+// merger thread broadcasts them, so subscribers see one ordered stream
+typedef struct {
+    int64_t origin_us;
+    uint64_t order;            // Arrival order, breaks ties between equal times
+    double values[CHANNEL_COUNT];
+} ingest_reading_t;
+
+static producer_t g_producers[MAX_PRODUCERS];
+static int g_producer_count = 0;
+static const char* g_allowed_producers[MAX_PRODUCERS];  // Empty: nobody, unless allow-any
+static int g_allowed_producer_count = 0;
+static int g_allow_any_producer = 0;  // --allow-any-producer: every authenticated peer may push
+static ingest_reading_t g_ingest_heap[INGEST_QUEUE_SIZE];
+static int g_ingest_count = 0;
+static uint64_t g_ingest_order = 0;
+static uint64_t g_ingest_dropped = 0;   // Generator samples lost to a full queue
+static int64_t g_ingest_emitted_us = 0; // Origin of the newest broadcast reading
+static int64_t g_reorder_us = (int64_t)INGEST_REORDER_MS * 1000;
+static pthread_mutex_t g_ingest_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_ingest_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t g_merge_thread;
+static int g_ingest_paused = 0;         // Upgrade in progress: accept nothing, flush the queue
+static int g_merger_busy = 0;           // Merger is broadcasting readings it has popped
+
+// Bounded send queue of one priority class on one connection
+typedef struct {
+    char frames[SEND_QUEUE_FRAMES][FRAME_MAX_SIZE];
+    int lengths[SEND_QUEUE_FRAMES];
+    int64_t enqueued_us[SEND_QUEUE_FRAMES];
+    int head;
+    int count;
+} send_lane_t;
+
+// Per-class delivery statistics, from enqueue to the completed write
+typedef struct {
+    uint64_t sent;
+    uint64_t dropped;            // Overwritten in a full lane
+    int64_t latency_total_us;
+    int64_t latency_max_us;
+    uint64_t reported;           // sent at the last report
+} lane_stats_t;
+
+typedef enum {
+    AGG_LAST = 0,
+    AGG_MEAN,
+    AGG_MIN,
+    AGG_MAX
+} aggregation_t;
+
+static const char* g_aggregation_names[] = { "last", "mean", "min", "max" };
+
+// Subscription view: one distinct (channels, decimation, aggregation, rate)
+// combination. Each view is advanced and encoded once per sample, and the
+// resulting frame is shared by every client subscribed to it.
+typedef struct {
+    int refcount;              // Clients using this view; 0 means the slot is free
+    unsigned channel_mask;
+    int decimation;
+    aggregation_t aggregation;
+    int64_t min_interval_us;   // From the requested maximum rate, 0 = unlimited
+    int pending;               // Samples accumulated since the last emitted frame
+    double acc[CHANNEL_COUNT];
+    int64_t last_emit_us;
+    int due;                   // Set when frame holds a frame for this sample
+    char frame[FRAME_MAX_SIZE];
+    int frame_len;
+} subscription_view_t;
 
 // Client connection structure
 typedef struct {
@@ -39,50 +178,321 @@ typedef struct {
     struct sockaddr_in addr;
     int client_id;
     WOLFSSL* ssl;
+    int view;  // Index into g_views of the client's subscription view
+    int producer;  // Index into g_producers once the peer has pushed a batch, else -1
+    char subject[PRODUCER_SUBJECT_SIZE];
+    // Everything sent to the client goes through these lanes and a sender
+    // thread, priority lane first; guarded by g_clients_mutex
+    send_lane_t lanes[FRAME_CLASS_COUNT];
+    pthread_cond_t send_cond;
+    pthread_t sender;
+    int closing;
+    int64_t accepted_us;  // When the connection was admitted to the handshake queue
+    // Backfill after RESUME: history samples are fed through a private copy of
+    // the client's view, and live frames are withheld until the replay reaches them
+    int replaying;
+    uint64_t replay_next;
+    uint64_t replay_sent;
+    uint64_t replay_lost;
+    subscription_view_t replay_view;
+    int drained;          // Already disconnected by an upgrade drain
 } client_info_t;
 
+// Recently broadcast samples, indexed by seq % HISTORY_SIZE; g_clients_mutex
+typedef struct {
+    uint64_t seq;
+    int64_t origin_us;
+    double values[CHANNEL_COUNT];
+} history_entry_t;
+
+// Session ticket key. Tickets are sealed under keys the server owns rather
+// than wolfSSL's per-process default, so an upgrade can pass them on and
+// clients drained from the old process resume their sessions with the new one
+typedef struct {
+    unsigned char name[TICKET_NAME_SIZE];
+    unsigned char key[TICKET_KEY_SIZE];
+} ticket_key_t;
+
+// State handed to the new process on a graceful upgrade, followed on the
+// Unix socket by history_count history_entry_t records, oldest first
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t frame_seq;
+    uint64_t alarm_seq;
+    int64_t ingest_emitted_us;
+    int32_t alarm_active[CHANNEL_COUNT];
+    uint32_t history_count;
+    ticket_key_t ticket_keys[2];     // Current, then previous
+    int64_t ticket_rotate_at_ms;
+} upgrade_state_t;
+
+// Connection admission: the accept loop only applies the rate limit and the
+// queue bound, then hands the connection to a fixed pool of handshake workers,
+// so a reconnect storm costs at most HANDSHAKE_MAX_WORKERS concurrent handshakes
+// and never delays the threads that stream to established clients
+typedef struct {
+    uint64_t admitted;
+    uint64_t rate_limited;       // Rejected by the accept token bucket
+    uint64_t queue_full;         // Rejected because HANDSHAKE_PENDING were waiting
+    uint64_t server_full;        // Rejected because MAX_CLIENTS were connected
+    uint64_t completed;
+    uint64_t resumed;            // Completed by resuming a session from a ticket
+    uint64_t failed;             // Handshake error or timeout
+    int64_t wait_total_us;       // Time completed handshakes spent in the queue
+    int64_t handshake_total_us;
+    int64_t handshake_max_us;
+    uint64_t reported;           // admitted + rejected at the last report
+} admission_stats_t;
+
+// Connection contexts come from a pool reserved at startup
+static mempool_t g_client_pool;
+
 // Client list for broadcasting
 static client_info_t* g_clients[MAX_CLIENTS];
 static pthread_mutex_t g_clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+static lane_stats_t g_lane_stats[FRAME_CLASS_COUNT];
+
+static history_entry_t g_history[HISTORY_SIZE];
+
+static client_info_t* g_pending[HANDSHAKE_PENDING];
+static int g_pending_head = 0;
+static int g_pending_count = 0;
+static int g_handshake_workers = HANDSHAKE_WORKERS;
+static pthread_t g_handshake_threads[HANDSHAKE_MAX_WORKERS];
+static admission_stats_t g_admission;
+static pthread_mutex_t g_handshake_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static ticket_key_t g_ticket_keys[2];    // Current, then previous
+static int64_t g_ticket_rotate_at_ms;    // Unix time of the next rotation
+static pthread_mutex_t g_ticket_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_handshake_cond = PTHREAD_COND_INITIALIZER;
+static double g_accept_rate = ACCEPT_RATE;     // 0: no rate limit
+static double g_accept_burst = ACCEPT_BURST;
+static const char* g_upgrade_path = NULL;      // Unix socket offering the listening socket to a successor
+static int g_drain_ms = DRAIN_MS;
+static const char* g_lane_names[FRAME_CLASS_COUNT] = { "priority", "bulk" };
+
+// Alarm limits per channel; the state is only touched by the merger thread
+static double g_alarm_limits[CHANNEL_COUNT] = { ALARM_SPEED_HIGH, ALARM_POWER_HIGH };
+static int g_alarm_active[CHANNEL_COUNT];
+static uint64_t g_alarm_seq = 0;
+
+// Aggregation applied to the samples folded into one decimated frame
+// A client holds exactly one view, so MAX_CLIENTS slots always suffice
+static subscription_view_t g_views[MAX_CLIENTS];
 
 // Function declarations
-void broadcast_data_to_clients(double data1, double data2);
+void broadcast_sample(const double* values, int64_t origin_us);
 void* data_generator(void* arg);
+void* ingest_merger(void* arg);
 void* handle_client(void* arg);
+void* client_sender(void* arg);
+void* handshake_worker(void* arg);
 void signal_handler(int sig);
-double generate_normal(double mean, double stddev);
 
-// Generate normal distribution random number using Box-Muller transform
-double generate_normal(double mean, double stddev) {
-    static int has_spare = 0;
-    static double spare;
-    
-    if (has_spare) {
-        has_spare = 0;
-        return spare * stddev + mean;
+// Samples are generated in batches by the vectorised normal kernel and
+// consumed one per broadcast tick
+#define GENERATOR_BATCH 64
+
+// Heap of pending readings ordered by (origin_us, order); g_ingest_mutex held
+static int reading_before(const ingest_reading_t* a, const ingest_reading_t* b) {
+    return a->origin_us < b->origin_us || (a->origin_us == b->origin_us && a->order < b->order);
+}
+
+static void ingest_push(const ingest_reading_t* reading) {
+    int i = g_ingest_count++;
+
+    g_ingest_heap[i] = *reading;
+    g_ingest_heap[i].order = ++g_ingest_order;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!reading_before(&g_ingest_heap[i], &g_ingest_heap[parent])) {
+            break;
+        }
+        ingest_reading_t tmp = g_ingest_heap[i];
+        g_ingest_heap[i] = g_ingest_heap[parent];
+        g_ingest_heap[parent] = tmp;
+        i = parent;
     }
-    
-    has_spare = 1;
-    static double u, v, mag;
-    do {
-        u = (double)rand() / RAND_MAX * 2.0 - 1.0;
-        v = (double)rand() / RAND_MAX * 2.0 - 1.0;
-        mag = u * u + v * v;
-    } while (mag >= 1.0 || mag == 0.0);
-    
-    mag = sqrt(-2.0 * log(mag) / mag);
-    spare = v * mag;
-    return u * mag * stddev + mean;
+}
+
+static void ingest_pop(ingest_reading_t* reading) {
+    int i = 0;
+
+    *reading = g_ingest_heap[0];
+    g_ingest_heap[0] = g_ingest_heap[--g_ingest_count];
+    for (;;) {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < g_ingest_count && reading_before(&g_ingest_heap[left], &g_ingest_heap[smallest])) {
+            smallest = left;
+        }
+        if (right < g_ingest_count && reading_before(&g_ingest_heap[right], &g_ingest_heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        ingest_reading_t tmp = g_ingest_heap[i];
+        g_ingest_heap[i] = g_ingest_heap[smallest];
+        g_ingest_heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+// Log accepted readings per second for every producer active since the last report
+static void report_producers(double elapsed_s) {
+    for (int i = 0; i < g_producer_count; i++) {
+        producer_t* producer = &g_producers[i];
+        uint64_t recent = producer->accepted - producer->reported;
+        if (recent == 0 && producer->connections == 0) {
+            continue;
+        }
+        LOG_INFO("[Producer %s] %.1f readings/s, accepted=%llu rejected=%llu late=%llu throttled=%llu\n",
+                 producer->subject, recent / elapsed_s, (unsigned long long)producer->accepted,
+                 (unsigned long long)producer->rejected, (unsigned long long)producer->late,
+                 (unsigned long long)producer->throttled);
+        producer->reported = producer->accepted;
+    }
+}
+
+// Log per-class send rates and queueing latency, so the priority lane can be
+// compared against the bulk lane under load
+static void report_lanes(double elapsed_s) {
+    pthread_mutex_lock(&g_clients_mutex);
+    for (int c = 0; c < FRAME_CLASS_COUNT; c++) {
+        lane_stats_t* stats = &g_lane_stats[c];
+        uint64_t recent = stats->sent - stats->reported;
+        if (recent == 0) {
+            continue;
+        }
+        LOG_INFO("[Lane %s] %.1f frames/s, sent=%llu dropped=%llu avg latency=%lldus max=%lldus\n",
+                 g_lane_names[c], recent / elapsed_s, (unsigned long long)stats->sent,
+                 (unsigned long long)stats->dropped,
+                 (long long)(stats->latency_total_us / (int64_t)stats->sent),
+                 (long long)stats->latency_max_us);
+        stats->reported = stats->sent;
+    }
+    pthread_mutex_unlock(&g_clients_mutex);
+}
+
+// Log connection admission and handshake cost since the last report
+static void report_admission(void) {
+    pthread_mutex_lock(&g_handshake_mutex);
+    admission_stats_t* stats = &g_admission;
+    uint64_t events = stats->admitted + stats->rate_limited + stats->queue_full + stats->server_full;
+    if (events != stats->reported) {
+        uint64_t done = stats->completed > 0 ? stats->completed : 1;
+        LOG_INFO("[Admission] admitted=%llu rejected rate=%llu queue=%llu full=%llu, handshakes ok=%llu "
+                 "resumed=%llu failed=%llu pending=%d, avg wait=%lldus avg handshake=%lldus max=%lldus\n",
+                 (unsigned long long)stats->admitted, (unsigned long long)stats->rate_limited,
+                 (unsigned long long)stats->queue_full, (unsigned long long)stats->server_full,
+                 (unsigned long long)stats->completed, (unsigned long long)stats->resumed,
+                 (unsigned long long)stats->failed, g_pending_count,
+                 (long long)(stats->wait_total_us / (int64_t)done),
+                 (long long)(stats->handshake_total_us / (int64_t)done), (long long)stats->handshake_max_us);
+        stats->reported = events;
+    }
+    pthread_mutex_unlock(&g_handshake_mutex);
+}
+
+// Broadcast readings once the reorder window has passed, oldest first
+void* ingest_merger(void* arg) {
+    (void)arg;
+    ingest_reading_t ready[INGEST_EMIT_BATCH];
+    int64_t last_report_us = protocol_now_us();
+
+    rt_thread_setup("merger", 1);
+    pthread_mutex_lock(&g_ingest_mutex);
+    while (g_server_running) {
+        int64_t now_us = protocol_now_us();
+        int count = 0;
+
+        // While paused for an upgrade the reorder window is skipped: nothing
+        // newer will arrive, and the queue must be empty before the handoff
+        while (g_ingest_count > 0 && count < INGEST_EMIT_BATCH &&
+               (g_ingest_heap[0].origin_us <= now_us - g_reorder_us || g_ingest_paused)) {
+            ingest_pop(&ready[count++]);
+        }
+        if (count > 0) {
+            g_ingest_emitted_us = ready[count - 1].origin_us;
+            g_merger_busy = 1;
+            pthread_mutex_unlock(&g_ingest_mutex);
+            for (int i = 0; i < count; i++) {
+                broadcast_sample(ready[i].values, ready[i].origin_us);
+            }
+            pthread_mutex_lock(&g_ingest_mutex);
+            g_merger_busy = 0;
+            continue;
+        }
+
+        if (now_us - last_report_us >= (int64_t)PRODUCER_REPORT_SEC * 1000000) {
+            report_producers((now_us - last_report_us) / 1e6);
+            report_lanes((now_us - last_report_us) / 1e6);
+            report_admission();
+            last_report_us = now_us;
+        }
+
+        // Sleep until the oldest reading is due, a new one arrives, or at most 1 s
+        int64_t wake_us = now_us + 1000000;
+        if (g_ingest_count > 0 && g_ingest_heap[0].origin_us + g_reorder_us < wake_us) {
+            wake_us = g_ingest_heap[0].origin_us + g_reorder_us;
+        }
+        struct timespec deadline = { (time_t)(wake_us / 1000000), (long)(wake_us % 1000000) * 1000 };
+        pthread_cond_timedwait(&g_ingest_cond, &g_ingest_mutex, &deadline);
+    }
+    pthread_mutex_unlock(&g_ingest_mutex);
+
+    pthread_exit(NULL);
+}
+
+// Queue a sample from the built-in generator; it goes through the same merge as producers
+static void ingest_local_sample(const double* values) {
+    ingest_reading_t reading;
+
+    reading.origin_us = protocol_now_us();
+    memcpy(reading.values, values, sizeof(reading.values));
+
+    pthread_mutex_lock(&g_ingest_mutex);
+    if (g_ingest_paused) {
+        // The new process generates from here on
+    } else if (g_ingest_count < INGEST_QUEUE_SIZE && reading.origin_us > g_ingest_emitted_us) {
+        ingest_push(&reading);
+        pthread_cond_signal(&g_ingest_cond);
+    } else {
+        g_ingest_dropped++;
+    }
+    pthread_mutex_unlock(&g_ingest_mutex);
 }
 
 // Data generation thread function
 void* data_generator(void* arg) {
     (void)arg; // Suppress unused parameter warning
-    
+    kernel_rng_t rng;
+    double speed_batch[GENERATOR_BATCH];
+    double power_batch[GENERATOR_BATCH];
+    int next = GENERATOR_BATCH;
+    rt_ticker_t ticker;
+    uint64_t report_ticks = (uint64_t)RT_REPORT_SEC * 1000 / g_generator_period_ms;
+
+    rt_thread_setup("generator", 1);
+    kernel_rng_seed(&rng, (uint64_t)protocol_now_us());
+    printf("Data generator using %s kernels, period %d ms\n", kernel_backend_name(kernel_get_backend()),
+           g_generator_period_ms);
+
+    // Ticks come from absolute deadlines, so the period does not drift with the work done per sample
+    rt_ticker_start(&ticker, (int64_t)g_generator_period_ms * 1000000);
     while (g_server_running) {
-        // Generate two normal distribution random numbers
-        double data1 = generate_normal(61000.0, 1000.0);  // Mean=60000, range roughly 50000-70000
-        double data2 = generate_normal(1000.0, 80.0);    // Mean=1000, range roughly 800-1200
+        if (next == GENERATOR_BATCH) {
+            kernel_normal_fill(&rng, speed_batch, GENERATOR_BATCH, 61000.0, 1000.0);  // Mean=61000, range roughly 50000-70000
+            kernel_normal_fill(&rng, power_batch, GENERATOR_BATCH, 1000.0, 80.0);     // Mean=1000, range roughly 800-1200
+            next = 0;
+        }
+        double data1 = speed_batch[next];
+        double data2 = power_batch[next];
+        next++;
         
         // Clamp values to desired ranges
         if (data1 < 50000.0) data1 = 50000.0;
@@ -96,81 +506,861 @@ void* data_generator(void* arg) {
         g_data2 = data2;
         pthread_mutex_unlock(&g_data_mutex);
         
-        // Broadcast data to all connected clients
-        broadcast_data_to_clients(data1, data2);
+        // Merge into the stream broadcast to all connected clients
+        double values[CHANNEL_COUNT] = { data1, data2 };
+        ingest_local_sample(values);
         
-        printf("Get data: %.2f, %.2f\n", data1, data2);
-        
-        // Sleep for 2 seconds
-        sleep(2);
+        LOG_RATELIMITED(LOG_LEVEL_DEBUG, 1000, "Get data: %.2f, %.2f\n", data1, data2);
+
+        if (report_ticks > 0 && ticker.ticks > 0 && ticker.ticks % report_ticks == 0) {
+            rt_ticker_report(&ticker, "generator");
+        }
+        rt_ticker_wait(&ticker);
     }
+    rt_ticker_report(&ticker, "generator");
     
     pthread_exit(NULL);
 }
 
-// Broadcast data to all connected clients
-void broadcast_data_to_clients(double data1, double data2) {
-    char message[BUFFER_SIZE];
-    snprintf(message, BUFFER_SIZE, "%.2f,%.2f", data1, data2);
-    
+// Find a view with the given parameters or set up a new one.
+// Must be called with g_clients_mutex held. Returns the view index or -1.
+static int acquire_view(unsigned channel_mask, int decimation, aggregation_t aggregation,
+                        int64_t min_interval_us) {
+    int free_slot = -1;
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        subscription_view_t* view = &g_views[i];
+        if (view->refcount == 0) {
+            if (free_slot < 0) {
+                free_slot = i;
+            }
+            continue;
+        }
+        if (view->channel_mask == channel_mask && view->decimation == decimation &&
+            view->aggregation == aggregation && view->min_interval_us == min_interval_us) {
+            view->refcount++;
+            return i;
+        }
+    }
+
+    if (free_slot >= 0) {
+        subscription_view_t* view = &g_views[free_slot];
+        memset(view, 0, sizeof(*view));
+        view->refcount = 1;
+        view->channel_mask = channel_mask;
+        view->decimation = decimation;
+        view->aggregation = aggregation;
+        view->min_interval_us = min_interval_us;
+    }
+    return free_slot;
+}
+
+// Must be called with g_clients_mutex held
+static void release_view(int index) {
+    if (index >= 0 && g_views[index].refcount > 0) {
+        g_views[index].refcount--;
+    }
+}
+
+// Fold one sample into a view and encode its frame if one is due
+static void advance_view(subscription_view_t* view, const double* values,
+                         uint64_t seq, int64_t origin_us) {
+    view->due = 0;
+
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        if (view->pending == 0 || view->aggregation == AGG_LAST) {
+            view->acc[c] = values[c];
+        } else if (view->aggregation == AGG_MEAN) {
+            view->acc[c] += values[c];
+        } else if (view->aggregation == AGG_MIN) {
+            view->acc[c] = fmin(view->acc[c], values[c]);
+        } else {
+            view->acc[c] = fmax(view->acc[c], values[c]);
+        }
+    }
+    view->pending++;
+
+    // Emit after `decimation` samples, but no faster than the requested rate
+    if (view->pending < view->decimation) {
+        return;
+    }
+    if (view->min_interval_us > 0 && view->last_emit_us != 0 &&
+        origin_us - view->last_emit_us < view->min_interval_us) {
+        return;
+    }
+
+    double out[CHANNEL_COUNT];
+    unsigned channel_mask = view->channel_mask;
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        out[c] = (view->aggregation == AGG_MEAN) ? view->acc[c] / view->pending : view->acc[c];
+        if (isnan(out[c])) {
+            channel_mask &= ~(1u << c);  // Not collected by the producer: empty field
+        }
+    }
+    view->frame_len = frame_format_data(view->frame, sizeof(view->frame), seq, origin_us,
+                                        out, channel_mask);
+    view->pending = 0;
+    view->last_emit_us = origin_us;
+    view->due = 1;
+}
+
+// Queue a frame on a connection in the lane of its class; g_clients_mutex held.
+// A full lane overwrites its oldest frame, as the client has fallen behind.
+static void client_enqueue(client_info_t* client, const char* frame, int length) {
+    frame_class_t class = frame_class(frame);
+    send_lane_t* lane = &client->lanes[class];
+
+    if (client->closing || length <= 0 || length > FRAME_MAX_SIZE) {
+        return;
+    }
+    if (lane->count == SEND_QUEUE_FRAMES) {
+        lane->head = (lane->head + 1) % SEND_QUEUE_FRAMES;
+        lane->count--;
+        g_lane_stats[class].dropped++;
+    }
+    int idx = (lane->head + lane->count) % SEND_QUEUE_FRAMES;
+    memcpy(lane->frames[idx], frame, length);
+    lane->lengths[idx] = length;
+    lane->enqueued_us[idx] = protocol_now_us();
+    lane->count++;
+    pthread_cond_signal(&client->send_cond);
+}
+
+// Raise or clear channel alarms for one merged sample and queue the alarm
+// frames to every consumer, ahead of any queued samples; g_clients_mutex held
+static void check_alarms(const double* values, int64_t origin_us) {
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        double limit = g_alarm_limits[c];
+        int active = g_alarm_active[c];
+
+        if (isnan(values[c]) || limit <= 0) {
+            continue;
+        }
+        if (!active && values[c] > limit) {
+            active = 1;
+        } else if (active && values[c] < limit * (1.0 - ALARM_HYSTERESIS)) {
+            active = 0;
+        }
+        if (active == g_alarm_active[c]) {
+            continue;
+        }
+        g_alarm_active[c] = active;
+
+        char frame[FRAME_MAX_SIZE];
+        int length = frame_format_alarm(frame, sizeof(frame), ++g_alarm_seq, origin_us,
+                                        c, active, values[c], limit);
+        LOG_WARN("Alarm %s on channel %d: %.2f (limit %.2f)\n", active ? "raised" : "cleared",
+                 c, values[c], limit);
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (g_clients[i] != NULL && g_clients[i]->producer < 0) {
+                client_enqueue(g_clients[i], frame, length);
+            }
+        }
+    }
+}
+
+// Broadcast one merged sample to all subscribed clients; called only by the merger thread
+void broadcast_sample(const double* values, int64_t origin_us) {
     pthread_mutex_lock(&g_clients_mutex);
+    uint64_t seq = ++g_frame_seq;
+    history_entry_t* entry = &g_history[seq % HISTORY_SIZE];
+    entry->seq = seq;
+    entry->origin_us = origin_us;
+    memcpy(entry->values, values, sizeof(entry->values));
+
+    check_alarms(values, origin_us);
+
+    // Compute each distinct subscription view once
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (g_views[i].refcount > 0) {
+            advance_view(&g_views[i], values, seq, origin_us);
+        }
+    }
+
+    // Producers push data; they are not sent the merged stream
     for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (g_clients[i] != NULL && g_clients[i]->ssl != NULL) {
-            int ret = wolfSSL_write(g_clients[i]->ssl, message, strlen(message));
-            if (ret <= 0) {
-                printf("[Client %d] Failed to send data\n", g_clients[i]->client_id);
+        if (g_clients[i] != NULL && g_clients[i]->producer < 0) {
+            subscription_view_t* view = &g_views[g_clients[i]->view];
+            if (view->due && !g_clients[i]->replaying) {
+                client_enqueue(g_clients[i], view->frame, view->frame_len);
             }
         }
     }
     pthread_mutex_unlock(&g_clients_mutex);
 }
 
+// Oldest sequence number still in the history ring; g_clients_mutex held
+static uint64_t history_oldest(void) {
+    return g_frame_seq >= HISTORY_SIZE ? g_frame_seq - HISTORY_SIZE + 1 : 1;
+}
+
+// Queue the next backfill frames of a resuming client, at most one bulk burst
+// at a time so the replay never overruns its lane; g_clients_mutex held
+static void replay_history(client_info_t* client) {
+    send_lane_t* bulk = &client->lanes[FRAME_CLASS_BULK];
+
+    while (client->replaying && bulk->count < SEND_BULK_BURST) {
+        if (client->replay_next > g_frame_seq) {
+            // Caught up: the next broadcast goes to the client directly
+            client->replaying = 0;
+            LOG_INFO("[Client %d] Backfilled %llu samples, %llu no longer in history\n", client->client_id,
+                     (unsigned long long)client->replay_sent, (unsigned long long)client->replay_lost);
+            break;
+        }
+        const history_entry_t* entry = &g_history[client->replay_next % HISTORY_SIZE];
+        if (entry->seq != client->replay_next) {
+            // Overwritten while the client was catching up
+            client->replay_lost += history_oldest() - client->replay_next;
+            client->replay_next = history_oldest();
+            continue;
+        }
+        advance_view(&client->replay_view, entry->values, entry->seq, entry->origin_us);
+        if (client->replay_view.due) {
+            client_enqueue(client, client->replay_view.frame, client->replay_view.frame_len);
+        }
+        client->replay_sent++;
+        client->replay_next++;
+    }
+}
+
+// "RESUME <seq>": send the samples broadcast after seq, then continue live.
+// Returns NULL on success or a short reason on error; g_clients_mutex held.
+static const char* resume_client(client_info_t* client, const char* args, char* reply, size_t reply_size) {
+    char* end;
+    unsigned long long after = strtoull(args, &end, 10);
+
+    if (end == args || *end != '\0') {
+        return "bad resume";
+    }
+    // From another stream, e.g. a server started without --takeover
+    if (after > g_frame_seq) {
+        return "unknown sequence";
+    }
+
+    uint64_t lost = after + 1 < history_oldest() ? history_oldest() - after - 1 : 0;
+    client->replay_view = g_views[client->view];
+    client->replay_view.refcount = 0;
+    client->replay_view.pending = 0;
+    client->replay_view.last_emit_us = 0;
+    client->replay_next = after + 1 + lost;
+    client->replay_sent = 0;
+    client->replay_lost = lost;
+    client->replaying = client->replay_next <= g_frame_seq;
+    snprintf(reply, reply_size, "%c,OK,RESUME,%llu,%llu\n", FRAME_TYPE_CONTROL,
+             (unsigned long long)(g_frame_seq - after - lost), (unsigned long long)lost);
+    LOG_INFO("[Client %d] Resuming after %llu: %llu to backfill, %llu lost\n", client->client_id, after,
+             (unsigned long long)(g_frame_seq - after - lost), (unsigned long long)lost);
+    pthread_cond_signal(&client->send_cond);
+    return NULL;
+}
+
+// Parse the arguments of a "SUB" control line. Returns NULL on success or
+// a short reason on error.
+static const char* parse_subscription(char* args, unsigned* channel_mask, int* decimation,
+                                      aggregation_t* aggregation, int64_t* min_interval_us) {
+    char* saveptr = NULL;
+    char* token = strtok_r(args, " \t", &saveptr);
+
+    *channel_mask = CHANNEL_MASK_ALL;
+    *decimation = 1;
+    *aggregation = AGG_LAST;
+    *min_interval_us = 0;
+
+    if (token == NULL) {
+        return "missing channels";
+    }
+
+    // Channel list: "all" or comma separated names/indices
+    if (strcmp(token, "all") != 0) {
+        char* channel_save = NULL;
+        *channel_mask = 0;
+        for (char* ch = strtok_r(token, ",", &channel_save); ch != NULL;
+             ch = strtok_r(NULL, ",", &channel_save)) {
+            if (strcmp(ch, "speed") == 0 || strcmp(ch, "0") == 0) {
+                *channel_mask |= 1u << CHANNEL_CENTRIFUGE_SPEED;
+            } else if (strcmp(ch, "power") == 0 || strcmp(ch, "1") == 0) {
+                *channel_mask |= 1u << CHANNEL_POWER_OUTPUT;
+            } else {
+                return "unknown channel";
+            }
+        }
+        if (*channel_mask == 0) {
+            return "no channels";
+        }
+    }
+
+    while ((token = strtok_r(NULL, " \t", &saveptr)) != NULL) {
+        if (strncmp(token, "decim=", 6) == 0) {
+            *decimation = atoi(token + 6);
+            if (*decimation < 1 || *decimation > 10000) {
+                return "bad decim";
+            }
+        } else if (strncmp(token, "agg=", 4) == 0) {
+            int found = 0;
+            for (int i = 0; i <= AGG_MAX; i++) {
+                if (strcmp(token + 4, g_aggregation_names[i]) == 0) {
+                    *aggregation = (aggregation_t)i;
+                    found = 1;
+                }
+            }
+            if (!found) {
+                return "bad agg";
+            }
+        } else if (strncmp(token, "rate=", 5) == 0) {
+            double rate = atof(token + 5);
+            if (rate <= 0.0) {
+                return "bad rate";
+            }
+            *min_interval_us = (int64_t)(1000000.0 / rate);
+        } else {
+            return "unknown option";
+        }
+    }
+    return NULL;
+}
+
+// Parse "<origin_us>,<speed>,<power>" readings separated by ';'. Returns the
+// number of readings, or -1 if the batch is malformed.
+static int parse_batch_readings(const char* p, ingest_reading_t* readings) {
+    int count = 0;
+
+    while (*p == ';') {
+        char* end;
+        if (count == BATCH_MAX_READINGS) {
+            return -1;
+        }
+        ingest_reading_t* reading = &readings[count];
+        errno = 0;
+        reading->origin_us = strtoll(p + 1, &end, 10);
+        if (end == p + 1 || errno != 0) {
+            return -1;
+        }
+        p = end;
+        for (int c = 0; c < CHANNEL_COUNT; c++) {
+            if (*p++ != ',') {
+                return -1;
+            }
+            if (*p == ',' || *p == ';' || *p == '\0') {
+                reading->values[c] = NAN;  // Channel not collected
+                continue;
+            }
+            reading->values[c] = strtod(p, &end);
+            if (end == p) {
+                return -1;
+            }
+            p = end;
+        }
+        count++;
+    }
+    return (*p == '\0' && count > 0) ? count : -1;
+}
+
+// Producer for a certificate subject, created on its first batch. Only the
+// subjects given with --producer may push, unless --allow-any-producer opts in.
+// Must be called with g_ingest_mutex held. Returns -1 if not allowed or full.
+static int acquire_producer(const char* subject) {
+    int allowed = g_allow_any_producer;
+
+    // A session resumed from a ticket carries no peer certificate: producing
+    // needs a full handshake
+    if (subject[0] == '\0') {
+        return -1;
+    }
+
+    for (int i = 0; i < g_allowed_producer_count && !allowed; i++) {
+        allowed = (strcmp(g_allowed_producers[i], subject) == 0);
+    }
+    if (!allowed) {
+        return -1;
+    }
+    for (int i = 0; i < g_producer_count; i++) {
+        if (strcmp(g_producers[i].subject, subject) == 0) {
+            g_producers[i].connections++;
+            return i;
+        }
+    }
+    if (g_producer_count == MAX_PRODUCERS) {
+        return -1;
+    }
+
+    producer_t* producer = &g_producers[g_producer_count];
+    memset(producer, 0, sizeof(*producer));
+    snprintf(producer->subject, sizeof(producer->subject), "%s", subject);
+    producer->connections = 1;
+    producer->tokens = PRODUCER_BURST;
+    producer->refill_us = protocol_now_us();
+    return g_producer_count++;
+}
+
+// Validate a batch of readings and queue it for the merger. The whole batch
+// is refused with BUSY when the producer is over its rate or the queue is
+// full, so the producer can back off and resend it unchanged.
+static void handle_producer_batch(client_info_t* client, const char* line, char* reply, size_t reply_size) {
+    ingest_reading_t readings[BATCH_MAX_READINGS];
+    unsigned long long batch;
+    int consumed = 0;
+    int count = -1;
+
+    if (sscanf(line + 1, ",%llu%n", &batch, &consumed) == 1 && consumed > 0) {
+        count = parse_batch_readings(line + 1 + consumed, readings);
+    }
+
+    pthread_mutex_lock(&g_ingest_mutex);
+    if (client->producer < 0) {
+        client->producer = acquire_producer(client->subject);
+        if (client->producer >= 0) {
+            LOG_INFO("[Client %d] Producing as %s\n", client->client_id, client->subject);
+        }
+    }
+    if (client->producer < 0) {
+        pthread_mutex_unlock(&g_ingest_mutex);
+        LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "[Client %d] %s may not produce\n",
+                        client->client_id, client->subject);
+        snprintf(reply, reply_size, "%c,ERR,not a producer\n", FRAME_TYPE_CONTROL);
+        return;
+    }
+
+    producer_t* producer = &g_producers[client->producer];
+    if (count < 0) {
+        producer->rejected++;
+        pthread_mutex_unlock(&g_ingest_mutex);
+        LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "[Producer %s] Malformed batch\n", producer->subject);
+        snprintf(reply, reply_size, "%c,ERR,bad batch\n", FRAME_TYPE_CONTROL);
+        return;
+    }
+
+    // During an upgrade the producer retries against the new process
+    if (g_ingest_paused) {
+        pthread_mutex_unlock(&g_ingest_mutex);
+        snprintf(reply, reply_size, "%c,BUSY,%llu,%d\n", FRAME_TYPE_CONTROL, batch, DRAIN_MS);
+        return;
+    }
+
+    // A batch resent after a lost ACK is acknowledged again but not queued twice
+    if (producer->batches > 0 && batch <= producer->last_batch) {
+        pthread_mutex_unlock(&g_ingest_mutex);
+        snprintf(reply, reply_size, "%c,ACK,%llu,0,0\n", FRAME_TYPE_CONTROL, batch);
+        return;
+    }
+
+    int64_t now_us = protocol_now_us();
+    producer->tokens += (now_us - producer->refill_us) * (PRODUCER_RATE_LIMIT / 1e6);
+    if (producer->tokens > PRODUCER_BURST) {
+        producer->tokens = PRODUCER_BURST;
+    }
+    producer->refill_us = now_us;
+
+    if (producer->tokens < count || g_ingest_count + count > INGEST_QUEUE_SIZE) {
+        double missing = count - producer->tokens;
+        int retry_ms = missing > 0 ? (int)(missing * 1000.0 / PRODUCER_RATE_LIMIT) + 1 : 100;
+        producer->throttled++;
+        pthread_mutex_unlock(&g_ingest_mutex);
+        LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "[Producer %s] Batch %llu throttled\n",
+                        producer->subject, batch);
+        snprintf(reply, reply_size, "%c,BUSY,%llu,%d\n", FRAME_TYPE_CONTROL, batch, retry_ms);
+        return;
+    }
+    producer->tokens -= count;
+    producer->last_batch = batch;
+    producer->batches++;
+
+    int accepted = 0;
+    for (int i = 0; i < count; i++) {
+        ingest_reading_t* reading = &readings[i];
+        int valid = reading->origin_us > producer->last_origin_us &&
+                    reading->origin_us <= now_us + INGEST_MAX_FUTURE_US;
+        for (int c = 0; c < CHANNEL_COUNT && valid; c++) {
+            valid = isnan(reading->values[c]) || isfinite(reading->values[c]);
+        }
+        if (!valid) {
+            producer->rejected++;
+            continue;
+        }
+        producer->last_origin_us = reading->origin_us;
+        if (reading->origin_us <= g_ingest_emitted_us) {
+            producer->late++;
+            continue;
+        }
+        ingest_push(reading);
+        accepted++;
+    }
+    producer->accepted += accepted;
+    if (accepted > 0) {
+        pthread_cond_signal(&g_ingest_cond);
+    }
+    pthread_mutex_unlock(&g_ingest_mutex);
+
+    snprintf(reply, reply_size, "%c,ACK,%llu,%d,%d\n", FRAME_TYPE_CONTROL, batch, accepted, count - accepted);
+}
+
+// Handle one control line received from a client
+static void handle_control_line(client_info_t* client, char* line) {
+    char reply[FRAME_MAX_SIZE];
+    const char* error = NULL;
+    unsigned channel_mask;
+    int decimation;
+    aggregation_t aggregation;
+    int64_t min_interval_us;
+
+    if (line[0] == FRAME_TYPE_BATCH && line[1] == ',') {
+        handle_producer_batch(client, line, reply, sizeof(reply));
+        pthread_mutex_lock(&g_clients_mutex);
+        client_enqueue(client, reply, (int)strlen(reply));
+        pthread_mutex_unlock(&g_clients_mutex);
+        return;
+    }
+
+    if (strncmp(line, "RESUME ", 7) == 0) {
+        pthread_mutex_lock(&g_clients_mutex);
+        error = resume_client(client, line + 7, reply, sizeof(reply));
+        if (error != NULL) {
+            LOG_WARN("[Client %d] Rejected control line: %s\n", client->client_id, error);
+            snprintf(reply, sizeof(reply), "%c,ERR,%s\n", FRAME_TYPE_CONTROL, error);
+        }
+        client_enqueue(client, reply, (int)strlen(reply));
+        pthread_mutex_unlock(&g_clients_mutex);
+        return;
+    }
+
+    if (strncmp(line, "SUB", 3) != 0 || (line[3] != ' ' && line[3] != '\0')) {
+        LOG_RATELIMITED(LOG_LEVEL_INFO, 1000, "[Client %d] Received: %s\n", client->client_id, line);
+        error = "unknown command";
+    } else {
+        error = parse_subscription(line + 3, &channel_mask, &decimation,
+                                   &aggregation, &min_interval_us);
+    }
+
+    // Replies go out on the priority lane, ahead of queued samples
+    pthread_mutex_lock(&g_clients_mutex);
+    if (error == NULL) {
+        int view = acquire_view(channel_mask, decimation, aggregation, min_interval_us);
+        if (view < 0) {
+            error = "no free view";
+        } else {
+            release_view(client->view);
+            client->view = view;
+            LOG_INFO("[Client %d] Subscribed to view %d (channels=0x%x decim=%d agg=%s interval=%lldus, shared by %d)\n",
+                     client->client_id, view, channel_mask, decimation,
+                     g_aggregation_names[aggregation], (long long)min_interval_us,
+                     g_views[view].refcount);
+            snprintf(reply, sizeof(reply), "%c,OK,%d\n", FRAME_TYPE_CONTROL, view);
+        }
+    }
+    if (error != NULL) {
+        LOG_WARN("[Client %d] Rejected control line: %s\n", client->client_id, error);
+        snprintf(reply, sizeof(reply), "%c,ERR,%s\n", FRAME_TYPE_CONTROL, error);
+    }
+    client_enqueue(client, reply, (int)strlen(reply));
+    pthread_mutex_unlock(&g_clients_mutex);
+}
+
 // Signal handler for graceful shutdown
 void signal_handler(int sig) {
     printf("\nReceived signal %d, shutting down server...\n", sig);
     g_server_running = 0;
 }
 
-// Thread function to handle client connections
-void* handle_client(void* arg) {
+// Take up to max frames from one lane into batch; g_clients_mutex held
+static int take_frames(send_lane_t* lane, char* batch, int* batch_len, int64_t* enqueued_us, int max) {
+    int frames = lane->count < max ? lane->count : max;
+
+    for (int i = 0; i < frames; i++) {
+        int idx = (lane->head + i) % SEND_QUEUE_FRAMES;
+        memcpy(batch + *batch_len, lane->frames[idx], lane->lengths[idx]);
+        *batch_len += lane->lengths[idx];
+        enqueued_us[i] = lane->enqueued_us[idx];
+    }
+    lane->head = (lane->head + frames) % SEND_QUEUE_FRAMES;
+    lane->count -= frames;
+    return frames;
+}
+
+// Sender thread of one connection: every write to the client happens here.
+// The priority lane is drained before each bulk burst, so an alarm waits for
+// at most SEND_BULK_BURST queued samples however far the client has fallen behind.
+void* client_sender(void* arg) {
     client_info_t* client = (client_info_t*)arg;
-    WOLFSSL* ssl = NULL;
-    char buffer[BUFFER_SIZE];
+    char batch[SEND_QUEUE_FRAMES * FRAME_MAX_SIZE];
+    int64_t enqueued_us[SEND_QUEUE_FRAMES];
+
+    rt_thread_setup("client", 0);
+    pthread_mutex_lock(&g_clients_mutex);
+    while (!client->closing) {
+        send_lane_t* priority = &client->lanes[FRAME_CLASS_PRIORITY];
+        send_lane_t* bulk = &client->lanes[FRAME_CLASS_BULK];
+        if (client->replaying && bulk->count == 0) {
+            replay_history(client);
+        }
+        if (priority->count == 0 && bulk->count == 0) {
+            pthread_cond_wait(&client->send_cond, &g_clients_mutex);
+            continue;
+        }
+
+        frame_class_t class = priority->count > 0 ? FRAME_CLASS_PRIORITY : FRAME_CLASS_BULK;
+        int batch_len = 0;
+        int frames = take_frames(&client->lanes[class], batch, &batch_len, enqueued_us,
+                                 class == FRAME_CLASS_PRIORITY ? SEND_QUEUE_FRAMES : SEND_BULK_BURST);
+        pthread_mutex_unlock(&g_clients_mutex);
+
+        int ret = wolfSSL_write(client->ssl, batch, batch_len);
+        int64_t now_us = protocol_now_us();
+
+        pthread_mutex_lock(&g_clients_mutex);
+        if (ret <= 0) {
+            LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "[Client %d] Failed to send data\n", client->client_id);
+            // Wake the reader so the connection is torn down
+            shutdown(client->sockfd, SHUT_RDWR);
+            break;
+        }
+        lane_stats_t* stats = &g_lane_stats[class];
+        for (int i = 0; i < frames; i++) {
+            int64_t latency_us = now_us - enqueued_us[i];
+            stats->latency_total_us += latency_us;
+            if (latency_us > stats->latency_max_us) {
+                stats->latency_max_us = latency_us;
+            }
+        }
+        stats->sent += frames;
+    }
+    pthread_mutex_unlock(&g_clients_mutex);
+
+    pthread_exit(NULL);
+}
+
+// Release a connection that never reached handle_client
+static void drop_connection(client_info_t* client) {
+    if (client->ssl) {
+        wolfSSL_free(client->ssl);
+    }
+    close(client->sockfd);
+    pthread_cond_destroy(&client->send_cond);
+    mempool_free(&g_client_pool, client);
+
+    pthread_mutex_lock(&g_client_count_mutex);
+    g_client_count--;
+    pthread_mutex_unlock(&g_client_count_mutex);
+}
+
+#ifdef HAVE_SESSION_TICKET
+// Fill a fresh ticket key; the name lets a ticket find the key it was sealed with
+static int ticket_key_generate(ticket_key_t* key) {
+    return getrandom(key, sizeof(*key), 0) == (ssize_t)sizeof(*key) ? 0 : -1;
+}
+
+// First start: one random key, which is also the "previous" key until it rotates
+static int ticket_keys_init(void) {
+    if (ticket_key_generate(&g_ticket_keys[0]) != 0) {
+        perror("Cannot generate session ticket key");
+        return -1;
+    }
+    g_ticket_keys[1] = g_ticket_keys[0];
+    g_ticket_rotate_at_ms = protocol_now_us() / 1000 + (int64_t)TLS_SESSION_LIFETIME_SEC * 1000;
+    return 0;
+}
+
+// Seal and open session tickets with ChaCha20-Poly1305 under the server's own
+// keys. New tickets always use the current key; the previous one still opens
+// tickets issued before the last rotation, which wolfSSL then renews.
+// Must only be installed once g_ticket_keys holds keys.
+static int ticket_enc_cb(WOLFSSL* ssl, unsigned char key_name[WOLFSSL_TICKET_NAME_SZ],
+                         unsigned char iv[WOLFSSL_TICKET_IV_SZ], unsigned char mac[WOLFSSL_TICKET_MAC_SZ],
+                         int enc, unsigned char* ticket, int in_len, int* out_len, void* ctx) {
+    unsigned char key[TICKET_KEY_SIZE];
+    unsigned char aad[WOLFSSL_TICKET_NAME_SZ + WOLFSSL_TICKET_IV_SZ + 2];
+    int result = WOLFSSL_TICKET_RET_OK;
+    (void)ssl;
+    (void)ctx;
+
+    if (in_len < 0 || in_len > 0xFFFF) {
+        return WOLFSSL_TICKET_RET_REJECT;
+    }
+    pthread_mutex_lock(&g_ticket_mutex);
+    if (enc) {
+        int64_t now_ms = protocol_now_us() / 1000;
+        if (now_ms >= g_ticket_rotate_at_ms) {
+            ticket_key_t next;
+            if (ticket_key_generate(&next) == 0) {
+                g_ticket_keys[1] = g_ticket_keys[0];
+                g_ticket_keys[0] = next;
+                memset(&next, 0, sizeof(next));
+            }
+            g_ticket_rotate_at_ms = now_ms + (int64_t)TLS_SESSION_LIFETIME_SEC * 1000;
+        }
+        memcpy(key_name, g_ticket_keys[0].name, WOLFSSL_TICKET_NAME_SZ);
+        memcpy(key, g_ticket_keys[0].key, sizeof(key));
+    } else if (memcmp(key_name, g_ticket_keys[0].name, WOLFSSL_TICKET_NAME_SZ) == 0) {
+        memcpy(key, g_ticket_keys[0].key, sizeof(key));
+    } else if (memcmp(key_name, g_ticket_keys[1].name, WOLFSSL_TICKET_NAME_SZ) == 0) {
+        memcpy(key, g_ticket_keys[1].key, sizeof(key));
+        result = WOLFSSL_TICKET_RET_CREATE;
+    } else {
+        result = WOLFSSL_TICKET_RET_REJECT;
+    }
+    pthread_mutex_unlock(&g_ticket_mutex);
+    if (result == WOLFSSL_TICKET_RET_REJECT) {
+        return result;
+    }
+
+    if (enc && getrandom(iv, WOLFSSL_TICKET_IV_SZ, 0) != WOLFSSL_TICKET_IV_SZ) {
+        memset(key, 0, sizeof(key));
+        return WOLFSSL_TICKET_RET_FATAL;
+    }
+    // The name, IV and length are authenticated along with the ticket itself
+    memcpy(aad, key_name, WOLFSSL_TICKET_NAME_SZ);
+    memcpy(aad + WOLFSSL_TICKET_NAME_SZ, iv, WOLFSSL_TICKET_IV_SZ);
+    aad[sizeof(aad) - 2] = (unsigned char)(in_len >> 8);
+    aad[sizeof(aad) - 1] = (unsigned char)in_len;
+
     int ret;
-    int client_slot = -1;
-    
-    printf("[Client %d] Connected from %s:%d\n", 
-           client->client_id,
-           inet_ntoa(client->addr.sin_addr), 
-           ntohs(client->addr.sin_port));
+    if (enc) {
+        ret = wc_ChaCha20Poly1305_Encrypt(key, iv, aad, sizeof(aad), ticket, (word32)in_len, ticket, mac);
+    } else {
+        ret = wc_ChaCha20Poly1305_Decrypt(key, iv, aad, sizeof(aad), ticket, (word32)in_len, mac, ticket);
+    }
+    memset(key, 0, sizeof(key));
+    if (ret != 0) {
+        return enc ? WOLFSSL_TICKET_RET_FATAL : WOLFSSL_TICKET_RET_REJECT;
+    }
+    *out_len = in_len;
+    return result;
+}
+#endif
+
+// Run the TLS handshake on a pool thread. The socket is non-blocking for the
+// handshake and every wait is bounded by one absolute deadline, so a peer that
+// trickles bytes cannot hold the worker longer than HANDSHAKE_TIMEOUT_SEC.
+static int tls_handshake(client_info_t* client) {
+    int64_t deadline_us = protocol_now_us() + (int64_t)HANDSHAKE_TIMEOUT_SEC * 1000000;
+    int flags = fcntl(client->sockfd, F_GETFL, 0);
+
+    // Handshake workers run concurrently, so not inet_ntoa's shared buffer
+    char peer[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &client->addr.sin_addr, peer, sizeof(peer));
+    LOG_RATELIMITED(LOG_LEVEL_INFO, 1000, "[Client %d] Connected from %s:%d\n",
+                    client->client_id, peer, ntohs(client->addr.sin_port));
 
     // Create SSL object
-    ssl = wolfSSL_new(g_ctx);
-    if (ssl == NULL) {
-        fprintf(stderr, "[Client %d] Error creating SSL object\n", client->client_id);
-        goto cleanup;
+    client->ssl = wolfSSL_new(g_ctx);
+    if (client->ssl == NULL) {
+        LOG_RATELIMITED(LOG_LEVEL_ERROR, 1000, "[Client %d] Error creating SSL object\n", client->client_id);
+        return -1;
     }
 
     // Associate socket with SSL
-    wolfSSL_set_fd(ssl, client->sockfd);
-
-    // Perform TLS handshake
-    ret = wolfSSL_accept(ssl);
-    if (ret != SSL_SUCCESS) {
-        int error = wolfSSL_get_error(ssl, ret);
-        char error_string[80];
-        wolfSSL_ERR_error_string(error, error_string);
-        fprintf(stderr, "[Client %d] TLS handshake failed: %s\n", client->client_id, error_string);
-        goto cleanup;
+    wolfSSL_set_fd(client->ssl, client->sockfd);
+    fcntl(client->sockfd, F_SETFL, flags | O_NONBLOCK);
+    wolfSSL_set_using_nonblock(client->ssl, 1);
+
+    // Perform TLS handshake, waiting for the socket between steps
+    for (;;) {
+        int ret = wolfSSL_accept(client->ssl);
+        if (ret == SSL_SUCCESS) {
+            break;
+        }
+        int error = wolfSSL_get_error(client->ssl, ret);
+        if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) {
+            char error_string[80];
+            wolfSSL_ERR_error_string(error, error_string);
+            LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "[Client %d] TLS handshake failed: %s\n",
+                            client->client_id, error_string);
+            return -1;
+        }
+
+        int64_t remaining_us = deadline_us - protocol_now_us();
+        struct pollfd pfd = { client->sockfd, error == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT, 0 };
+        if (remaining_us <= 0 ||
+            (poll(&pfd, 1, (int)((remaining_us + 999) / 1000)) < 0 && errno != EINTR)) {
+            LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "[Client %d] TLS handshake timed out after %d s\n",
+                            client->client_id, HANDSHAKE_TIMEOUT_SEC);
+            return -1;
+        }
+    }
+
+    // Streaming uses blocking reads and writes (with handle_client's send timeout)
+    wolfSSL_set_using_nonblock(client->ssl, 0);
+    fcntl(client->sockfd, F_SETFL, flags);
+    LOG_RATELIMITED(LOG_LEVEL_INFO, 1000, "[Client %d] TLS handshake completed successfully!\n", client->client_id);
+    return 0;
+}
+
+// Handshake pool: take admitted connections in arrival order, complete the
+// handshake and hand established connections to their own streaming thread
+void* handshake_worker(void* arg) {
+    (void)arg;
+    pthread_t thread_id;
+
+    rt_thread_setup("handshake", 0);
+    pthread_mutex_lock(&g_handshake_mutex);
+    while (g_server_running) {
+        if (g_pending_count == 0) {
+            pthread_cond_wait(&g_handshake_cond, &g_handshake_mutex);
+            continue;
+        }
+        client_info_t* client = g_pending[g_pending_head];
+        g_pending_head = (g_pending_head + 1) % HANDSHAKE_PENDING;
+        g_pending_count--;
+        pthread_mutex_unlock(&g_handshake_mutex);
+
+        int64_t start_us = protocol_now_us();
+        int ret = tls_handshake(client);
+        int64_t end_us = protocol_now_us();
+        int resumed = ret == 0 && wolfSSL_session_reused(client->ssl);
+
+        pthread_mutex_lock(&g_handshake_mutex);
+        if (ret != 0) {
+            g_admission.failed++;
+        } else {
+            g_admission.completed++;
+            g_admission.resumed += resumed;
+            g_admission.wait_total_us += start_us - client->accepted_us;
+            g_admission.handshake_total_us += end_us - start_us;
+            if (end_us - start_us > g_admission.handshake_max_us) {
+                g_admission.handshake_max_us = end_us - start_us;
+            }
+        }
+        pthread_mutex_unlock(&g_handshake_mutex);
+
+        if (ret == 0 && pthread_create(&thread_id, NULL, handle_client, (void*)client) == 0) {
+            // Detach thread so it cleans up automatically
+            pthread_detach(thread_id);
+        } else {
+            if (ret == 0) {
+                fprintf(stderr, "Thread creation failed\n");
+            }
+            drop_connection(client);
+        }
+        pthread_mutex_lock(&g_handshake_mutex);
     }
+    pthread_mutex_unlock(&g_handshake_mutex);
+
+    pthread_exit(NULL);
+}
+
+// Streaming thread of one established connection
+void* handle_client(void* arg) {
+    client_info_t* client = (client_info_t*)arg;
+    WOLFSSL* ssl = client->ssl;
+    char buffer[BUFFER_SIZE];
+    size_t buffered = 0;
+    int ret;
+    int client_slot = -1;
+    int sender_started = 0;
+
+    rt_thread_setup("client", 0);
 
-    printf("[Client %d] TLS handshake completed successfully!\n", client->client_id);
+    // Writes to a consumer that stops reading fail instead of blocking its sender
+    struct timeval send_timeout = { SEND_TIMEOUT_SEC, 0 };
+    setsockopt(client->sockfd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
 
-    // Store SSL object in client structure
-    client->ssl = ssl;
+    if (pthread_create(&client->sender, NULL, client_sender, client) != 0) {
+        LOG_ERROR("[Client %d] Failed to create sender thread\n", client->client_id);
+        goto cleanup;
+    }
+    sender_started = 1;
 
-    // Add client to global client list
+    // Add client to global client list, starting on the full-rate view
     pthread_mutex_lock(&g_clients_mutex);
+    client->view = acquire_view(CHANNEL_MASK_ALL, 1, AGG_LAST, 0);
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (g_clients[i] == NULL) {
             g_clients[i] = client;
@@ -178,10 +1368,13 @@ void* handle_client(void* arg) {
             break;
         }
     }
+    if (client_slot == -1) {
+        release_view(client->view);
+    }
     pthread_mutex_unlock(&g_clients_mutex);
 
     if (client_slot == -1) {
-        fprintf(stderr, "[Client %d] Failed to add client to list\n", client->client_id);
+        LOG_ERROR("[Client %d] Failed to add client to list\n", client->client_id);
         goto cleanup;
     }
 
@@ -190,26 +1383,42 @@ void* handle_client(void* arg) {
     if (client_cert) {
         char* subject = wolfSSL_X509_NAME_oneline(
             wolfSSL_X509_get_subject_name(client_cert), 0, 0);
-        printf("[Client %d] Certificate subject: %s\n", client->client_id, subject);
+        LOG_INFO("[Client %d] Certificate subject: %s\n", client->client_id, subject ? subject : "");
+        snprintf(client->subject, sizeof(client->subject), "%s", subject ? subject : "");
         XFREE(subject, 0, DYNAMIC_TYPE_OPENSSL);
         wolfSSL_X509_free(client_cert);
     }
 
     // Display cipher suite information
-    printf("[Client %d] Cipher suite: %s\n", client->client_id, wolfSSL_get_cipher(ssl));
-    printf("[Client %d] Protocol version: %s\n", client->client_id, wolfSSL_get_version(ssl));
-    printf("[Client %d] Ready to receive data broadcasts\n", client->client_id);
+    LOG_INFO("[Client %d] Ready to receive data broadcasts (%s, %s)\n", client->client_id,
+             wolfSSL_get_version(ssl), wolfSSL_get_cipher(ssl));
 
-    // Keep connection alive and wait for disconnection
+    // Process control lines until disconnection
     while (g_server_running) {
-        memset(buffer, 0, BUFFER_SIZE);
-        ret = wolfSSL_read(ssl, buffer, BUFFER_SIZE - 1);
+        if (buffered == BUFFER_SIZE - 1) {
+            // A line longer than the buffer is not a valid command
+            buffered = 0;
+        }
+        ret = wolfSSL_read(ssl, buffer + buffered, BUFFER_SIZE - 1 - buffered);
         
         if (ret > 0) {
-            // Client sent some data, just acknowledge
-            printf("[Client %d] Received: %s\n", client->client_id, buffer);
+            buffered += ret;
+            buffer[buffered] = '\0';
+
+            char* start = buffer;
+            char* newline;
+            while ((newline = strchr(start, '\n')) != NULL) {
+                *newline = '\0';
+                if (newline > start && newline[-1] == '\r') {
+                    newline[-1] = '\0';
+                }
+                handle_control_line(client, start);
+                start = newline + 1;
+            }
+            buffered = strlen(start);
+            memmove(buffer, start, buffered + 1);
         } else if (ret == 0) {
-            printf("[Client %d] Disconnected\n", client->client_id);
+            LOG_INFO("[Client %d] Disconnected\n", client->client_id);
             break;
         } else {
             int error = wolfSSL_get_error(ssl, ret);
@@ -217,18 +1426,31 @@ void* handle_client(void* arg) {
                 usleep(100000); // Sleep 100ms to avoid busy waiting
                 continue;
             }
-            printf("[Client %d] Connection lost\n", client->client_id);
+            LOG_INFO("[Client %d] Connection lost\n", client->client_id);
             break;
         }
     }
 
 cleanup:
-    // Remove client from global list
+    if (client->producer >= 0) {
+        pthread_mutex_lock(&g_ingest_mutex);
+        g_producers[client->producer].connections--;
+        pthread_mutex_unlock(&g_ingest_mutex);
+    }
+
+    // Remove client from global list and stop its sender
+    pthread_mutex_lock(&g_clients_mutex);
     if (client_slot != -1) {
-        pthread_mutex_lock(&g_clients_mutex);
         g_clients[client_slot] = NULL;
-        pthread_mutex_unlock(&g_clients_mutex);
+        release_view(client->view);
+    }
+    client->closing = 1;
+    pthread_cond_signal(&client->send_cond);
+    pthread_mutex_unlock(&g_clients_mutex);
+    if (sender_started) {
+        pthread_join(client->sender, NULL);
     }
+    pthread_cond_destroy(&client->send_cond);
     
     // Cleanup
     if (ssl) {
@@ -239,28 +1461,364 @@ cleanup:
     
     // Update client count
     pthread_mutex_lock(&g_client_count_mutex);
-    g_client_count--;
-    printf("[Client %d] Connection closed. Active clients: %d\n", client->client_id, g_client_count);
+    int active = --g_client_count;
     pthread_mutex_unlock(&g_client_count_mutex);
+    LOG_INFO("[Client %d] Connection closed. Active clients: %d\n", client->client_id, active);
     
-    free(client);
+    mempool_free(&g_client_pool, client);
     pthread_exit(NULL);
 }
 
-int main() {
+// Graceful upgrade. The running server listens on a Unix socket
+// (--upgrade-socket); a new binary started with --takeover connects to it and
+// receives the TCP listening socket (SCM_RIGHTS), the frame and alarm sequence
+// numbers and the history ring. The old process stops accepting and flushes
+// its ingest queue before the handoff, so the two never broadcast at the same
+// time; once the new process confirms it is serving, the old one disconnects
+// its clients spread over --drain-ms. They reconnect to the same port and send
+// RESUME with their last sequence number, which the new process backfills.
+
+static int upgrade_listen(const char* path) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (fd < 0 || strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Invalid upgrade socket path: %s\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    // A predecessor's socket at this path is no longer needed once we run
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        perror("Upgrade socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int send_all(int fd, const void* data, size_t length) {
+    const char* p = (const char*)data;
+
+    while (length > 0) {
+        ssize_t n = send(fd, p, length, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+static int recv_all(int fd, void* data, size_t length) {
+    char* p = (char*)data;
+
+    while (length > 0) {
+        ssize_t n = recv(fd, p, length, 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+// Old side: pause ingest, flush it, and pass the listening socket and state to
+// the connected successor. Returns 0 once the successor confirms it is serving;
+// on any failure ingest resumes and this process keeps serving.
+static int hand_over(int conn, int listen_fd) {
+    upgrade_state_t state;
+    struct timeval timeout = { UPGRADE_ACK_TIMEOUT_SEC, 0 };
+    char ack = 0;
+
+    LOG_INFO("Upgrade requested: pausing ingest\n");
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    memset(&state, 0, sizeof(state));
+    pthread_mutex_lock(&g_ingest_mutex);
+    g_ingest_paused = 1;
+    pthread_cond_signal(&g_ingest_cond);
+    while (g_ingest_count > 0 || g_merger_busy) {
+        pthread_mutex_unlock(&g_ingest_mutex);
+        usleep(1000);
+        pthread_mutex_lock(&g_ingest_mutex);
+    }
+    state.ingest_emitted_us = g_ingest_emitted_us;
+    pthread_mutex_unlock(&g_ingest_mutex);
+
+    // Nothing is broadcast from here on, so the history no longer changes
+    pthread_mutex_lock(&g_clients_mutex);
+    memcpy(state.magic, UPGRADE_MAGIC, 4);
+    state.version = UPGRADE_VERSION;
+    state.frame_seq = g_frame_seq;
+    state.alarm_seq = g_alarm_seq;
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        state.alarm_active[c] = g_alarm_active[c];
+    }
+    uint64_t first = g_frame_seq > 0 ? history_oldest() : 1;
+    state.history_count = (uint32_t)(g_frame_seq + 1 - first);
+    pthread_mutex_unlock(&g_clients_mutex);
+
+    // Tickets issued by this process stay valid in the successor
+    pthread_mutex_lock(&g_ticket_mutex);
+    memcpy(state.ticket_keys, g_ticket_keys, sizeof(state.ticket_keys));
+    state.ticket_rotate_at_ms = g_ticket_rotate_at_ms;
+    pthread_mutex_unlock(&g_ticket_mutex);
+
+    struct iovec iov = { &state, sizeof(state) };
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &listen_fd, sizeof(int));
+
+    int ok = sendmsg(conn, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(state);
+    for (uint64_t seq = first; ok && seq <= state.frame_seq; seq++) {
+        ok = send_all(conn, &g_history[seq % HISTORY_SIZE], sizeof(history_entry_t)) == 0;
+    }
+    memset(state.ticket_keys, 0, sizeof(state.ticket_keys));
+    if (ok && recv_all(conn, &ack, 1) == 0 && ack == 'R') {
+        LOG_INFO("Upgrade complete at seq %llu (%u history samples): draining clients over %d ms\n",
+                 (unsigned long long)state.frame_seq, state.history_count, g_drain_ms);
+        return 0;
+    }
+
+    LOG_ERROR("Upgrade failed, resuming service\n");
+    pthread_mutex_lock(&g_ingest_mutex);
+    g_ingest_paused = 0;
+    pthread_mutex_unlock(&g_ingest_mutex);
+    return -1;
+}
+
+// New side: receive the listening socket and state from the running server.
+// Leaves *conn open; writing 'R' on it tells the old process we are serving.
+static int take_over(const char* path, int* conn) {
+    struct sockaddr_un addr;
+    upgrade_state_t state;
+    int listen_fd = -1;
+
+    *conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (*conn < 0 || connect(*conn, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Takeover: cannot reach the running server");
+        return -1;
+    }
+
+    struct iovec iov = { &state, sizeof(state) };
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    if (recvmsg(*conn, &msg, MSG_WAITALL) != (ssize_t)sizeof(state)) {
+        fprintf(stderr, "Takeover: no state received\n");
+        return -1;
+    }
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            memcpy(&listen_fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    if (listen_fd < 0 || memcmp(state.magic, UPGRADE_MAGIC, 4) != 0 || state.version != UPGRADE_VERSION ||
+        state.history_count > HISTORY_SIZE) {
+        fprintf(stderr, "Takeover: incompatible state from the running server\n");
+        return -1;
+    }
+    memcpy(g_ticket_keys, state.ticket_keys, sizeof(g_ticket_keys));
+    g_ticket_rotate_at_ms = state.ticket_rotate_at_ms;
+    memset(state.ticket_keys, 0, sizeof(state.ticket_keys));
+
+    for (uint32_t i = 0; i < state.history_count; i++) {
+        history_entry_t entry;
+        if (recv_all(*conn, &entry, sizeof(entry)) != 0) {
+            fprintf(stderr, "Takeover: history truncated\n");
+            close(listen_fd);
+            return -1;
+        }
+        g_history[entry.seq % HISTORY_SIZE] = entry;
+    }
+    g_frame_seq = state.frame_seq;
+    g_alarm_seq = state.alarm_seq;
+    g_ingest_emitted_us = state.ingest_emitted_us;
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        g_alarm_active[c] = state.alarm_active[c];
+    }
+    printf("Took over listening socket at seq %llu with %u history samples\n",
+           (unsigned long long)g_frame_seq, state.history_count);
+    return listen_fd;
+}
+
+// Disconnect every client, one at a time spread over drain_ms, so their
+// reconnects reach the new process at a rate its admission control accepts
+static void drain_clients(int drain_ms) {
+    int remaining = 0;
+
+    pthread_mutex_lock(&g_clients_mutex);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        remaining += g_clients[i] != NULL;
+    }
+    pthread_mutex_unlock(&g_clients_mutex);
+    int interval_ms = remaining > 0 ? drain_ms / remaining : 0;
+
+    for (;;) {
+        client_info_t* next = NULL;
+        pthread_mutex_lock(&g_clients_mutex);
+        for (int i = 0; i < MAX_CLIENTS && next == NULL; i++) {
+            if (g_clients[i] != NULL && !g_clients[i]->drained) {
+                next = g_clients[i];
+            }
+        }
+        if (next != NULL) {
+            next->drained = 1;
+            // The reader sees end of stream and tears the connection down
+            shutdown(next->sockfd, SHUT_RDWR);
+        }
+        pthread_mutex_unlock(&g_clients_mutex);
+        if (next == NULL) {
+            break;
+        }
+        usleep((useconds_t)interval_ms * 1000);
+    }
+}
+
+int main(int argc, char* argv[]) {
     int sockfd, connfd;
     struct sockaddr_in server_addr, client_addr;
     socklen_t client_len;
-    pthread_t thread_id;
     int client_id_counter = 0;
+    double accept_tokens = 0.0;
+    int64_t accept_refill_us = 0;
+    int takeover = 0;
+    int takeover_conn = -1;
+    int upgrade_fd = -1;
+    int upgraded = 0;
+
+    int log_level = LOG_LEVEL_INFO;
+    rt_config_t rt_config = { .pin_count = 0 };
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc &&
+            (log_level = log_parse_level(argv[i + 1])) >= 0) {
+            i++;
+        } else if (strcmp(argv[i], "--producer") == 0 && i + 1 < argc &&
+                   g_allowed_producer_count < MAX_PRODUCERS) {
+            g_allowed_producers[g_allowed_producer_count++] = argv[++i];
+        } else if (strcmp(argv[i], "--allow-any-producer") == 0) {
+            g_allow_any_producer = 1;
+        } else if (strcmp(argv[i], "--reorder-ms") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            g_reorder_us = (int64_t)atoi(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "--no-generator") == 0) {
+            g_generator_enabled = 0;
+        } else if (strcmp(argv[i], "--period-ms") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            g_generator_period_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rt-cpus") == 0 && i + 1 < argc &&
+                   rt_parse_cpus(&rt_config, argv[i + 1]) == 0) {
+            i++;
+        } else if (strcmp(argv[i], "--rt-fifo") == 0 && i + 1 < argc &&
+                   atoi(argv[i + 1]) >= 1 && atoi(argv[i + 1]) <= 99) {
+            rt_config.fifo_priority = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rt-mlock") == 0) {
+            rt_config.lock_memory = 1;
+        } else if (strcmp(argv[i], "--alarm-speed") == 0 && i + 1 < argc) {
+            g_alarm_limits[CHANNEL_CENTRIFUGE_SPEED] = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--alarm-power") == 0 && i + 1 < argc) {
+            g_alarm_limits[CHANNEL_POWER_OUTPUT] = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--handshake-workers") == 0 && i + 1 < argc &&
+                   atoi(argv[i + 1]) >= 1 && atoi(argv[i + 1]) <= HANDSHAKE_MAX_WORKERS) {
+            g_handshake_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--accept-rate") == 0 && i + 1 < argc && atof(argv[i + 1]) >= 0) {
+            g_accept_rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--accept-burst") == 0 && i + 1 < argc && atof(argv[i + 1]) >= 1) {
+            g_accept_burst = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--upgrade-socket") == 0 && i + 1 < argc) {
+            g_upgrade_path = argv[++i];
+        } else if (strcmp(argv[i], "--takeover") == 0) {
+            takeover = 1;
+        } else if (strcmp(argv[i], "--drain-ms") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            g_drain_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--log-level error|warn|info|debug] [--producer subject]... [--allow-any-producer]\n"
+                            "          [--reorder-ms ms] [--no-generator] [--alarm-speed rpm] [--alarm-power mw]\n"
+                            "          [--period-ms ms] [--rt-cpus role=cpu,...] [--rt-fifo priority] [--rt-mlock]\n"
+                            "          [--handshake-workers n] [--accept-rate per-second] [--accept-burst n]\n"
+                            "          [--upgrade-socket path [--takeover] [--drain-ms ms]]\n"
+                            "  --producer:     certificate subject allowed to push readings (repeatable;\n"
+                            "                  default: none, readings are refused)\n"
+                            "  --allow-any-producer: let every authenticated peer push readings\n"
+                            "  --reorder-ms:   wait for late readings before merging (default: %d)\n"
+                            "  --no-generator: broadcast only producer readings\n"
+                            "  --alarm-speed, --alarm-power: high alarm limits sent on the priority\n"
+                            "                  lane (default: %.0f RPM, %.0f MW; 0 disables)\n"
+                            "  --period-ms:    generator sampling period (default: %d)\n"
+                            "  --rt-cpus:      pin threads by role: main, generator, merger, client, handshake\n"
+                            "  --rt-fifo:      run generator and merger under SCHED_FIFO at this priority\n"
+                            "  --rt-mlock:     lock all memory to avoid page faults\n"
+                            "  --handshake-workers: threads running TLS handshakes (default: %d, max %d)\n"
+                            "  --accept-rate:  new connections admitted per second (default: %.0f; 0: no limit)\n"
+                            "  --accept-burst: connections admitted at once (default: %.0f)\n"
+                            "  --upgrade-socket: Unix socket through which a new binary can take over\n"
+                            "                  the listening socket for a restart without downtime\n"
+                            "  --takeover:     take over from the server running at --upgrade-socket\n"
+                            "  --drain-ms:     after handing over, disconnect clients over this long (default: %d)\n",
+                    argv[0], INGEST_REORDER_MS, ALARM_SPEED_HIGH, ALARM_POWER_HIGH, GENERATOR_PERIOD_MS,
+                    HANDSHAKE_WORKERS, HANDSHAKE_MAX_WORKERS, ACCEPT_RATE, ACCEPT_BURST, DRAIN_MS);
+            return -1;
+        }
+    }
+    if (takeover && g_upgrade_path == NULL) {
+        fprintf(stderr, "--takeover requires --upgrade-socket\n");
+        return -1;
+    }
+
+    // Placement applies to the main thread first, so every thread started
+    // later (including the logger) inherits it unless its role overrides it
+    rt_init(&rt_config);
+
+    // Start the asynchronous logger before any worker thread
+    log_init((log_level_t)log_level);
 
-    // Initialize random seed
-    srand(time(NULL));
-    
     // Initialize client list
     for (int i = 0; i < MAX_CLIENTS; i++) {
         g_clients[i] = NULL;
     }
+    if (mempool_init(&g_client_pool, "client contexts", sizeof(client_info_t), MAX_CLIENTS) != 0) {
+        log_shutdown();
+        return -1;
+    }
 
     // Set up signal handlers for graceful shutdown
     signal(SIGINT, signal_handler);
@@ -270,7 +1828,7 @@ int main() {
     wolfSSL_Init();
 
     // Create SSL context
-    g_ctx = wolfSSL_CTX_new(wolfTLSv1_2_server_method());
+    g_ctx = TLS_CTX_NEW(wolfTLSv1_2_server_method, MAX_CLIENTS);
     if (g_ctx == NULL) {
         fprintf(stderr, "Error creating SSL context\n");
         return -1;
@@ -299,91 +1857,211 @@ int main() {
 
     // Enable mutual authentication (require client certificate)
     wolfSSL_CTX_set_verify(g_ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+    wolfSSL_CTX_set_timeout(g_ctx, TLS_SESSION_LIFETIME_SEC);
 
-    // Create socket
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-        perror("Socket creation failed");
-        wolfSSL_CTX_free(g_ctx);
-        return -1;
-    }
+    if (takeover) {
+        // Inherit the predecessor's listening socket: connections queued in
+        // its backlog during the handoff are accepted here, along with its
+        // session ticket keys
+        sockfd = take_over(g_upgrade_path, &takeover_conn);
+        if (sockfd < 0) {
+            wolfSSL_CTX_free(g_ctx);
+            return -1;
+        }
+    } else {
+#ifdef HAVE_SESSION_TICKET
+        if (ticket_keys_init() != 0) {
+            wolfSSL_CTX_free(g_ctx);
+            return -1;
+        }
+#endif
+        // Create socket
+        sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (sockfd < 0) {
+            perror("Socket creation failed");
+            wolfSSL_CTX_free(g_ctx);
+            return -1;
+        }
 
-    // Set socket options
-    int opt = 1;
-    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        perror("Setsockopt failed");
-        close(sockfd);
-        wolfSSL_CTX_free(g_ctx);
-        return -1;
-    }
+        // Set socket options
+        int opt = 1;
+        if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+            perror("Setsockopt failed");
+            close(sockfd);
+            wolfSSL_CTX_free(g_ctx);
+            return -1;
+        }
 
-    // Configure server address
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(PORT);
+        // Configure server address
+        memset(&server_addr, 0, sizeof(server_addr));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_addr.s_addr = INADDR_ANY;
+        server_addr.sin_port = htons(PORT);
 
-    // Bind socket
-    if (bind(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("Bind failed");
-        close(sockfd);
-        wolfSSL_CTX_free(g_ctx);
-        return -1;
-    }
+        // Bind socket
+        if (bind(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+            perror("Bind failed");
+            close(sockfd);
+            wolfSSL_CTX_free(g_ctx);
+            return -1;
+        }
 
-    // Listen for connections
-    if (listen(sockfd, MAX_CLIENTS) < 0) {
-        perror("Listen failed");
-        close(sockfd);
-        wolfSSL_CTX_free(g_ctx);
-        return -1;
+        // Listen for connections
+        if (listen(sockfd, ACCEPT_BACKLOG) < 0) {
+            perror("Listen failed");
+            close(sockfd);
+            wolfSSL_CTX_free(g_ctx);
+            return -1;
+        }
     }
+#ifdef HAVE_SESSION_TICKET
+    // Keys are in place, whether generated or taken over
+    wolfSSL_CTX_set_TicketEncCb(g_ctx, ticket_enc_cb);
+    wolfSSL_CTX_set_TicketHint(g_ctx, TLS_SESSION_LIFETIME_SEC);
+#endif
+
+    // Accepts are polled together with the upgrade socket
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) | O_NONBLOCK);
 
     printf("Multi-threaded TLS Server listening on port %d...\n", PORT);
     printf("Maximum concurrent clients: %d\n", MAX_CLIENTS);
-    printf("Starting data generation thread...\n");
-    
-    // Start data generation thread
-    if (pthread_create(&g_data_thread, NULL, data_generator, NULL) != 0) {
-        fprintf(stderr, "Failed to create data generation thread\n");
+    printf("TLS handshakes: %d workers, %d pending, %.0f/s (burst %.0f)\n", g_handshake_workers,
+           HANDSHAKE_PENDING, g_accept_rate, g_accept_burst);
+    memory_account("ingest queue", sizeof(g_ingest_heap));
+    memory_report();
+
+    // The merger is the only thread that broadcasts
+    if (pthread_create(&g_merge_thread, NULL, ingest_merger, NULL) != 0) {
+        fprintf(stderr, "Failed to create ingest merger thread\n");
         close(sockfd);
         wolfSSL_CTX_free(g_ctx);
         return -1;
     }
+
+    // Start data generation thread
+    if (g_generator_enabled) {
+        printf("Starting data generation thread...\n");
+        if (pthread_create(&g_data_thread, NULL, data_generator, NULL) != 0) {
+            fprintf(stderr, "Failed to create data generation thread\n");
+            close(sockfd);
+            wolfSSL_CTX_free(g_ctx);
+            return -1;
+        }
+    } else {
+        printf("Data generator disabled, broadcasting producer readings only\n");
+    }
+
+    for (int i = 0; i < g_handshake_workers; i++) {
+        if (pthread_create(&g_handshake_threads[i], NULL, handshake_worker, NULL) != 0) {
+            fprintf(stderr, "Failed to create handshake worker\n");
+            g_handshake_workers = i;
+            break;
+        }
+    }
+    if (g_handshake_workers == 0) {
+        g_server_running = 0;
+    }
+    accept_tokens = g_accept_burst;
+    accept_refill_us = protocol_now_us();
+
+    // Offer our own successor a takeover, then release the predecessor
+    if (g_upgrade_path) {
+        upgrade_fd = upgrade_listen(g_upgrade_path);
+    }
+    if (takeover_conn >= 0) {
+        send_all(takeover_conn, "R", 1);
+        close(takeover_conn);
+    }
+    if (upgrade_fd >= 0) {
+        printf("Accepting upgrades on %s\n", g_upgrade_path);
+    }
     
     printf("Waiting for client connections... (Press Ctrl+C to stop)\n");
 
     // Main server loop
+    struct pollfd listen_fds[2] = { { sockfd, POLLIN, 0 }, { upgrade_fd, POLLIN, 0 } };
     while (g_server_running) {
+        if (poll(listen_fds, upgrade_fd >= 0 ? 2 : 1, 500) <= 0) {
+            continue;
+        }
+        if (upgrade_fd >= 0 && (listen_fds[1].revents & POLLIN)) {
+            int conn = accept(upgrade_fd, NULL, NULL);
+            if (conn >= 0) {
+                upgraded = hand_over(conn, sockfd) == 0;
+                close(conn);
+            }
+            if (upgraded) {
+                break;
+            }
+        }
+        if (!(listen_fds[0].revents & POLLIN)) {
+            continue;
+        }
+
         client_len = sizeof(client_addr);
         connfd = accept(sockfd, (struct sockaddr*)&client_addr, &client_len);
         
         if (connfd < 0) {
-            if (g_server_running) {
+            if (g_server_running && errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED) {
                 perror("Accept failed");
             }
             continue;
         }
 
-        // Check if we've reached the maximum number of clients
+        // Admission is decided here without touching TLS, so rejected
+        // connections are closed immediately. Only this thread adds to the
+        // handshake queue, so a free place seen now is still free below.
+        int64_t now_us = protocol_now_us();
+        if (g_accept_rate > 0) {
+            accept_tokens += (now_us - accept_refill_us) * (g_accept_rate / 1e6);
+            if (accept_tokens > g_accept_burst) {
+                accept_tokens = g_accept_burst;
+            }
+            accept_refill_us = now_us;
+        }
+        const char* reject = NULL;
+        pthread_mutex_lock(&g_handshake_mutex);
+        if (g_accept_rate > 0 && accept_tokens < 1.0) {
+            g_admission.rate_limited++;
+            reject = "accept rate limit";
+        } else if (g_pending_count == HANDSHAKE_PENDING) {
+            g_admission.queue_full++;
+            reject = "handshake queue full";
+        }
+        pthread_mutex_unlock(&g_handshake_mutex);
+        if (reject) {
+            LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "Rejecting connection from %s:%d: %s\n",
+                            inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port), reject);
+            close(connfd);
+            continue;
+        }
+
+        // Check if we've reached the maximum number of clients; the place is
+        // reserved from here through the handshake
         pthread_mutex_lock(&g_client_count_mutex);
         if (g_client_count >= MAX_CLIENTS) {
             pthread_mutex_unlock(&g_client_count_mutex);
-            printf("Maximum clients reached (%d), rejecting connection from %s:%d\n",
-                   MAX_CLIENTS, inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+            pthread_mutex_lock(&g_handshake_mutex);
+            g_admission.server_full++;
+            pthread_mutex_unlock(&g_handshake_mutex);
+            LOG_RATELIMITED(LOG_LEVEL_WARN, 1000,
+                            "Maximum clients reached (%d), rejecting connection from %s:%d\n",
+                            MAX_CLIENTS, inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
             close(connfd);
             continue;
         }
-        g_client_count++;
+        accept_tokens -= 1.0;
+        int active = ++g_client_count;
         client_id_counter++;
         int current_client_id = client_id_counter;
-        printf("New connection accepted. Active clients: %d/%d\n", g_client_count, MAX_CLIENTS);
         pthread_mutex_unlock(&g_client_count_mutex);
+        LOG_RATELIMITED(LOG_LEVEL_INFO, 1000, "New connection accepted. Active clients: %d/%d\n",
+                        active, MAX_CLIENTS);
 
         // Create client info structure
-        client_info_t* client_info = malloc(sizeof(client_info_t));
+        client_info_t* client_info = mempool_alloc(&g_client_pool);
         if (client_info == NULL) {
-            fprintf(stderr, "Memory allocation failed for client info\n");
+            LOG_RATELIMITED(LOG_LEVEL_WARN, 1000, "Client context pool exhausted\n");
             close(connfd);
             pthread_mutex_lock(&g_client_count_mutex);
             g_client_count--;
@@ -394,30 +2072,65 @@ int main() {
         client_info->sockfd = connfd;
         client_info->addr = client_addr;
         client_info->client_id = current_client_id;
+        client_info->ssl = NULL;
+        client_info->accepted_us = now_us;
+        client_info->producer = -1;
+        client_info->subject[0] = '\0';
+        memset(client_info->lanes, 0, sizeof(client_info->lanes));
+        pthread_cond_init(&client_info->send_cond, NULL);
+        client_info->closing = 0;
+        client_info->replaying = 0;
+        client_info->drained = 0;
 
-        // Create thread to handle client
-        if (pthread_create(&thread_id, NULL, handle_client, (void*)client_info) != 0) {
-            fprintf(stderr, "Thread creation failed\n");
-            close(connfd);
-            free(client_info);
-            pthread_mutex_lock(&g_client_count_mutex);
-            g_client_count--;
-            pthread_mutex_unlock(&g_client_count_mutex);
-            continue;
-        }
-
-        // Detach thread so it cleans up automatically
-        pthread_detach(thread_id);
+        // Queue for the handshake pool
+        pthread_mutex_lock(&g_handshake_mutex);
+        g_pending[(g_pending_head + g_pending_count) % HANDSHAKE_PENDING] = client_info;
+        g_pending_count++;
+        g_admission.admitted++;
+        pthread_cond_signal(&g_handshake_cond);
+        pthread_mutex_unlock(&g_handshake_mutex);
     }
 
     // Cleanup
     printf("\nShutting down server...\n");
+    g_server_running = 0;
     close(sockfd);
+
+    // Stop the handshake pool and drop connections still waiting for it
+    pthread_mutex_lock(&g_handshake_mutex);
+    pthread_cond_broadcast(&g_handshake_cond);
+    pthread_mutex_unlock(&g_handshake_mutex);
+    for (int i = 0; i < g_handshake_workers; i++) {
+        pthread_join(g_handshake_threads[i], NULL);
+    }
+    while (g_pending_count > 0) {
+        drop_connection(g_pending[g_pending_head]);
+        g_pending_head = (g_pending_head + 1) % HANDSHAKE_PENDING;
+        g_pending_count--;
+    }
     
     // Wait for data generation thread to finish
-    printf("Stopping data generation thread...\n");
-    pthread_join(g_data_thread, NULL);
+    if (g_generator_enabled) {
+        printf("Stopping data generation thread...\n");
+        pthread_join(g_data_thread, NULL);
+    }
+    pthread_mutex_lock(&g_ingest_mutex);
+    pthread_cond_signal(&g_ingest_cond);
+    pthread_mutex_unlock(&g_ingest_mutex);
+    pthread_join(g_merge_thread, NULL);
     
+    // After a handoff the successor already serves the port: move the clients over
+    if (upgraded) {
+        drain_clients(g_drain_ms);
+    }
+    if (upgrade_fd >= 0) {
+        close(upgrade_fd);
+        // After a handoff the path belongs to the successor
+        if (!upgraded) {
+            unlink(g_upgrade_path);
+        }
+    }
+
     // Wait for all client threads to finish
     printf("Waiting for all client connections to close...\n");
     while (g_client_count > 0) {
@@ -426,10 +2139,16 @@ int main() {
     
     wolfSSL_CTX_free(g_ctx);
     wolfSSL_Cleanup();
+    mempool_destroy(&g_client_pool);
     pthread_mutex_destroy(&g_client_count_mutex);
     pthread_mutex_destroy(&g_data_mutex);
     pthread_mutex_destroy(&g_clients_mutex);
+    pthread_mutex_destroy(&g_ingest_mutex);
+    pthread_cond_destroy(&g_ingest_cond);
+    pthread_mutex_destroy(&g_handshake_mutex);
+    pthread_cond_destroy(&g_handshake_cond);
     
     printf("Server shutdown complete.\n");
+    log_shutdown();
     return 0;
 }
@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// 远程写入的本地替身：make sink 后运行 build/historian-sink
+//
+// 接收客户端 --remote-write 发来的行协议请求，把每行数据打印到标准输出，并检查
+// 每个来源的时间戳是否单调递增（重放顺序错误或重复时计数）。用于模拟下游故障：
+//
+//   --fail N     对接下来的 N 个请求回复 503
+//   SIGUSR1      切换故障状态，故障期间所有请求都回复 503
+//
+// 客户端应在故障期间把数据写入日志，恢复后按原顺序补发。
+
+#define SINK_DEFAULT_PORT 8086
+#define SINK_MAX_BODY (4 * 1024 * 1024)
+#define SINK_MAX_SOURCES 16
+
+typedef struct {
+    char tag[128];
+    long long last_ns;
+} sink_source_t;
+
+static volatile sig_atomic_t g_outage = 0;
+static volatile sig_atomic_t g_running = 1;
+static sink_source_t g_sources[SINK_MAX_SOURCES];
+static int g_source_count = 0;
+static unsigned long long g_lines = 0;
+static unsigned long long g_out_of_order = 0;
+
+static void toggle_outage(int sig) {
+    (void)sig;
+    g_outage = !g_outage;
+}
+
+static void stop(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+// Check one "measurement,source=<tag> fields <ns>" line
+static void check_line(const char* line, size_t length) {
+    const char* tag = memchr(line, ',', length);
+    const char* ts = NULL;
+    for (size_t i = length; i > 0; i--) {
+        if (line[i - 1] == ' ') {
+            ts = line + i;
+            break;
+        }
+    }
+    if (!tag || !ts) {
+        return;
+    }
+
+    // The tag ends at the first unescaped space
+    const char* end = tag + 1;
+    while (end < line + length && !(*end == ' ' && end[-1] != '\\')) {
+        end++;
+    }
+    size_t tag_len = (size_t)(end - tag);
+    if (tag_len >= sizeof(g_sources[0].tag)) {
+        tag_len = sizeof(g_sources[0].tag) - 1;
+    }
+
+    sink_source_t* source = NULL;
+    for (int i = 0; i < g_source_count; i++) {
+        if (strncmp(g_sources[i].tag, tag, tag_len) == 0 && g_sources[i].tag[tag_len] == '\0') {
+            source = &g_sources[i];
+            break;
+        }
+    }
+    if (!source && g_source_count < SINK_MAX_SOURCES) {
+        source = &g_sources[g_source_count++];
+        memcpy(source->tag, tag, tag_len);
+        source->tag[tag_len] = '\0';
+        source->last_ns = 0;
+    }
+
+    long long ns = atoll(ts);
+    if (source) {
+        if (ns <= source->last_ns) {
+            g_out_of_order++;
+        }
+        source->last_ns = ns;
+    }
+    g_lines++;
+}
+
+static void respond(int fd, const char* status) {
+    char response[128];
+    int length = snprintf(response, sizeof(response),
+                          "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+    if (send(fd, response, length, MSG_NOSIGNAL) < 0) {
+        perror("send");
+    }
+}
+
+static void handle_request(int fd, char* buffer, int* fail_count) {
+    size_t received = 0;
+    char* body = NULL;
+    size_t content_length = 0;
+
+    // Read the headers, then exactly Content-Length bytes of body
+    while (received < SINK_MAX_BODY) {
+        ssize_t n = recv(fd, buffer + received, SINK_MAX_BODY - received, 0);
+        if (n <= 0) {
+            return;
+        }
+        received += (size_t)n;
+        buffer[received] = '\0';
+        if (!body && (body = strstr(buffer, "\r\n\r\n")) != NULL) {
+            body += 4;
+            const char* header = strcasestr(buffer, "Content-Length:");
+            content_length = header ? strtoull(header + 15, NULL, 10) : 0;
+        }
+        if (body && received - (size_t)(body - buffer) >= content_length) {
+            break;
+        }
+    }
+    if (!body) {
+        respond(fd, "400 Bad Request");
+        return;
+    }
+
+    if (g_outage || *fail_count > 0) {
+        if (*fail_count > 0) {
+            (*fail_count)--;
+        }
+        fprintf(stderr, "sink: simulated outage, 503 for %zu bytes\n", content_length);
+        respond(fd, "503 Service Unavailable");
+        return;
+    }
+
+    unsigned long long before = g_lines;
+    char* line = body;
+    char* end = body + content_length;
+    while (line < end) {
+        char* newline = memchr(line, '\n', (size_t)(end - line));
+        size_t length = newline ? (size_t)(newline - line) : (size_t)(end - line);
+        if (length > 0) {
+            fwrite(line, 1, length, stdout);
+            fputc('\n', stdout);
+            check_line(line, length);
+        }
+        line += length + 1;
+    }
+    fflush(stdout);
+    fprintf(stderr, "sink: accepted %llu lines (total %llu, out of order %llu)\n",
+            g_lines - before, g_lines, g_out_of_order);
+    respond(fd, "204 No Content");
+}
+
+int main(int argc, char* argv[]) {
+    int port = SINK_DEFAULT_PORT;
+    int fail_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fail") == 0 && i + 1 < argc) {
+            fail_count = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--port port] [--fail requests]\n"
+                            "  SIGUSR1 toggles a simulated outage (503 for every request)\n", argv[0]);
+            return 1;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = toggle_outage;
+    sigaction(SIGUSR1, &sa, NULL);
+    sa.sa_handler = stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(listen_fd, 8) != 0) {
+        perror("historian-sink");
+        return 1;
+    }
+
+    char* buffer = malloc(SINK_MAX_BODY + 1);
+    if (!buffer) {
+        return 1;
+    }
+    fprintf(stderr, "sink: listening on port %d\n", port);
+
+    while (g_running) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        handle_request(fd, buffer, &fail_count);
+        close(fd);
+    }
+
+    fprintf(stderr, "sink: %llu lines, %llu out of order\n", g_lines, g_out_of_order);
+    free(buffer);
+    close(listen_fd);
+    return g_out_of_order ? 2 : 0;
+}
@@ -0,0 +1,131 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "shm_reader.h"
+
+// 共享内存读取示例：make shm-tail 后运行 build/shm-tail
+//
+// 映射客户端 --shm <name> 发布的环形缓冲区，打印每个新数据点，并统计从客户端发布
+// 到本进程读到的延迟（两边都用 CLOCK_MONOTONIC，只在同一主机上有意义）。
+//
+//   --name N     共享内存名称（默认 npp，与客户端 --shm 一致）
+//   --from-start 从缓冲区中最旧的数据点开始，而不是从最新的之后
+//   --quiet      不打印数据点，只每 10 秒输出一次统计
+//
+// 客户端重启时自动重新打开。
+
+static volatile sig_atomic_t g_running = 1;
+
+static void stop(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char* argv[]) {
+    const char* name = "npp";
+    int from_start = 0;
+    int quiet = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            name = argv[++i];
+        } else if (strcmp(argv[i], "--from-start") == 0) {
+            from_start = 1;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--name shm-name] [--from-start] [--quiet]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    unsigned long long samples = 0;
+    int64_t latency_total_ns = 0;
+    int64_t latency_max_ns = 0;
+    int64_t next_report_ns = now_ns() + 10000000000LL;
+
+    while (g_running) {
+        shm_reader_t reader;
+        if (shm_reader_open(&reader, name) != 0) {
+            if (errno != ENOENT) {
+                perror("shm-tail: open");
+                return 1;
+            }
+            sleep(1);
+            continue;
+        }
+        if (from_start) {
+            shm_reader_rewind(&reader);
+        }
+        fprintf(stderr, "shm-tail: attached to %s (%u slots, writer pid %d)\n",
+                name, reader.header->capacity, (int)reader.header->writer_pid);
+
+        int ret;
+        while (g_running && (ret = shm_reader_wait(&reader, 1000)) >= 0) {
+            shm_sample_t sample;
+            while (shm_reader_next(&reader, &sample) == 1) {
+                int64_t latency_ns = now_ns() - sample.publish_ns;
+                samples++;
+                latency_total_ns += latency_ns;
+                if (latency_ns > latency_max_ns) {
+                    latency_max_ns = latency_ns;
+                }
+                if (!quiet) {
+                    const char* source = shm_reader_source_name(&reader, sample.source);
+                    printf("#%llu %lld %s", (unsigned long long)sample.seq, (long long)sample.timestamp_ms,
+                           source ? source : "?");
+                    if (!isnan(sample.centrifuge_speed)) {
+                        printf(" speed=%.2f", sample.centrifuge_speed);
+                    }
+                    if (!isnan(sample.power_output)) {
+                        printf(" power=%.2f", sample.power_output);
+                    }
+                    if (sample.anomaly) {
+                        printf(" anomaly=0x%02x", sample.anomaly);
+                    }
+                    printf(" latency=%.1fus\n", latency_ns / 1000.0);
+                    fflush(stdout);
+                }
+            }
+
+            if (now_ns() >= next_report_ns && samples > 0) {
+                fprintf(stderr, "shm-tail: %llu samples, lost %llu, latency avg=%.1fus max=%.1fus\n",
+                        samples, (unsigned long long)reader.lost,
+                        latency_total_ns / 1000.0 / samples, latency_max_ns / 1000.0);
+                next_report_ns = now_ns() + 10000000000LL;
+            }
+        }
+
+        if (g_running) {
+            fprintf(stderr, "shm-tail: writer closed %s, reopening\n", name);
+            // Replay whatever the restarted client has published before we noticed
+            from_start = 1;
+        }
+        shm_reader_close(&reader);
+    }
+
+    if (samples > 0) {
+        fprintf(stderr, "shm-tail: %llu samples, latency avg=%.1fus max=%.1fus\n",
+                samples, latency_total_ns / 1000.0 / samples, latency_max_ns / 1000.0);
+    }
+    return 0;
+}